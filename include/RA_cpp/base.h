@@ -21,7 +21,7 @@ struct not_implemented : public std::logic_error
 };
 
 template<typename T, typename U>
-void throw_with( U s )
+[[noreturn]] void throw_with( U s )
 {
     // FIXME: do this statically
     const std::ostringstream* ss = dynamic_cast<const std::ostringstream*>(&s);
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <memory>
+#include <array>
+#include <string>
+#include <cstdint>
+
+#include "base.h"
+#include "types.h"
+#include "storage.h"
+#include "relation.h"
+
+#ifndef RA_CPP_LIBRARY_HPP
+#define RA_CPP_LIBRARY_HPP
+
+#include <RA_cpp/ra_cpp_library_export.hpp>
+
+#endif
+
+namespace rac
+{
+
+// Columnar relation files
+//
+// A relation is saved as a single file: a header, a column directory
+// describing the relation type (names and type_t of each column), the
+// column names, the relation's keys, then one 64 byte aligned section
+// per column (plus a second section for String heaps).
+//
+// Keys are a sequence of std::uint32_t: the number of keys, then for
+// each its number of columns followed by their positions in the
+// directory.
+//
+// Sections hold the same layout as the in memory storage:
+// - Int, Float, Double: the array of values
+// - Bool: the bit-packed words (see column_storage<bool>)
+// - String: 64 bit record offsets, then the heap of string_records
+//   (see basic_string_column_storage)
+//
+// Opening a file maps it read-only (mmap), so loading is independent of
+// size: pages fault in as they are touched and are shared between
+// processes through the page cache. Values are in native byte order, a
+// file written on a machine of the other endianness is rejected.
+
+struct column_file_header
+{
+    typedef std::array<char, 8> magic_t;
+
+    static constexpr magic_t        file_magic { 'R', 'A', 'C', 'O', 'L', 'S', '\0', '\0' };
+    static constexpr std::uint32_t  file_version    = 2;
+    static constexpr std::uint32_t  byte_order      = 0x01020304;
+    static constexpr std::uint64_t  alignment       = 64;
+
+    magic_t         magic;
+    std::uint32_t   version;
+    std::uint32_t   endian;
+    std::uint64_t   n_rows;
+    std::uint64_t   n_cols;
+    std::uint64_t   keys_offset;
+    std::uint64_t   keys_size;      // bytes
+};
+
+struct column_file_entry
+{
+    std::uint32_t   ty_con;
+    std::uint32_t   name_size;
+    std::uint64_t   name_offset;
+    std::uint64_t   data_offset;
+    std::uint64_t   data_size;
+    std::uint64_t   heap_offset;    // String only
+    std::uint64_t   heap_size;
+};
+
+
+// Read-only storage for a column section of a mapped file
+//
+// The mapping is shared by all columns of the file and is unmapped
+// when the last column goes. All mutation throws.
+RA_CPP_LIBRARY_EXPORT struct mapped_column_storage : public IStorage
+{
+    typedef std::shared_ptr<const void> mapping_ptr_t;
+
+    explicit mapped_column_storage(
+         mapping_ptr_t              mapping
+        ,const type_t&              ty
+        ,size_t                     n_rows
+        ,const char*                data
+        ,const char*                heap = nullptr
+        ,size_t                     heap_size = 0
+    );
+
+    virtual ~mapped_column_storage() = default;
+
+    const type_t& type() const noexcept
+    {
+        return m_ty;
+    }
+
+    // IStorage interface
+
+    const value_t*  at( size_t idx ) const override;
+    size_t          size() const noexcept override;
+    size_t          capacity() const noexcept override;
+    bool            empty() const noexcept override;
+    const_iterator  cbegin() const noexcept override;
+    const_iterator  cend() const noexcept override;
+
+    value_t*        at( size_t idx ) override;
+    iterator        begin() noexcept override;
+    iterator        end() noexcept override;
+
+    void reserve( size_t sz ) override;
+    void resize( size_t sz ) override;
+    void set( size_t idx, const value_t* v ) override;
+    void push_back( const value_t* v ) override;
+    void append( const value_t* first, size_t n ) override;
+
+    void copy(   const const_iterator&  fromb
+                ,const const_iterator&  frome
+                ,iterator               to
+    ) override;
+
+    void move(   iterator   fromb
+                ,iterator   frome
+                ,iterator   to
+    ) override;
+
+    // copies into plain, mutable storage
+    std::shared_ptr<IStorage> clone(
+        std::pmr::memory_resource* rsrc ) const override;
+
+private:
+    mapping_ptr_t   m_mapping;
+    type_t          m_ty;
+    size_t          m_size;
+    size_t          m_elem_size;    // 0 for Bool and String
+    const char*     m_data;
+    const char*     m_heap;
+    size_t          m_heap_size;
+};
+
+
+// Write a relation to a column file, replacing any existing file
+RA_CPP_LIBRARY_EXPORT void write_column_file(
+     const relation&    rel
+    ,const std::string& path
+);
+
+// Map a column file as a read-only relation
+RA_CPP_LIBRARY_EXPORT std::shared_ptr<relation> open_column_file(
+    const std::string& path
+);
+
+} // namespace rac
@@ -0,0 +1,1489 @@
+#pragma once
+
+#include <memory_resource>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <optional>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <array>
+#include <type_traits>
+#include <bit>
+#include <cstdint>
+#include <mutex>
+
+#include "base.h"
+#include "types.h"
+#include "storage.h"
+
+#ifndef RA_CPP_LIBRARY_HPP
+#define RA_CPP_LIBRARY_HPP
+
+#include <RA_cpp/ra_cpp_library_export.hpp>
+
+#endif
+
+namespace rac
+{
+
+// Column encodings
+//
+// Columns are always built plain, and may be re-encoded once loaded, when
+// the distribution of values is known (see relation_builder::encode)
+//
+// Auto picks an encoding from the data, see choose_encoding. Packed is
+// only applied when asked for.
+
+typedef enum {
+    Plain, Dictionary, Rle, Packed, Auto,
+} encoding_t;
+
+
+// Dictionary encoded String columns
+//
+// The dictionary holds each distinct value once, sorted, and rows hold
+// narrow integer codes into it.
+//
+// Dictionary records are laid out in sorted order, so the record pointers
+// handed out through IStorage::at() compare in the same order as the codes,
+// and as the strings. Comparing two values from the same column is then an
+// integer compare, see dictionary_value_ops.
+//
+// Adding a value that is not already in the dictionary rebuilds the
+// dictionary and remaps all codes, so this is best suited to columns that
+// are encoded once loaded.
+template<typename Code>
+struct dictionary_column_storage
+{
+    // types
+
+    typedef Code                                        code_t;
+    typedef basic_string_column_storage<std::uint32_t>  dictionary_t;
+    typedef std::pmr::vector<code_t>                    codes_t;
+
+    typedef std::string_view                            value_type;
+    typedef size_t                                      size_type;
+
+    typedef std::pmr::memory_resource* resource_ptr_t;
+
+    // maximum number of distinct values
+    static constexpr size_type max_size =
+        size_type( std::numeric_limits<code_t>::max() ) + 1;
+
+    explicit dictionary_column_storage( resource_ptr_t rsrc )
+        : m_rsrc( rsrc ), m_dict( rsrc ), m_codes( rsrc ) {
+        if ( !rsrc ) {
+            throw std::invalid_argument( "Must specify pmr resource" );
+        }
+    }
+
+    // copy into another resource
+    dictionary_column_storage( const dictionary_column_storage& other, resource_ptr_t rsrc )
+        : m_rsrc( rsrc ), m_dict( rsrc ), m_codes( other.m_codes, rsrc )
+    {
+        m_dict.assign( other.m_dict );
+    }
+
+    virtual ~dictionary_column_storage() = default;
+
+    // immutable deconstruction
+
+    constexpr bool empty() const noexcept
+    {
+        return m_codes.empty();
+    }
+
+    constexpr size_type size() const noexcept
+    {
+        return m_codes.size();
+    }
+
+    constexpr size_type capacity() const noexcept
+    {
+        return m_codes.capacity();
+    }
+
+    std::string_view at( size_type i ) const
+    {
+        return m_dict[ m_codes.at( i ) ];
+    }
+
+    std::string_view operator[]( size_type i ) const
+    {
+        return m_dict[ m_codes[ i ] ];
+    }
+
+    constexpr code_t code( size_type i ) const
+    {
+        return m_codes.at( i );
+    }
+
+    constexpr const code_t* codes() const noexcept
+    {
+        return m_codes.data();
+    }
+
+    constexpr const dictionary_t& dictionary() const noexcept
+    {
+        return m_dict;
+    }
+
+    // the dictionary record for row i
+    constexpr const char* record( size_type i ) const
+    {
+        return m_dict.record( m_codes.at( i ) );
+    }
+
+    // code space operations
+
+    // first code whose value is not less than v
+    size_type lower_bound( std::string_view v ) const
+    {
+        size_type lo = 0;
+        size_type hi = m_dict.size();
+        while ( lo < hi ) {
+            const size_type mid = lo + ( hi - lo ) / 2;
+            if ( m_dict[ mid ] < v ) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    std::optional<code_t> find( std::string_view v ) const
+    {
+        const size_type c = lower_bound( v );
+        if ( c < m_dict.size() && m_dict[ c ] == v ) {
+            return code_t( c );
+        }
+        return std::nullopt;
+    }
+
+    // rows equal to v as a bitmap, one integer compare per row
+    void equal( std::string_view v, column_storage<bool>& out ) const
+    {
+        out.resize( 0 );
+        out.reserve( m_codes.size() );
+        const auto c = find( v );
+        if ( !c ) {
+            out.resize( m_codes.size() );
+            return;
+        }
+        for ( const auto code : m_codes ) {
+            out.push_back( code == *c );
+        }
+    }
+
+    size_type count_equal( std::string_view v ) const
+    {
+        const auto c = find( v );
+        return c ? size_type( std::count( m_codes.cbegin(), m_codes.cend(), *c ) )
+                 : 0;
+    }
+
+    // mutation
+
+    constexpr void reserve( size_type sz )
+    {
+        m_codes.reserve( sz );
+    }
+
+    // new rows are empty strings
+    void resize( size_type sz )
+    {
+        if ( sz > m_codes.size() ) {
+            m_codes.resize( sz, code_for( std::string_view() ) );
+        } else {
+            m_codes.resize( sz );
+        }
+    }
+
+    void set( size_type i, std::string_view v )
+    {
+        if ( i >= m_codes.size() ) {
+            throw std::out_of_range( "dictionary_column_storage::set" );
+        }
+        m_codes[ i ] = code_for( v );
+    }
+
+    void push_back( std::string_view v )
+    {
+        m_codes.push_back( code_for( v ) );
+    }
+
+    // Note: large batches are coded through a hash table rather than
+    // searching the dictionary per row
+    void append( const std::string_view* first, size_type n )
+    {
+        add_values( first, n );
+        reserve_more( m_codes, n );
+        if ( n < hash_threshold ) {
+            for ( size_type i = 0; i < n; ++i ) {
+                m_codes.push_back( *find( first[ i ] ) );
+            }
+            return;
+        }
+        std::unordered_map<std::string_view, code_t> codes;
+        codes.reserve( m_dict.size() );
+        for ( size_type c = 0; c < m_dict.size(); ++c ) {
+            codes.emplace( m_dict[ c ], code_t( c ) );
+        }
+        for ( size_type i = 0; i < n; ++i ) {
+            m_codes.push_back( codes.find( first[ i ] )->second );
+        }
+    }
+
+private:
+    static constexpr size_type hash_threshold = 64;
+
+    code_t code_for( std::string_view v )
+    {
+        if ( const auto c = find( v ) ) {
+            return *c;
+        }
+        add_values( &v, 1 );
+        return *find( v );
+    }
+
+    // add any values not yet in the dictionary, rebuilding it in sorted
+    // order and remapping existing codes
+    void add_values( const std::string_view* first, size_type n )
+    {
+        std::unordered_set<std::string_view> distinct;
+        for ( size_type i = 0; i < n; ++i ) {
+            if ( !find( first[ i ] ) ) {
+                distinct.insert( first[ i ] );
+            }
+        }
+        if ( distinct.empty() ) {
+            return;
+        }
+        std::vector<std::string_view> missing( distinct.cbegin(), distinct.cend() );
+        std::sort( missing.begin(), missing.end() );
+
+        const size_type n_dict = m_dict.size() + missing.size();
+        if ( n_dict > max_size ) {
+            throw_with< std::length_error >(
+                std::ostringstream()
+                << "Dictionary would hold " << n_dict
+                << " values, codes allow " << max_size
+            );
+        }
+
+        // merge, the old dictionary stays alive until we are done, as
+        // values may be views into it
+        dictionary_t dict( m_rsrc );
+        dict.reserve( n_dict );
+        std::vector<code_t> remap( m_dict.size() );
+        size_type i = 0;
+        size_type j = 0;
+        while ( i < m_dict.size() || j < missing.size() ) {
+            if ( j == missing.size()
+                || ( i < m_dict.size() && m_dict[ i ] < missing[ j ] ) )
+            {
+                remap[ i ] = code_t( dict.size() );
+                dict.push_back( m_dict[ i++ ] );
+            } else {
+                dict.push_back( missing[ j++ ] );
+            }
+        }
+        for ( auto& c : m_codes ) {
+            c = remap[ c ];
+        }
+        std::swap( m_dict, dict );
+    }
+
+    resource_ptr_t  m_rsrc;
+    dictionary_t    m_dict;
+    codes_t         m_codes;
+};
+
+
+// Value operations for a dictionary encoded column
+//
+// Values from the column are pointers to dictionary records, which are in
+// sorted order, so comparison is a pointer compare. Values from elsewhere
+// fall back to comparing strings.
+template<typename Code>
+struct dictionary_value_ops : public IValue
+{
+    typedef dictionary_column_storage<Code> storage_t;
+
+    explicit dictionary_value_ops( const storage_t* storage )
+        : m_storage( storage )
+    {
+    }
+
+    virtual ~dictionary_value_ops() = default;
+
+    // IValue
+    using typename IValue::storage_ptr_t;
+
+    constexpr type_t type() const noexcept override
+    {
+        return value_ops<std::string_view>::type();
+    }
+
+    std::strong_ordering cmp( const value_t* a, const value_t* b )
+        const noexcept override
+    {
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+        const char* a_ = reinterpret_cast<const char*>( a );
+        const char* b_ = reinterpret_cast<const char*>( b );
+        // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+        if ( in_dictionary( a_ ) && in_dictionary( b_ ) ) {
+            return std::compare_three_way()( a_, b_ );
+        }
+        return string_record::decode( a_ ) <=> string_record::decode( b_ );
+    }
+
+    std::ostream& to_stream( const value_t* v, std::ostream& os ) const override
+    {
+        return os << value_ops<std::string_view>::get( v );
+    }
+
+    // new columns are plain
+    storage_ptr_t make_storage(
+        std::pmr::memory_resource* rsrc
+    ) const override
+    {
+        return value_ops<std::string_view>::make_storage( rsrc );
+    }
+
+private:
+    bool in_dictionary( const char* rec ) const noexcept
+    {
+        const auto& dict = m_storage->dictionary();
+        const std::less<const char*> lt;
+        return !lt( rec, dict.heap() ) && lt( rec, dict.heap() + dict.heap_size() );
+    }
+
+    const storage_t* m_storage;
+};
+
+
+// IStorage for dictionary encoded columns, values are dictionary records
+// (see string_record), so iteration is indexed and mutable element access
+// is only available via set()
+template<typename Code>
+struct untyped_dictionary_column_storage : public set_based_storage
+{
+    typedef dictionary_column_storage<Code>     storage_t;
+    typedef std::shared_ptr< storage_t >        storage_ptr_t;
+
+    explicit untyped_dictionary_column_storage( storage_ptr_t storage )
+        : m_storage( storage )
+        , m_ops( std::make_unique< dictionary_value_ops<Code> >( storage.get() ) )
+    {
+    }
+
+    virtual ~untyped_dictionary_column_storage() = default;
+
+    const storage_t& typed_storage() const noexcept
+    {
+        return *m_storage;
+    }
+
+private:
+
+    // Convenience
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    static const value_t* cv( const char* x ) noexcept
+    {
+        return reinterpret_cast<const value_t*>( x );
+    }
+
+    static const char* ct( const value_t* x ) noexcept
+    {
+        return reinterpret_cast<const char*>( x );
+    }
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+
+public:
+
+    // IStorage interface
+
+    const value_t* at( size_t idx ) const override
+    {
+        return cv( m_storage->record( idx ) );
+    }
+
+    size_t size() const noexcept override
+    {
+        return m_storage->size();
+    }
+
+    size_t capacity() const noexcept override
+    {
+        return m_storage->capacity();
+    }
+
+    bool empty() const noexcept override
+    {
+        return m_storage->empty();
+    }
+
+    const_iterator cbegin() const noexcept override
+    {
+        return const_value_iterator( this, 0 );
+    }
+
+    const_iterator cend() const noexcept override
+    {
+        return const_value_iterator( this, m_storage->size() );
+    }
+
+    value_t* at( size_t /* idx */ ) override
+    {
+        throw std::logic_error(
+            "Dictionary storage has no mutable element access, use set()" );
+    }
+
+    iterator begin() noexcept override
+    {
+        return value_iterator( this, 0 );
+    }
+
+    iterator end() noexcept override
+    {
+        return value_iterator( this, m_storage->size() );
+    }
+
+    void reserve( size_t sz ) override
+    {
+        m_storage->reserve( sz );
+    }
+
+    void resize( size_t sz ) override
+    {
+        m_storage->resize( sz );
+    }
+
+    // values are records, see string_record_buffer
+    void set( size_t idx, const value_t* v ) override
+    {
+        m_storage->set( idx, value_ops<std::string_view>::get( v ) );
+    }
+
+    void push_back( const value_t* v ) override
+    {
+        m_storage->push_back( value_ops<std::string_view>::get( v ) );
+    }
+
+    void append( const value_t* first, size_t n ) override
+    {
+        std::vector<std::string_view> vs( n );
+        const char* rec = ct( first );
+        for ( auto& v : vs ) {
+            v = string_record::decode( rec );
+            rec = string_record::next( rec );
+        }
+        m_storage->append( vs.data(), n );
+    }
+
+    IValue* ops() const noexcept override
+    {
+        return m_ops.get();
+    }
+
+    std::shared_ptr<IStorage> clone(
+        std::pmr::memory_resource* rsrc ) const override
+    {
+        return std::make_shared< untyped_dictionary_column_storage< Code > >(
+            std::make_shared< storage_t >( *m_storage, rsrc ) );
+    }
+
+private:
+    storage_ptr_t                                   m_storage;
+    std::unique_ptr< dictionary_value_ops<Code> >   m_ops;
+};
+
+
+// Run-length encoded columns
+//
+// Each run of equal values is stored once, with the end row of each run
+// (a prefix sum of run lengths), so at() is a binary search over the runs.
+// Suited to sorted columns, or columns with long runs, e.g. leading sort
+// key columns. Aggregates and filters can work a run at a time, see
+// for_each_run.
+//
+// Values are addressable (the run's value), but writes through a pointer
+// would change the whole run, so mutable element access is via set().
+//
+// Columns are only run-length encoded by relation_builder::encode(), with
+// Rle or Auto, before release(); building doesn't pick it by itself.
+template<typename T>
+struct rle_column_storage
+{
+    static_assert( std::is_arithmetic_v<T> && !std::is_same_v<T, bool>,
+        "RLE storage is for fixed size, addressable values" );
+
+    // types
+
+    typedef std::pmr::vector<T>         values_t;
+    typedef std::pmr::vector<size_t>    ends_t;
+
+    typedef T                           value_type;
+    typedef size_t                      size_type;
+
+    typedef std::pmr::memory_resource* resource_ptr_t;
+
+    explicit rle_column_storage( resource_ptr_t rsrc )
+        : m_rsrc( rsrc ), m_values( rsrc ), m_ends( rsrc ) {
+        if ( !rsrc ) {
+            throw std::invalid_argument( "Must specify pmr resource" );
+        }
+    }
+
+    // copy into another resource
+    rle_column_storage( const rle_column_storage& other, resource_ptr_t rsrc )
+        : m_rsrc( rsrc ), m_values( other.m_values, rsrc ), m_ends( other.m_ends, rsrc )
+    {
+    }
+
+    virtual ~rle_column_storage() = default;
+
+    // immutable deconstruction
+
+    constexpr bool empty() const noexcept
+    {
+        return m_ends.empty();
+    }
+
+    constexpr size_type size() const noexcept
+    {
+        return m_ends.empty() ? 0 : m_ends.back();
+    }
+
+    constexpr size_type n_runs() const noexcept
+    {
+        return m_values.size();
+    }
+
+    // index of the run holding row i, O(log n_runs())
+    constexpr size_type run( size_type i ) const noexcept
+    {
+        return size_type(
+            std::upper_bound( m_ends.cbegin(), m_ends.cend(), i )
+            - m_ends.cbegin() );
+    }
+
+    constexpr const T& at( size_type i ) const
+    {
+        if ( i >= size() ) {
+            throw std::out_of_range( "rle_column_storage::at" );
+        }
+        return m_values[ run( i ) ];
+    }
+
+    constexpr const T& operator[]( size_type i ) const
+    {
+        return m_values[ run( i ) ];
+    }
+
+    constexpr const T* values() const noexcept
+    {
+        return m_values.data();
+    }
+
+    constexpr const size_type* ends() const noexcept
+    {
+        return m_ends.data();
+    }
+
+    // run at a time access, f( value, start row, length )
+    template<typename F>
+    constexpr void for_each_run( F f ) const
+    {
+        size_type start = 0;
+        for ( size_type r = 0; r < m_values.size(); ++r ) {
+            f( m_values[ r ], start, m_ends[ r ] - start );
+            start = m_ends[ r ];
+        }
+    }
+
+    template<typename Acc = T>
+    constexpr Acc sum() const
+    {
+        Acc acc {};
+        for_each_run( [&]( const T& v, size_type, size_type n ) {
+            acc += static_cast<Acc>( v ) * static_cast<Acc>( n );
+        } );
+        return acc;
+    }
+
+    template<typename P>
+    constexpr size_type count_if( P pred ) const
+    {
+        size_type c = 0;
+        for_each_run( [&]( const T& v, size_type, size_type n ) {
+            if ( pred( v ) ) {
+                c += n;
+            }
+        } );
+        return c;
+    }
+
+    // mutation
+
+    // Note: runs are only known as values are added
+    constexpr void reserve( size_type /* sz */ )
+    {
+    }
+
+    void resize( size_type sz )
+    {
+        if ( sz > size() ) {
+            push_run( T(), sz - size() );
+        } else {
+            const size_type r = run( sz );
+            if ( r < m_values.size() && sz > ( r == 0 ? 0 : m_ends[ r - 1 ] ) ) {
+                m_values.resize( r + 1 );
+                m_ends.resize( r + 1 );
+                m_ends[ r ] = sz;
+            } else {
+                m_values.resize( r );
+                m_ends.resize( r );
+            }
+        }
+    }
+
+    void push_back( const T& v )
+    {
+        push_run( v, 1 );
+    }
+
+    void append( const T* first, size_type n )
+    {
+        for ( size_type i = 0; i < n; ) {
+            size_type j = i + 1;
+            while ( j < n && first[ j ] == first[ i ] ) {
+                ++j;
+            }
+            push_run( first[ i ], j - i );
+            i = j;
+        }
+    }
+
+    // split the run holding row i, merging with neighbours if equal
+    void set( size_type i, const T& v )
+    {
+        if ( i >= size() ) {
+            throw std::out_of_range( "rle_column_storage::set" );
+        }
+        const size_type r = run( i );
+        if ( m_values[ r ] == v ) {
+            return;
+        }
+        const size_type start   = r == 0 ? 0 : m_ends[ r - 1 ];
+        const size_type end     = m_ends[ r ];
+        const T old             = m_values[ r ];
+
+        // replace run r by [start, i) old, [i, i+1) v, [i+1, end) old
+        std::array<T, 3>            vs { old, v, old };
+        std::array<size_type, 3>    es { i, i + 1, end };
+        const size_type b = ( i == start ) ? 1 : 0;
+        const size_type e = ( i + 1 == end ) ? 2 : 3;
+        m_values.erase( m_values.begin() + long( r ) );
+        m_ends.erase( m_ends.begin() + long( r ) );
+        m_values.insert( m_values.begin() + long( r ),
+            vs.begin() + long( b ), vs.begin() + long( e ) );
+        m_ends.insert( m_ends.begin() + long( r ),
+            es.begin() + long( b ), es.begin() + long( e ) );
+
+        // merge the new run with its neighbours
+        const size_type nr = r + ( ( i == start ) ? 0 : 1 );
+        if ( nr + 1 < m_values.size() && m_values[ nr + 1 ] == v ) {
+            m_values.erase( m_values.begin() + long( nr + 1 ) );
+            m_ends.erase( m_ends.begin() + long( nr ) );
+        }
+        if ( nr > 0 && m_values[ nr - 1 ] == v ) {
+            m_values.erase( m_values.begin() + long( nr ) );
+            m_ends.erase( m_ends.begin() + long( nr - 1 ) );
+        }
+    }
+
+private:
+    void push_run( const T& v, size_type n )
+    {
+        if ( n == 0 ) {
+            return;
+        }
+        if ( !m_values.empty() && m_values.back() == v ) {
+            m_ends.back() += n;
+        } else {
+            m_values.push_back( v );
+            m_ends.push_back( size() + n );
+        }
+    }
+
+    resource_ptr_t  m_rsrc;
+    values_t        m_values;
+    ends_t          m_ends;
+};
+
+
+template<typename T>
+struct untyped_rle_column_storage : public set_based_storage
+{
+    typedef rle_column_storage<T>       storage_t;
+    typedef std::shared_ptr< storage_t > storage_ptr_t;
+
+    explicit untyped_rle_column_storage( storage_ptr_t storage )
+        : m_storage( storage )
+    {
+    }
+
+    virtual ~untyped_rle_column_storage() = default;
+
+    const storage_t& typed_storage() const noexcept
+    {
+        return *m_storage;
+    }
+
+private:
+
+    // Convenience
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    static constexpr const value_t* cv( const T* x ) noexcept
+    {
+        return reinterpret_cast<const value_t*>( x );
+    }
+
+    static constexpr const T* ct( const value_t* x ) noexcept
+    {
+        return reinterpret_cast<const T*>( x );
+    }
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+
+public:
+
+    // IStorage interface
+
+    const value_t* at( size_t idx ) const override
+    {
+        return cv( &m_storage->at( idx ) );
+    }
+
+    size_t size() const noexcept override
+    {
+        return m_storage->size();
+    }
+
+    size_t capacity() const noexcept override
+    {
+        return m_storage->size();
+    }
+
+    bool empty() const noexcept override
+    {
+        return m_storage->empty();
+    }
+
+    const_iterator cbegin() const noexcept override
+    {
+        return const_value_iterator( this, 0 );
+    }
+
+    const_iterator cend() const noexcept override
+    {
+        return const_value_iterator( this, m_storage->size() );
+    }
+
+    value_t* at( size_t /* idx */ ) override
+    {
+        throw std::logic_error(
+            "RLE storage has no mutable element access, use set()" );
+    }
+
+    iterator begin() noexcept override
+    {
+        return value_iterator( this, 0 );
+    }
+
+    iterator end() noexcept override
+    {
+        return value_iterator( this, m_storage->size() );
+    }
+
+    void reserve( size_t sz ) override
+    {
+        m_storage->reserve( sz );
+    }
+
+    void resize( size_t sz ) override
+    {
+        m_storage->resize( sz );
+    }
+
+    void set( size_t idx, const value_t* v ) override
+    {
+        m_storage->set( idx, *ct( v ) );
+    }
+
+    void push_back( const value_t* v ) override
+    {
+        m_storage->push_back( *ct( v ) );
+    }
+
+    void append( const value_t* first, size_t n ) override
+    {
+        m_storage->append( ct( first ), n );
+    }
+
+    std::shared_ptr<IStorage> clone(
+        std::pmr::memory_resource* rsrc ) const override
+    {
+        return std::make_shared< untyped_rle_column_storage< T > >(
+            std::make_shared< storage_t >( *m_storage, rsrc ) );
+    }
+
+private:
+    storage_ptr_t m_storage;
+};
+
+
+// Frame of reference, bit-packed integer columns
+//
+// Values are split into fixed size blocks. Each block stores its minimum
+// (the frame of reference) and the offsets from it, packed with the
+// fewest bits that hold the largest offset, e.g. ids within a partition
+// or small counters take 8-16 bits per row rather than 32.
+//
+// A full block of w bit offsets is exactly 2w words, so block b starts
+// at a prefix sum of widths and at() is a shift and mask. The final
+// partial block is kept unpacked until it fills.
+//
+// Scans decode a block at a time into a small buffer, which the
+// compiler can keep in L1 and vectorise over, see for_each_block. Block
+// min/max let range filters skip or accept whole blocks undecoded.
+//
+// Writes that don't fit a block's frame repack the blocks from there on,
+// so the storage suits columns that are loaded then read.
+template<typename T>
+struct packed_column_storage
+{
+    static_assert( std::is_integral_v<T> && !std::is_same_v<T, bool>,
+        "Bit-packing is for integer values" );
+
+    // types
+
+    typedef std::make_unsigned_t<T>         delta_t;
+    typedef std::uint64_t                   word_t;
+
+    typedef T                               value_type;
+    typedef size_t                          size_type;
+
+    typedef std::pmr::memory_resource* resource_ptr_t;
+
+    static constexpr size_type word_bits    = 64;
+    static constexpr size_type block_size   = 128;
+
+    explicit packed_column_storage( resource_ptr_t rsrc )
+        : m_rsrc( rsrc )
+        , m_words( rsrc ), m_starts( rsrc ), m_refs( rsrc )
+        , m_maxs( rsrc ), m_widths( rsrc ), m_tail( rsrc ) {
+        if ( !rsrc ) {
+            throw std::invalid_argument( "Must specify pmr resource" );
+        }
+        m_tail.reserve( block_size );
+        m_starts.push_back( 0 );
+    }
+
+    // copy into another resource
+    packed_column_storage( const packed_column_storage& other, resource_ptr_t rsrc )
+        : m_rsrc( rsrc )
+        , m_words( other.m_words, rsrc ), m_starts( other.m_starts, rsrc )
+        , m_refs( other.m_refs, rsrc ), m_maxs( other.m_maxs, rsrc )
+        , m_widths( other.m_widths, rsrc ), m_tail( other.m_tail, rsrc )
+    {
+        m_tail.reserve( block_size );
+    }
+
+    virtual ~packed_column_storage() = default;
+
+    // immutable deconstruction
+
+    constexpr bool empty() const noexcept
+    {
+        return size() == 0;
+    }
+
+    constexpr size_type size() const noexcept
+    {
+        return n_blocks() * block_size + m_tail.size();
+    }
+
+    // number of packed (full) blocks
+    constexpr size_type n_blocks() const noexcept
+    {
+        return m_widths.size();
+    }
+
+    constexpr unsigned width( size_type block ) const noexcept
+    {
+        return m_widths[ block ];
+    }
+
+    // bounds of packed block b, which may be conservative after set()
+    constexpr const T& block_min( size_type b ) const noexcept
+    {
+        return m_refs[ b ];
+    }
+
+    constexpr const T& block_max( size_type b ) const noexcept
+    {
+        return m_maxs[ b ];
+    }
+
+    // bytes used by the packed representation
+    resource_ptr_t resource() const noexcept
+    {
+        return m_rsrc;
+    }
+
+    constexpr size_type packed_bytes() const noexcept
+    {
+        return m_words.size() * sizeof( word_t )
+            + m_starts.size() * sizeof( size_type )
+            + ( m_refs.size() + m_maxs.size() + m_tail.size() ) * sizeof( T )
+            + m_widths.size();
+    }
+
+    constexpr T at( size_type i ) const
+    {
+        if ( i >= size() ) {
+            throw std::out_of_range( "packed_column_storage::at" );
+        }
+        return ( *this )[ i ];
+    }
+
+    constexpr T operator[]( size_type i ) const
+    {
+        const size_type b = i / block_size;
+        if ( b == n_blocks() ) {
+            return m_tail[ i % block_size ];
+        }
+        return unpack_one( b, i % block_size );
+    }
+
+    // decode block b (packed or tail) into out, returns the number of values
+    size_type decode_block( size_type b, T* out ) const
+    {
+        if ( b == n_blocks() ) {
+            std::copy( m_tail.cbegin(), m_tail.cend(), out );
+            return m_tail.size();
+        }
+        const unsigned w    = m_widths[ b ];
+        const delta_t ref   = delta_t( m_refs[ b ] );
+        if ( w == 0 ) {
+            std::fill_n( out, block_size, m_refs[ b ] );
+            return block_size;
+        }
+        const word_t* words = m_words.data() + m_starts[ b ];
+        for ( size_type j = 0; j < block_size; ++j ) {
+            out[ j ] = T( delta_t( ref + delta_t( extract( words, j, w ) ) ) );
+        }
+        return block_size;
+    }
+
+    // decode rows [first, first + n) into out, whole blocks in place
+    void decode_range( size_type first, size_type n, T* out ) const
+    {
+        std::array<T, block_size> buf;
+        const size_type last = first + n;
+        for ( size_type b = first / block_size; b * block_size < last; ++b ) {
+            const size_type start   = b * block_size;
+            const size_type lo      = std::max( first, start );
+            const size_type hi      = std::min( last, start + block_size );
+            if ( lo == start && hi == start + block_size ) {
+                decode_block( b, out + ( start - first ) );
+            } else {
+                decode_block( b, buf.data() );
+                std::copy( buf.data() + ( lo - start ), buf.data() + ( hi - start ),
+                    out + ( lo - first ) );
+            }
+        }
+    }
+
+    // f( const T* values, start row, n ) for each block
+    template<typename F>
+    void for_each_block( F f ) const
+    {
+        std::array<T, block_size> buf;
+        const size_type nb = n_blocks() + ( m_tail.empty() ? 0 : 1 );
+        for ( size_type b = 0; b < nb; ++b ) {
+            const size_type n = decode_block( b, buf.data() );
+            f( static_cast<const T*>( buf.data() ), b * block_size, n );
+        }
+    }
+
+    template<typename Acc = std::int64_t>
+    Acc sum() const
+    {
+        Acc acc {};
+        for_each_block( [&]( const T* vs, size_type, size_type n ) {
+            for ( size_type j = 0; j < n; ++j ) {
+                acc += Acc( vs[ j ] );
+            }
+        } );
+        return acc;
+    }
+
+    // number of rows in [lo, hi], skipping blocks outside the range and
+    // counting blocks inside it without decoding
+    size_type count_between( T lo, T hi ) const
+    {
+        size_type c = 0;
+        std::array<T, block_size> buf;
+        for ( size_type b = 0; b < n_blocks(); ++b ) {
+            if ( m_maxs[ b ] < lo || m_refs[ b ] > hi ) {
+                continue;
+            }
+            if ( m_refs[ b ] >= lo && m_maxs[ b ] <= hi ) {
+                c += block_size;
+                continue;
+            }
+            decode_block( b, buf.data() );
+            c += count_in( buf.data(), block_size, lo, hi );
+        }
+        return c + count_in( m_tail.data(), m_tail.size(), lo, hi );
+    }
+
+    // mutation
+
+    // Note: the packed words depend on the widths of the values, so only
+    // the per block vectors are reserved
+    void reserve( size_type sz )
+    {
+        const size_type nb = sz / block_size;
+        m_starts.reserve( nb + 1 );
+        m_refs.reserve( nb );
+        m_maxs.reserve( nb );
+        m_widths.reserve( nb );
+    }
+
+    void resize( size_type sz )
+    {
+        if ( sz >= size() ) {
+            while ( size() < sz ) {
+                push_back( T() );
+            }
+            return;
+        }
+        const size_type b = sz / block_size;
+        if ( b < n_blocks() ) {
+            std::array<T, block_size> buf;
+            decode_block( b, buf.data() );
+            truncate_blocks( b );
+            m_tail.assign( buf.begin(), buf.begin() + long( sz % block_size ) );
+        } else {
+            m_tail.resize( sz % block_size );
+        }
+    }
+
+    // in place if v is within the block's frame, otherwise the blocks
+    // from i's on are repacked
+    void set( size_type i, T v )
+    {
+        if ( i >= size() ) {
+            throw std::out_of_range( "packed_column_storage::set" );
+        }
+        const size_type b = i / block_size;
+        if ( b == n_blocks() ) {
+            m_tail[ i % block_size ] = v;
+            return;
+        }
+        const unsigned w    = m_widths[ b ];
+        const delta_t ref   = delta_t( m_refs[ b ] );
+        if ( v >= m_refs[ b ] && word_t( delta_t( delta_t( v ) - ref ) ) <= mask_for( w ) ) {
+            if ( w > 0 ) {
+                insert( m_words.data() + m_starts[ b ], i % block_size, w,
+                    word_t( delta_t( delta_t( v ) - ref ) ) );
+            }
+            m_maxs[ b ] = std::max( m_maxs[ b ], v );
+            return;
+        }
+        std::pmr::vector<T> rest( m_rsrc );
+        rest.reserve( size() - b * block_size );
+        for_each_block( [&]( const T* vs, size_type start, size_type n ) {
+            if ( start >= b * block_size ) {
+                rest.insert( rest.end(), vs, vs + n );
+            }
+        } );
+        rest[ i - b * block_size ] = v;
+        truncate_blocks( b );
+        append( rest.data(), rest.size() );
+    }
+
+    void push_back( T v )
+    {
+        m_tail.push_back( v );
+        if ( m_tail.size() == block_size ) {
+            pack_tail();
+        }
+    }
+
+    void append( const T* first, size_type n )
+    {
+        while ( n > 0 ) {
+            const size_type k = std::min( n, block_size - m_tail.size() );
+            m_tail.insert( m_tail.end(), first, first + k );
+            first += k;
+            n -= k;
+            if ( m_tail.size() == block_size ) {
+                pack_tail();
+            }
+        }
+    }
+
+    void append( const column_storage<T>& col )
+    {
+        append( col.data(), col.size() );
+    }
+
+    // decode into a plain column
+    void unpack( column_storage<T>& out ) const
+    {
+        out.reserve( out.size() + size() );
+        for_each_block( [&]( const T* vs, size_type, size_type n ) {
+            out.append( vs, n );
+        } );
+    }
+
+private:
+
+    static constexpr word_t mask_for( unsigned w ) noexcept
+    {
+        return w >= word_bits ? ~word_t( 0 ) : ( word_t( 1 ) << w ) - 1;
+    }
+
+    static constexpr size_type count_in(
+        const T* vs, size_type n, T lo, T hi ) noexcept
+    {
+        size_type c = 0;
+        for ( size_type j = 0; j < n; ++j ) {
+            c += ( vs[ j ] >= lo && vs[ j ] <= hi ) ? 1U : 0U;
+        }
+        return c;
+    }
+
+    constexpr T unpack_one( size_type b, size_type j ) const noexcept
+    {
+        const unsigned w = m_widths[ b ];
+        if ( w == 0 ) {
+            return m_refs[ b ];
+        }
+        const word_t x = extract( m_words.data() + m_starts[ b ], j, w );
+        return T( delta_t( delta_t( m_refs[ b ] ) + delta_t( x ) ) );
+    }
+
+    // the j'th w bit value, which may straddle two words
+    static constexpr word_t extract(
+        const word_t* words, size_type j, unsigned w ) noexcept
+    {
+        const size_type bit     = j * w;
+        const size_type word    = bit / word_bits;
+        const size_type shift   = bit % word_bits;
+        word_t x = words[ word ] >> shift;
+        if ( shift + w > word_bits ) {
+            x |= words[ word + 1 ] << ( word_bits - shift );
+        }
+        return x & mask_for( w );
+    }
+
+    // overwrite the j'th w bit value
+    static constexpr void insert(
+        word_t* words, size_type j, unsigned w, word_t x ) noexcept
+    {
+        const size_type bit     = j * w;
+        const size_type word    = bit / word_bits;
+        const size_type shift   = bit % word_bits;
+        const word_t mask       = mask_for( w );
+        words[ word ] = ( words[ word ] & ~( mask << shift ) ) | ( x << shift );
+        if ( shift + w > word_bits ) {
+            const size_type high = word_bits - shift;
+            words[ word + 1 ] = ( words[ word + 1 ] & ~( mask >> high ) ) | ( x >> high );
+        }
+    }
+
+    // drop packed blocks from b on, and the tail
+    void truncate_blocks( size_type b )
+    {
+        m_words.resize( m_starts[ b ] );
+        m_starts.resize( b + 1 );
+        m_refs.resize( b );
+        m_maxs.resize( b );
+        m_widths.resize( b );
+        m_tail.clear();
+    }
+
+    void pack_tail()
+    {
+        const auto [ mn, mx ] = std::minmax_element( m_tail.cbegin(), m_tail.cend() );
+        const delta_t ref   = delta_t( *mn );
+        const unsigned w    = unsigned( std::bit_width( delta_t( delta_t( *mx ) - ref ) ) );
+
+        // a block of w bit values is exactly 2w words
+        const size_type start = m_words.size();
+        m_words.resize( start + block_size * w / word_bits, 0 );
+        word_t* words = m_words.data() + start;
+        for ( size_type j = 0; w > 0 && j < block_size; ++j ) {
+            const word_t x          = word_t( delta_t( delta_t( m_tail[ j ] ) - ref ) );
+            const size_type bit     = j * w;
+            const size_type word    = bit / word_bits;
+            const size_type shift   = bit % word_bits;
+            words[ word ] |= x << shift;
+            if ( shift + w > word_bits ) {
+                words[ word + 1 ] |= x >> ( word_bits - shift );
+            }
+        }
+        m_starts.push_back( m_words.size() );
+        m_refs.push_back( *mn );
+        m_maxs.push_back( *mx );
+        m_widths.push_back( std::uint8_t( w ) );
+        m_tail.clear();
+    }
+
+    resource_ptr_t                      m_rsrc;
+    std::pmr::vector<word_t>            m_words;
+    std::pmr::vector<size_type>         m_starts;   // first word of each block
+    std::pmr::vector<T>                 m_refs;     // block minimums
+    std::pmr::vector<T>                 m_maxs;     // block maximums
+    std::pmr::vector<std::uint8_t>      m_widths;   // bits per value
+    std::pmr::vector<T>                 m_tail;     // unpacked partial block
+};
+
+
+// Packed values have no address, so blocks are decoded on first access
+// through IStorage and kept until written, i.e. untyped access costs the
+// memory of a plain column for the blocks it reads. Scans that can, should
+// decode through the typed storage (e.g. decode_range), as filter and
+// summarize do.
+//
+// The decoded blocks are guarded, so concurrent readers are safe, as for
+// other storage; writers are not.
+//
+// The packed blocks' bounds are the zone maps.
+template<typename T>
+struct untyped_packed_column_storage : public set_based_storage
+{
+    typedef packed_column_storage<T>        storage_t;
+    typedef std::shared_ptr< storage_t >    storage_ptr_t;
+
+    static constexpr size_t block_size = storage_t::block_size;
+
+    explicit untyped_packed_column_storage( storage_ptr_t storage )
+        : m_storage( storage ), m_decoded( storage->resource() )
+    {
+    }
+
+    virtual ~untyped_packed_column_storage() = default;
+
+    const storage_t& typed_storage() const noexcept
+    {
+        return *m_storage;
+    }
+
+private:
+
+    // Convenience
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    static constexpr const value_t* cv( const T* x ) noexcept
+    {
+        return reinterpret_cast<const value_t*>( x );
+    }
+
+    static constexpr const T* ct( const value_t* x ) noexcept
+    {
+        return reinterpret_cast<const T*>( x );
+    }
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+
+    // block b, decoded on first access
+    // Note: each block has its own buffer, so values keep their address
+    // as more blocks are decoded
+    const T* decoded_block( size_t b ) const
+    {
+        const std::lock_guard<std::mutex> lock( m_mutex );
+        if ( b >= m_decoded.size() ) {
+            m_decoded.resize( b + 1 );
+        }
+        auto& block = m_decoded[ b ];
+        if ( block.empty() ) {
+            block.resize( block_size );
+            block.resize( m_storage->decode_block( b, block.data() ) );
+        }
+        return block.data();
+    }
+
+    // drop decoded blocks from that holding row i on
+    void written( size_t i )
+    {
+        const std::lock_guard<std::mutex> lock( m_mutex );
+        m_decoded.resize( std::min( m_decoded.size(), i / block_size ) );
+    }
+
+public:
+
+    // IStorage interface
+
+    const value_t* at( size_t idx ) const override
+    {
+        if ( idx >= m_storage->size() ) {
+            throw std::out_of_range( "untyped_packed_column_storage::at" );
+        }
+        return cv( decoded_block( idx / block_size ) + idx % block_size );
+    }
+
+    size_t size() const noexcept override
+    {
+        return m_storage->size();
+    }
+
+    size_t capacity() const noexcept override
+    {
+        return m_storage->size();
+    }
+
+    bool empty() const noexcept override
+    {
+        return m_storage->empty();
+    }
+
+    const_iterator cbegin() const noexcept override
+    {
+        return const_value_iterator( this, 0 );
+    }
+
+    const_iterator cend() const noexcept override
+    {
+        return const_value_iterator( this, m_storage->size() );
+    }
+
+    value_t* at( size_t /* idx */ ) override
+    {
+        throw std::logic_error(
+            "Packed storage has no mutable element access, use set()" );
+    }
+
+    iterator begin() noexcept override
+    {
+        return value_iterator( this, 0 );
+    }
+
+    iterator end() noexcept override
+    {
+        return value_iterator( this, m_storage->size() );
+    }
+
+    void reserve( size_t sz ) override
+    {
+        m_storage->reserve( sz );
+    }
+
+    void resize( size_t sz ) override
+    {
+        written( std::min( sz, m_storage->size() ) );
+        m_storage->resize( sz );
+    }
+
+    void set( size_t idx, const value_t* v ) override
+    {
+        written( idx );
+        m_storage->set( idx, *ct( v ) );
+    }
+
+    void push_back( const value_t* v ) override
+    {
+        written( m_storage->size() );
+        m_storage->push_back( *ct( v ) );
+    }
+
+    void append( const value_t* first, size_t n ) override
+    {
+        written( m_storage->size() );
+        m_storage->append( ct( first ), n );
+    }
+
+    size_t zone_rows() const noexcept override
+    {
+        return block_size;
+    }
+
+    // packed blocks only, the tail is unpacked
+    std::optional<zone_t> zone( size_t z ) const noexcept override
+    {
+        if ( z >= m_storage->n_blocks() ) {
+            return std::nullopt;
+        }
+        return zone_t { cv( &m_storage->block_min( z ) ), cv( &m_storage->block_max( z ) ), 0 };
+    }
+
+    std::shared_ptr<IStorage> clone(
+        std::pmr::memory_resource* rsrc ) const override
+    {
+        return std::make_shared< untyped_packed_column_storage< T > >(
+            std::make_shared< storage_t >( *m_storage, rsrc ) );
+    }
+
+private:
+    storage_ptr_t                                   m_storage;
+    mutable std::pmr::vector< std::pmr::vector<T> > m_decoded;
+    mutable std::mutex                              m_mutex;
+};
+
+
+// Re-encode a String column with a dictionary, using the narrowest codes
+// that hold its distinct values
+RA_CPP_LIBRARY_EXPORT IValue::storage_ptr_t dictionary_encode(
+     const IStorage&            col
+    ,std::pmr::memory_resource* rsrc
+);
+
+// Re-encode an Int, Float or Double column as runs
+RA_CPP_LIBRARY_EXPORT IValue::storage_ptr_t rle_encode(
+     const IStorage&            col
+    ,const type_t&              ty
+    ,std::pmr::memory_resource* rsrc
+);
+
+// Re-encode an Int column bit-packed, see packed_column_storage
+RA_CPP_LIBRARY_EXPORT IValue::storage_ptr_t packed_encode(
+     const IStorage&            col
+    ,const type_t&              ty
+    ,std::pmr::memory_resource* rsrc
+);
+
+// Minimum average run length for Auto to pick Rle. Below this, the cost
+// of a binary search per at() is not worth the saving.
+constexpr size_t rle_min_run_length = 16;
+
+// Maximum ratio of distinct values to rows for Auto to pick Dictionary
+constexpr size_t dictionary_min_repeats = 4;
+
+// Pick an encoding for a column from its values:
+// - Rle if it has long runs (e.g. leading sort key columns)
+// - Dictionary for String columns with many repeated values
+// - Plain otherwise
+RA_CPP_LIBRARY_EXPORT encoding_t choose_encoding(
+     const IStorage&            col
+    ,const type_t&              ty
+);
+
+// Re-encode a column, see encoding_t
+// returns nullptr if the column should be left as is
+RA_CPP_LIBRARY_EXPORT IValue::storage_ptr_t encode_storage(
+     const IStorage&            col
+    ,const type_t&              ty
+    ,encoding_t                 enc
+    ,std::pmr::memory_resource* rsrc
+);
+
+}
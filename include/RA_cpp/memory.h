@@ -0,0 +1,246 @@
+#pragma once
+
+#include <memory_resource>
+#include <memory>
+#include <atomic>
+#include <limits>
+#include <new>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "base.h"
+
+#ifndef RA_CPP_LIBRARY_HPP
+#define RA_CPP_LIBRARY_HPP
+
+#include <RA_cpp/ra_cpp_library_export.hpp>
+
+#endif
+
+namespace rac
+{
+
+// Memory accounting
+//
+// accounting_resource decorates a memory_resource, counting what passes
+// through it, and can enforce a limit on live bytes, e.g. pass one to
+// relation_builder to budget a whole relation.
+//
+// Each column of a relation has its own column_resource: a pool with
+// accounting on both sides, so the report shows both what the column
+// asked for and what its pool holds, the difference being pool overhead
+// and free blocks.
+
+struct memory_stats
+{
+    size_t  bytes_allocated = 0;    // total, over the resource's life
+    size_t  bytes_live      = 0;
+    size_t  peak_bytes      = 0;    // maximum of bytes_live
+    size_t  allocations     = 0;
+    size_t  deallocations   = 0;
+
+    memory_stats& operator+=( const memory_stats& other ) noexcept
+    {
+        bytes_allocated += other.bytes_allocated;
+        bytes_live      += other.bytes_live;
+        peak_bytes      += other.peak_bytes;    // upper bound
+        allocations     += other.allocations;
+        deallocations   += other.deallocations;
+        return *this;
+    }
+};
+
+
+// Counting memory_resource decorator
+// Counters are atomic, so this is as thread safe as the upstream.
+RA_CPP_LIBRARY_EXPORT struct accounting_resource : public std::pmr::memory_resource
+{
+    static constexpr size_t no_limit = std::numeric_limits<size_t>::max();
+
+    explicit accounting_resource(
+         std::pmr::memory_resource* upstream = std::pmr::get_default_resource()
+        ,size_t                     limit = no_limit
+    )
+        : m_upstream( upstream ), m_limit( limit )
+    {
+        if ( !upstream ) {
+            throw std::invalid_argument( "Must specify pmr resource" );
+        }
+    }
+
+    accounting_resource( const accounting_resource& ) = delete;
+    accounting_resource& operator=( const accounting_resource& ) = delete;
+
+    ~accounting_resource() override = default;
+
+    std::pmr::memory_resource* upstream() const noexcept
+    {
+        return m_upstream;
+    }
+
+    memory_stats stats() const noexcept
+    {
+        return memory_stats {
+             m_allocated.load( std::memory_order_relaxed )
+            ,m_live.load( std::memory_order_relaxed )
+            ,m_peak.load( std::memory_order_relaxed )
+            ,m_allocations.load( std::memory_order_relaxed )
+            ,m_deallocations.load( std::memory_order_relaxed )
+        };
+    }
+
+    // allocations that would take live bytes over the limit throw
+    // std::bad_alloc
+    size_t limit() const noexcept
+    {
+        return m_limit.load( std::memory_order_relaxed );
+    }
+
+    void set_limit( size_t limit ) noexcept
+    {
+        m_limit.store( limit, std::memory_order_relaxed );
+    }
+
+protected:
+    void* do_allocate( size_t bytes, size_t alignment ) override
+    {
+        const size_t live = m_live.fetch_add( bytes, std::memory_order_relaxed ) + bytes;
+        if ( live > limit() ) {
+            m_live.fetch_sub( bytes, std::memory_order_relaxed );
+            throw std::bad_alloc();
+        }
+        void* p = nullptr;
+        try {
+            p = m_upstream->allocate( bytes, alignment );
+        } catch ( ... ) {
+            m_live.fetch_sub( bytes, std::memory_order_relaxed );
+            throw;
+        }
+        m_allocated.fetch_add( bytes, std::memory_order_relaxed );
+        m_allocations.fetch_add( 1, std::memory_order_relaxed );
+        size_t peak = m_peak.load( std::memory_order_relaxed );
+        while ( live > peak
+            && !m_peak.compare_exchange_weak( peak, live, std::memory_order_relaxed ) ) {
+        }
+        return p;
+    }
+
+    void do_deallocate( void* p, size_t bytes, size_t alignment ) override
+    {
+        m_upstream->deallocate( p, bytes, alignment );
+        m_live.fetch_sub( bytes, std::memory_order_relaxed );
+        m_deallocations.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept override
+    {
+        return this == &other;
+    }
+
+private:
+    std::pmr::memory_resource*  m_upstream;
+    std::atomic<size_t>         m_limit;
+    std::atomic<size_t>         m_allocated     { 0 };
+    std::atomic<size_t>         m_live          { 0 };
+    std::atomic<size_t>         m_peak          { 0 };
+    std::atomic<size_t>         m_allocations   { 0 };
+    std::atomic<size_t>         m_deallocations { 0 };
+};
+
+
+// Resource for a column's storage: a pool, accounted on both sides
+RA_CPP_LIBRARY_EXPORT struct column_resource : public std::pmr::memory_resource
+{
+    explicit column_resource(
+        std::pmr::memory_resource* upstream = std::pmr::get_default_resource()
+    )
+        : m_reserved( upstream ), m_pool( &m_reserved ), m_requested( &m_pool )
+    {
+    }
+
+    column_resource( const column_resource& ) = delete;
+    column_resource& operator=( const column_resource& ) = delete;
+
+    ~column_resource() override = default;
+
+    std::pmr::memory_resource* upstream() const noexcept
+    {
+        return m_reserved.upstream();
+    }
+
+    // asked for by the column
+    memory_stats requested() const noexcept
+    {
+        return m_requested.stats();
+    }
+
+    // taken from upstream by the pool
+    memory_stats reserved() const noexcept
+    {
+        return m_reserved.stats();
+    }
+
+protected:
+    void* do_allocate( size_t bytes, size_t alignment ) override
+    {
+        return m_requested.allocate( bytes, alignment );
+    }
+
+    void do_deallocate( void* p, size_t bytes, size_t alignment ) override
+    {
+        m_requested.deallocate( p, bytes, alignment );
+    }
+
+    bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept override
+    {
+        return this == &other;
+    }
+
+private:
+    // declaration order is construction order, upstream first
+    accounting_resource                     m_reserved;
+    std::pmr::unsynchronized_pool_resource  m_pool;
+    accounting_resource                     m_requested;
+};
+
+
+struct column_memory_usage
+{
+    std::string     name;
+    memory_stats    requested;
+    memory_stats    reserved;
+};
+
+// Memory held by a relation's columns
+// Columns shared with other relations (see relation::mutable_column) are
+// counted in each, mapped columns (see open_column_file) are not counted.
+struct memory_usage_t
+{
+    std::vector<column_memory_usage>    columns;
+
+    memory_stats requested() const noexcept
+    {
+        memory_stats total;
+        for ( const auto& c : columns ) {
+            total += c.requested;
+        }
+        return total;
+    }
+
+    memory_stats reserved() const noexcept
+    {
+        memory_stats total;
+        for ( const auto& c : columns ) {
+            total += c.reserved;
+        }
+        return total;
+    }
+};
+
+RA_CPP_LIBRARY_EXPORT std::ostream& operator<<(
+     std::ostream&          os
+    ,const memory_usage_t&  usage
+);
+
+} // namespace rac
@@ -0,0 +1,362 @@
+#pragma once
+
+#include <memory_resource>
+#include <vector>
+#include <span>
+#include <limits>
+#include <cstdint>
+#include <compare>
+#include <string>
+#include <variant>
+
+#include "base.h"
+#include "types.h"
+#include "storage.h"
+#include "relation.h"
+
+#ifndef RA_CPP_LIBRARY_HPP
+#define RA_CPP_LIBRARY_HPP
+
+#include <RA_cpp/ra_cpp_library_export.hpp>
+
+#endif
+
+namespace rac
+{
+
+// Relational operators
+//
+// Operators take relations and return new relations. Output columns are
+// plain (unencoded), each in a fresh column_resource taking memory from
+// rsrc. Values compare as by the column type's default operations, with
+// nulls equal to each other (see nullable_value_ops).
+
+
+// Rows of an input selected for an output, in output order
+typedef std::vector<size_t> row_map_t;
+
+// in a row_map_t, gathers a null
+constexpr size_t null_row = std::numeric_limits<size_t>::max();
+
+// default operations for a column type, null aware if nullable
+RA_CPP_LIBRARY_EXPORT IValue* default_ops( const type_t& ty, bool nullable );
+
+// New plain column of the values of col at rows
+// The result is nullable if col is, or rows contains null_row.
+RA_CPP_LIBRARY_EXPORT IValue::storage_ptr_t gather_column(
+     const IStorage&            col
+    ,const type_t&              ty
+    ,std::span<const size_t>    rows
+    ,std::pmr::memory_resource* rsrc
+);
+
+// Combine the hash (see hash_of) of the values of rows [first, first + n)
+// of col into hashes
+RA_CPP_LIBRARY_EXPORT void hash_column(
+     const IStorage&            col
+    ,const type_t&              ty
+    ,size_t                     first
+    ,size_t                     n
+    ,std::uint64_t*             hashes
+);
+
+// equality of two values as returned by IStorage::at() of a type,
+// consistent with hash_of
+typedef bool ( *value_eq_t )( const value_t* a, const value_t* b );
+
+RA_CPP_LIBRARY_EXPORT value_eq_t value_eq( const type_t& ty );
+
+// ordering of two values of a type, nulls first, consistent with value_eq
+typedef std::strong_ordering ( *value_cmp_t )( const value_t* a, const value_t* b );
+
+RA_CPP_LIBRARY_EXPORT value_cmp_t value_cmp( const type_t& ty );
+
+
+// Natural join, on the attributes common to a and b
+//
+// A hash join: a hash table is built over the key columns of the smaller
+// input, then probed with batches of rows of the other. Output columns
+// are gathered in one pass from the matched rows. With no common
+// attributes this is the Cartesian product.
+RA_CPP_LIBRARY_EXPORT relation natural_join(
+     const relation&            a
+    ,const relation&            b
+    ,std::pmr::memory_resource* rsrc = std::pmr::get_default_resource()
+);
+
+// probe rows hashed at a time
+constexpr size_t join_batch_rows = 1024;
+
+
+// Sort-merge natural join of inputs sorted on the common attributes
+//
+// No hash table is built: the inputs are merged in order, matching runs
+// of equal keys. Memory is only that of the output.
+//
+// Views must be of relations and on exactly the common attributes, in
+// the same order in both. Relations must be sorted on the common
+// attributes in name order (e.g. a persisted sort order), which is
+// checked, throwing std::invalid_argument if not.
+RA_CPP_LIBRARY_EXPORT relation merge_join(
+     const table_view&          a
+    ,const table_view&          b
+    ,std::pmr::memory_resource* rsrc = std::pmr::get_default_resource()
+);
+
+RA_CPP_LIBRARY_EXPORT relation merge_join(
+     const relation&            a
+    ,const relation&            b
+    ,std::pmr::memory_resource* rsrc = std::pmr::get_default_resource()
+);
+
+
+// Filter (restrict), rows of a relation satisfying a predicate
+//
+// Predicates compare columns with constants, combined with and_, or_ and
+// not_. They are evaluated filter_block_rows rows at a time into byte
+// masks, with typed loops over plain columns (others go through
+// IStorage::at()), which are turned into a selection vector of rows.
+// Blocks the column's zone maps show can't match are skipped. The
+// selected rows are then gathered column by column, and keep the keys of
+// the input.
+//
+// Comparisons use the C++ operators of the column type, so NaN fails all
+// but Ne. As in SQL, a comparison with null is unknown, and_, or_ and
+// not_ follow three valued logic, and only rows for which the predicate
+// is true are selected: so nulls fail both compare( c, Ne, x ) and
+// not_( compare( c, Eq, x ) ) (see is_null).
+
+typedef enum {
+    Eq, Ne, Lt, Le, Gt, Ge,
+} cmp_op_t;
+
+// constant of a comparison, converted to the column's type when the
+// predicate is applied, throwing std::invalid_argument if it can't be
+// (e.g. a string for an Int column, or 2.5 for an Int column)
+typedef std::variant< bool, std::int64_t, double, std::string > literal_t;
+
+struct predicate
+{
+    typedef enum {
+        Compare, IsNull, And, Or, Not,
+    } kind_t;
+
+    kind_t                  kind;
+    std::string             col;        // Compare and IsNull
+    cmp_op_t                op = Eq;    // Compare
+    literal_t               value;      // Compare
+    std::vector<predicate>  args;       // And, Or and Not
+};
+
+// col op value
+template<typename T>
+predicate compare( std::string col, cmp_op_t op, const T& value )
+{
+    literal_t lit;
+    if constexpr ( std::is_same_v<T, bool> ) {
+        lit.emplace<bool>( value );
+    } else if constexpr ( std::is_integral_v<T> ) {
+        lit.emplace<std::int64_t>( value );
+    } else if constexpr ( std::is_floating_point_v<T> ) {
+        lit.emplace<double>( value );
+    } else {
+        lit.emplace<std::string>( value );
+    }
+    return predicate { predicate::Compare, std::move( col ), op, std::move( lit ), {} };
+}
+
+inline predicate is_null( std::string col )
+{
+    return predicate { predicate::IsNull, std::move( col ), Eq, {}, {} };
+}
+
+inline predicate and_( std::vector<predicate> args )
+{
+    return predicate { predicate::And, {}, Eq, {}, std::move( args ) };
+}
+
+inline predicate or_( std::vector<predicate> args )
+{
+    return predicate { predicate::Or, {}, Eq, {}, std::move( args ) };
+}
+
+inline predicate not_( predicate arg )
+{
+    return predicate { predicate::Not, {}, Eq, {}, { std::move( arg ) } };
+}
+
+// rows evaluated at a time
+constexpr size_t filter_block_rows = 1024;
+
+// Rows of rel satisfying pred, in order
+RA_CPP_LIBRARY_EXPORT row_map_t select_rows(
+     const relation&    rel
+    ,const predicate&   pred
+);
+
+RA_CPP_LIBRARY_EXPORT relation filter(
+     const relation&            rel
+    ,const predicate&           pred
+    ,std::pmr::memory_resource* rsrc = std::pmr::get_default_resource()
+);
+
+
+// Projection on the named attributes, removing duplicate rows
+//
+// If the names include a key of rel (relation::m_keys), rows stay
+// distinct, so the result shares rel's columns, see
+// relation::select_columns, costing O(columns). Otherwise duplicates are
+// removed by hashing the projected columns, keeping the first of each
+// set of equal rows, and the result has the projected attributes as its
+// key. At least one attribute must be named.
+RA_CPP_LIBRARY_EXPORT relation project(
+     const relation&                    rel
+    ,const std::vector<std::string>&    names
+    ,std::pmr::memory_resource*         rsrc = std::pmr::get_default_resource()
+);
+
+// names includes all the attributes of one of rel's keys
+RA_CPP_LIBRARY_EXPORT bool keeps_key(
+     const relation&                    rel
+    ,const std::vector<std::string>&    names
+);
+
+
+// Cartesian product (TIMES) of relations with disjoint headers
+//
+// Not materialized: row r is row r / m of a with row r % m of b, where
+// m is b's size, so at() is index arithmetic over the inputs, which are
+// shared. Use materialize() for plain columns, or filter(), which
+// restricts the inputs before building the product.
+RA_CPP_LIBRARY_EXPORT struct product_view : IRelation
+{
+    product_view(
+         std::shared_ptr<const relation>    a
+        ,std::shared_ptr<const relation>    b
+    );
+
+    virtual ~product_view() = default;
+
+    // IRelation
+
+    const col_tys_t&    type() const noexcept override;
+    size_t              size() const noexcept override;
+    const value_t*      at( size_t row, size_t col ) const override;
+    const std::vector<IValue*>& value_ops() const noexcept override;
+
+    row_slice_t rowSlice( size_t start, size_t end ) const override;
+    col_slice_t colSlice( size_t col, size_t start, size_t end ) const override;
+
+    // each key of a with each key of b
+    const std::vector<col_tys_t>& keys() const noexcept override;
+
+    const relation& left() const noexcept
+    {
+        return *m_a;
+    }
+
+    const relation& right() const noexcept
+    {
+        return *m_b;
+    }
+
+    relation materialize(
+        std::pmr::memory_resource* rsrc = std::pmr::get_default_resource()
+    ) const;
+
+private:
+    std::shared_ptr<const relation> m_a;
+    std::shared_ptr<const relation> m_b;
+    rel_ty_t                        m_ty;
+    std::vector<IValue*>            m_ops;
+    std::vector<col_tys_t>          m_keys;
+    // per column, the input (true for a) and its column there
+    std::vector< std::pair<bool, size_t> > m_src;
+};
+
+RA_CPP_LIBRARY_EXPORT product_view product(
+     std::shared_ptr<const relation>    a
+    ,std::shared_ptr<const relation>    b
+);
+
+// Rows of the product satisfying pred
+// The conjuncts of pred on only one input are applied to that input
+// first, only the rest are evaluated on the (restricted) product.
+RA_CPP_LIBRARY_EXPORT relation filter(
+     const product_view&        prod
+    ,const predicate&           pred
+    ,std::pmr::memory_resource* rsrc = std::pmr::get_default_resource()
+);
+
+
+// Set operators on relations with the same header
+//
+// Rows are hashed over all columns into a flat, open addressing (linear
+// probing) table, so each is linear in the sizes of the inputs. Results
+// are free of duplicates and keyed on all their attributes, or on a's
+// keys for minus and intersect. Inputs with a key are known to be
+// distinct and aren't deduplicated; when a is keyed, the table is built
+// over the smaller input. An empty input costs O(columns) when the other
+// is keyed (see project).
+//
+// Rows of union_ are those of a followed by the rest of b's, and of
+// minus and intersect in a's order.
+RA_CPP_LIBRARY_EXPORT relation union_(
+     const relation&            a
+    ,const relation&            b
+    ,std::pmr::memory_resource* rsrc = std::pmr::get_default_resource()
+);
+
+RA_CPP_LIBRARY_EXPORT relation minus(
+     const relation&            a
+    ,const relation&            b
+    ,std::pmr::memory_resource* rsrc = std::pmr::get_default_resource()
+);
+
+RA_CPP_LIBRARY_EXPORT relation intersect(
+     const relation&            a
+    ,const relation&            b
+    ,std::pmr::memory_resource* rsrc = std::pmr::get_default_resource()
+);
+
+
+// Grouped aggregation (SUMMARIZE ... BY)
+//
+// Rows are grouped on the by attributes through a flat hash table,
+// summarize_batch_rows rows at a time: the batch's group ids are found
+// first, then each aggregate is updated a column at a time from them.
+// Each aggregate keeps its state as arrays over groups (sums, counts,
+// ...). With no by attributes the result is one row, and aggregates of
+// plain columns are computed by unrolled reductions over the values.
+//
+// Aggregates skip nulls. Count of no column counts rows, and Count and
+// Sum of no values are 0; Min, Max and Avg of no values are null. All
+// but Count are of Int, Float or Double columns.
+
+typedef enum {
+    Count, Sum, Min, Max, Avg,
+} agg_op_t;
+
+struct aggregate
+{
+    agg_op_t    op;
+    std::string col;    // empty for Count of rows
+    std::string as;     // name of the result attribute
+};
+
+// Type of a result: Count is Int, Sum and Avg are Double, and Min and Max
+// are of the column's type. Counts that don't fit an Int throw
+// std::overflow_error.
+RA_CPP_LIBRARY_EXPORT type_t aggregate_type( agg_op_t op, const type_t& col_ty );
+
+// rows grouped at a time
+constexpr size_t summarize_batch_rows = 1024;
+
+RA_CPP_LIBRARY_EXPORT relation summarize(
+     const relation&                    rel
+    ,const std::vector<std::string>&    by
+    ,const std::vector<aggregate>&      aggs
+    ,std::pmr::memory_resource*         rsrc = std::pmr::get_default_resource()
+);
+
+} // namespace rac
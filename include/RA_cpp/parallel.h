@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+#include "base.h"
+
+#ifndef RA_CPP_LIBRARY_HPP
+#define RA_CPP_LIBRARY_HPP
+
+#include <RA_cpp/ra_cpp_library_export.hpp>
+
+#endif
+
+namespace rac
+{
+
+// Execution policy for bulk storage operations
+//
+// Copies of trivially copyable values use memcpy/memmove. Ranges of at
+// least parallel_threshold bytes are split into chunk_size byte chunks
+// and run on a shared worker pool, smaller ranges are copied serially
+// as the hand-off costs more than it saves.
+struct bulk_policy
+{
+    size_t      parallel_threshold  = size_t( 1 ) << 24;    // 16MB
+    size_t      chunk_size          = size_t( 1 ) << 22;    // 4MB
+    unsigned    max_threads         = 0;    // 0 for hardware concurrency
+};
+
+RA_CPP_LIBRARY_EXPORT bulk_policy get_bulk_policy() noexcept;
+RA_CPP_LIBRARY_EXPORT void set_bulk_policy( const bulk_policy& policy ) noexcept;
+
+
+// Run fn( i ) for each i in [0, n) on the worker pool, using at most
+// max_threads threads (0 for hardware concurrency) including the
+// calling thread, which takes part. Returns when all are complete,
+// rethrowing the first exception.
+// Safe to call from within fn, the caller never waits on queued work.
+RA_CPP_LIBRARY_EXPORT void parallel_for(
+     size_t                                 n
+    ,const std::function<void( size_t )>&   fn
+    ,unsigned                               max_threads = 0
+);
+
+
+namespace detail
+{
+
+template<typename T>
+void serial_copy( const T* first, const T* last, T* to )
+{
+    if constexpr ( std::is_trivially_copyable_v<T> ) {
+        if ( first != last ) {
+            std::memcpy( to, first, size_t( last - first ) * sizeof( T ) );
+        }
+    } else {
+        std::copy( first, last, to );
+    }
+}
+
+template<typename T, typename F>
+bool run_chunked( size_t n, F f )
+{
+    const bulk_policy policy = get_bulk_policy();
+    if ( n * sizeof( T ) < policy.parallel_threshold ) {
+        return false;
+    }
+    const size_t chunk      = std::max( policy.chunk_size / sizeof( T ), size_t( 1 ) );
+    const size_t n_chunks   = ( n + chunk - 1 ) / chunk;
+    parallel_for( n_chunks, [&]( size_t c ) {
+        const size_t b = c * chunk;
+        f( b, std::min( b + chunk, n ) );
+    }, policy.max_threads );
+    return true;
+}
+
+}
+
+// copy [first, last) to non-overlapping to
+template<typename T>
+void bulk_copy( const T* first, const T* last, T* to )
+{
+    const auto n = size_t( last - first );
+    const bool done = detail::run_chunked<T>( n, [&]( size_t b, size_t e ) {
+        detail::serial_copy( first + b, first + e, to + b );
+    } );
+    if ( !done ) {
+        detail::serial_copy( first, last, to );
+    }
+}
+
+// move [first, last) to to, the ranges may overlap
+// Note: overlapping moves are serial, as chunks would have to be ordered
+template<typename T>
+void bulk_move( T* first, T* last, T* to )
+{
+    const auto n = size_t( last - first );
+    const bool overlap = to < last && first < to + n;
+    if ( !overlap ) {
+        const bool done = detail::run_chunked<T>( n, [&]( size_t b, size_t e ) {
+            if constexpr ( std::is_trivially_copyable_v<T> ) {
+                detail::serial_copy( first + b, first + e, to + b );
+            } else {
+                std::move( first + b, first + e, to + b );
+            }
+        } );
+        if ( done ) {
+            return;
+        }
+    }
+    if constexpr ( std::is_trivially_copyable_v<T> ) {
+        if ( n > 0 ) {
+            std::memmove( to, first, n * sizeof( T ) );
+        }
+    } else if ( to < first ) {
+        std::move( first, last, to );
+    } else {
+        std::move_backward( first, last, to + n );
+    }
+}
+
+} // namespace rac
@@ -8,10 +8,16 @@
 #include <ostream>
 #include <sstream>
 #include <ranges>
+#include <span>
+#include <array>
+#include <utility>
 
 #include "base.h"
 #include "types.h"
 #include "storage.h"
+#include "encoding.h"
+#include "statistics.h"
+#include "memory.h"
 
 #ifndef RA_CPP_LIBRARY_HPP
 #define RA_CPP_LIBRARY_HPP
@@ -81,12 +87,13 @@ struct relation_builder
 private:
     void make_storage( std::pmr::memory_resource* rsrc )
     {
+        m_rsrc = rsrc;
         for (const auto& op : m_ops ) {
             // we could use memory directly allocated from monotonic_buffer_resource
             // instead of a std::vector
             //resource_ptr_t r = std::make_shared<std::pmr::monotonic_buffer_resource>( rsrc );
             resource_ptr_t r  =
-                std::make_shared<std::pmr::unsynchronized_pool_resource>( rsrc );
+                std::make_shared<column_resource>( rsrc );
             m_cols.emplace_back( op->make_storage( r.get() ) );
             m_resources.emplace_back( r );
         }
@@ -98,6 +105,7 @@ public:
 
     // FIXME: we probably should take ownership of the resource
     template<typename Iter>
+        requires std::input_iterator<Iter>
     explicit relation_builder(
         std::pmr::memory_resource* rsrc, Iter nb, Iter ne
     ) : m_ops( get_ops<Types...>() )
@@ -119,13 +127,16 @@ public:
 
     // FIXME: concepts not working...
     //template<SequenceContainer C>
+    // Note: constrained, so a single col_desc uses the constructor below
     template<typename C>
+        requires std::ranges::range<C>
     explicit relation_builder( std::pmr::memory_resource* rsrc, const C& names )
         : relation_builder( rsrc, names.begin(), names.end() )
     {
     }
 
-    explicit relation_builder( std::pmr::memory_resource* /* unused */ )
+    explicit relation_builder( std::pmr::memory_resource* rsrc )
+        : m_rsrc( rsrc )
     {
     }
 
@@ -170,18 +181,53 @@ public:
 
     // push_back
 private:
+    // the untyped form of v, strings are encoded as records in m_records
+    template<typename T>
+    const value_t* _untyped( const T& v )
+    {
+        if constexpr ( std::is_same_v<T, std::string_view> ) {
+            m_records.assign( &v, 1 );
+            return m_records.data();
+        } else {
+            return reinterpret_cast<const value_t*>( &v );
+        }
+    }
+
+    // std::optional columns push nullptr for null, see nullable_storage
+    template<typename T>
+    void _push_value( size_t col, const T& v )
+    {
+        if constexpr ( is_optional_v<T> ) {
+            this->m_cols[col]->push_back( v ? this->_untyped( *v ) : nullptr );
+        } else {
+            this->m_cols[col]->push_back( this->_untyped( v ) );
+        }
+    }
+
+    template<typename T>
+    void _append_values( size_t col, const T* first, size_t n )
+    {
+        if constexpr ( std::is_same_v<T, std::string_view> ) {
+            m_records.assign( first, n );
+            this->m_cols[ col ]->append( m_records.data(), n );
+        } else {
+            this->m_cols[ col ]->append(
+                reinterpret_cast<const value_t*>( first ), n );
+        }
+    }
+
     template<typename T>
     constexpr void _push_back( size_t col, const T& v )
     {
         // FIXME: use assign
-        this->m_cols[col]->push_back( reinterpret_cast<const value_t*>( &v ) );
+        this->_push_value( col, v );
     }
 
     template<typename T, typename... Ts>
     constexpr void _push_back( size_t col, const T& v, Ts... vs )
     {
         // FIXME: use assign
-        this->m_cols[col]->push_back( reinterpret_cast<const value_t*>( &v ) );
+        this->_push_value( col, v );
         this->_push_back( col + 1, vs...);
     }
 public:
@@ -204,12 +250,189 @@ public:
     // FIXME: emplace_back
 
 
+    // bulk append
+    //
+    // push_back goes through one virtual call and capacity check per
+    // value, bulk appends make one call per column (or per batch)
+
+    // number of values per column copied in a single IStorage::append
+    // by append_rows
+    static constexpr size_t append_batch_size = 1024;
+
+    void reserve( size_t sz )
+    {
+        for ( const auto& col : m_cols ) {
+            col->reserve( sz );
+        }
+    }
+
+private:
+    // make room for n more rows, growing geometrically so that
+    // repeated small appends stay amortised O(1)
+    void _grow( size_t n )
+    {
+        for ( const auto& col : m_cols ) {
+            const size_t sz = col->size() + n;
+            if ( sz > col->capacity() ) {
+                col->reserve( std::max( sz, 2 * col->capacity() ) );
+            }
+        }
+    }
+
+    template<size_t... Is>
+    void _append_columns(
+         std::index_sequence<Is...>         /* unused */
+        ,const std::span<const Types>&...   cols
+    )
+    {
+        ( this->_append_span( Is, cols ), ... );
+    }
+
+    template<typename T>
+    void _append_span( size_t col, const std::span<const T>& vs )
+    {
+        if constexpr ( is_optional_v<T> ) {
+            for ( const auto& v : vs ) {
+                this->_push_value( col, v );
+            }
+        } else {
+            this->_append_values( col, vs.data(), vs.size() );
+        }
+    }
+
+    template<size_t I, typename R>
+    void _append_column( const R& rows )
+    {
+        typedef std::tuple_element_t<I, std::tuple<Types...>> T;
+
+        if constexpr ( is_optional_v<T> ) {
+            // nulls go one at a time
+            for ( const auto& row : rows ) {
+                this->_push_value( I, std::get<I>( row ) );
+            }
+        } else {
+            std::array<T, append_batch_size> batch;
+            size_t n = 0;
+            for ( const auto& row : rows ) {
+                batch[ n++ ] = std::get<I>( row );
+                if ( n == append_batch_size ) {
+                    this->_append_values( I, batch.data(), n );
+                    n = 0;
+                }
+            }
+            if ( n > 0 ) {
+                this->_append_values( I, batch.data(), n );
+            }
+        }
+    }
+
+    template<typename R, size_t... Is>
+    void _append_rows( std::index_sequence<Is...> /* unused */, const R& rows )
+    {
+        ( this->_append_column<Is>( rows ), ... );
+    }
+
+public:
+    // append whole columns, one span per column, all of the same length
+    void append_columns( std::span<const Types>... cols )
+    {
+        const std::array<size_t, sizeof...(Types)> sizes { cols.size()... };
+        for ( const auto sz : sizes ) {
+            if ( sz != sizes[ 0 ] ) {
+                throw_with< std::invalid_argument >(
+                    std::ostringstream()
+                    << "Column sizes do not match: "
+                    << sz << " and " << sizes[ 0 ]
+                );
+            }
+        }
+        this->_append_columns( std::index_sequence_for<Types...>(), cols... );
+    }
+
+    // append a range of rows (tuples, or anything supporting std::get<>)
+    // Rows are transposed a batch at a time, one column at a time
+    template<std::ranges::forward_range R>
+    void append_rows( const R& rows )
+    {
+        if constexpr ( std::ranges::sized_range<R> ) {
+            this->_grow( size_t( std::ranges::size( rows ) ) );
+        }
+        this->_append_rows( std::index_sequence_for<Types...>(), rows );
+    }
+
+
 public:
     constexpr std::tuple<Types...> at( size_t idx ) const
     {
         return col_helper<Types...>::row( m_cols, 0, idx );
     }
 
+    // re-encode a column once loaded, see encoding_t
+    // The column gets a fresh resource, so the memory of the plain
+    // column is released rather than kept in its pool
+    void encode( size_t col, encoding_t enc )
+    {
+        resource_ptr_t r =
+            std::make_shared<column_resource>( m_rsrc );
+        auto s = encode_storage(
+            *m_cols.at( col ), m_col_tys[ col ].second, enc, r.get() );
+        if ( !s ) {
+            return;
+        }
+        // release the old storage before its resource
+        m_cols[ col ]       = s;
+        m_resources[ col ]  = r;
+        if ( s->ops() ) {
+            m_ops[ col ] = s->ops();
+        }
+    }
+
+    void encode( std::string_view name, encoding_t enc )
+    {
+        auto it = std::find_if( m_col_tys.cbegin(), m_col_tys.cend(),
+            [&]( const auto& col_ty ) { return col_ty.first == name; } );
+        if ( it == m_col_tys.cend() ) {
+            throw_with<std::invalid_argument>(
+                std::ostringstream()
+                << "Unknown column '" << name << "'"
+            );
+        }
+        this->encode( size_t( it - m_col_tys.cbegin() ), enc );
+    }
+
+    // switch Int, Float and Double columns to segmented storage, so
+    // appends never move existing rows (see segmented_column_storage)
+    // Note: before loading, throws std::logic_error once there are rows
+    void segment_columns(
+        size_t segment_rows = segmented_column_storage<int>::default_segment_rows )
+    {
+        if ( size() != 0 ) {
+            throw std::logic_error( "segment_columns must be called before loading" );
+        }
+        for ( size_t col = 0; col < m_cols.size(); ++col ) {
+            resource_ptr_t r =
+                std::make_shared<column_resource>( m_rsrc );
+            auto s = make_segmented_storage(
+                m_col_tys[ col ].second, r.get(), segment_rows );
+            if ( !s || m_cols[ col ]->nullable() ) {
+                continue;
+            }
+            // release the old storage before its resource
+            m_cols[ col ]       = s;
+            m_resources[ col ]  = r;
+        }
+    }
+
+    // re-encode all columns, by default choosing per column from the data
+    // Note: columns are built plain, so call this before release() for
+    // Rle or Dictionary columns
+    void encode( encoding_t enc = Auto )
+    {
+        for ( size_t col = 0; col < m_cols.size(); ++col ) {
+            this->encode( col, enc );
+        }
+    }
+
     std::ostream& dump( std::ostream& os ) const
     {
         // dump type
@@ -242,10 +465,12 @@ public:
         return res;
     }
 
+    std::pmr::memory_resource*          m_rsrc = nullptr;
     col_tys_t                           m_col_tys;
     std::vector<IValue*>                m_ops;
     std::vector<resource_ptr_t>         m_resources;
     std::vector<IValue::storage_ptr_t>  m_cols;
+    string_record_buffer                m_records;  // see _untyped
 
     // FIXME: move this over to being fully statically typed
     // use a tuple of shared_ptr to each column_storage class
@@ -402,12 +627,41 @@ RA_CPP_LIBRARY_EXPORT struct relation : IRelation
 
     std::ostream& dump( std::ostream& os ) const;
 
+    // statistics for a column, computed on first request
+    const column_stats& stats( size_t col ) const;
+    const column_stats& stats( std::string_view name ) const;
+
+    // Copy-on-write
+    //
+    // Columns are shared, so copying a relation, or deriving one with a
+    // subset of its columns or a renamed column, is O(columns) and
+    // copies no data. A column is only copied when it is mutated
+    // through mutable_column while shared.
+
+    size_t col_index( std::string_view name ) const;
+
+    // the named columns, sharing storage
+    // Note: no duplicate elimination, so this is only a projection if
+    // the columns include a key (see project)
+    relation select_columns( const std::vector<std::string>& names ) const;
+
+    relation rename( std::string_view from, std::string_view to ) const;
+
+    // storage of a column for mutation, copied first if shared with
+    // another relation
+    // Note: call refresh_zones() on it after writing through at()
+    IStorage& mutable_column( size_t col );
+
+    // memory held by each column, see column_resource
+    memory_usage_t memory_usage() const;
+
 
     rel_ty_t                            m_ty;
     std::vector<col_tys_t>              m_keys; // FIXME: pmr
     std::vector<IValue*>                m_ops;
     std::vector<resource_ptr_t>         m_resources;
     std::vector<IValue::storage_ptr_t>  m_cols;
+    std::shared_ptr<stats_cache>        m_stats;
 };
 
 
@@ -499,6 +753,23 @@ RA_CPP_LIBRARY_EXPORT struct table_view : ITable
     row_slice_t rowSlice( size_t start, size_t end ) const override;
     col_slice_t colSlice( size_t col, size_t start, size_t end ) const override;
 
+    // the viewed relation
+    const std::shared_ptr<IRelation>& base() const noexcept
+    {
+        return m_rel;
+    }
+
+    // columns of base() in view order
+    const std::vector<size_t>& col_map() const noexcept
+    {
+        return m_col_map;
+    }
+
+    // rows of base() in view order, sorted on the view's columns
+    const std::vector<size_t>& row_map() const noexcept
+    {
+        return m_row_map;
+    }
 
 private:
     std::vector<size_t>         m_col_map;  // column map
@@ -0,0 +1,565 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <functional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base.h"
+#include "types.h"
+#include "storage.h"
+#include "relation.h"
+#include "statistics.h"
+
+#ifndef RA_CPP_LIBRARY_HPP
+#define RA_CPP_LIBRARY_HPP
+
+#include <RA_cpp/ra_cpp_library_export.hpp>
+
+#endif
+
+namespace rac
+{
+
+// Compile time relation headers
+//
+// The static counterpart of rel_ty_t: a header is a pack of attributes,
+// each a name (a string literal template argument) and a C++ type.
+//
+//     using orders_h = rel_header< attr<"Id", int>, attr<"Amount", double> >;
+//
+// header_union_t, header_intersect_t, header_project_t and
+// header_minus_t are computed by the compiler, type mismatches are
+// compile errors, and all results are in canonical (name) order, the
+// column order of a relation. So a column's position in a relation of a
+// header is a constant, see header_index_v and static_relation.
+
+template<size_t N>
+struct fixed_string
+{
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    constexpr fixed_string( const char ( &s )[ N ] )
+    {
+        std::copy_n( s, N, m_chars );
+    }
+
+    constexpr std::string_view view() const noexcept
+    {
+        return std::string_view( m_chars, N - 1 );
+    }
+
+    // public, so usable as a template argument
+    char m_chars[ N ] {};
+};
+
+template<fixed_string Name, typename T>
+struct attr
+{
+    typedef T type;
+    static constexpr std::string_view name = Name.view();
+};
+
+template<typename... Attrs>
+struct rel_header
+{
+    static constexpr size_t size = sizeof...( Attrs );
+    static constexpr std::array<std::string_view, size> names { Attrs::name... };
+
+    template<size_t I>
+    using attr_t = std::tuple_element_t< I, std::tuple< Attrs... > >;
+};
+
+
+namespace detail
+{
+
+template<typename H>
+constexpr size_t find_name( std::string_view name )
+{
+    for ( size_t i = 0; i < H::size; ++i ) {
+        if ( H::names[ i ] == name ) {
+            return i;
+        }
+    }
+    return H::size;
+}
+
+// header of the attributes of H at positions Idx
+template<typename H, auto Idx, typename Seq = std::make_index_sequence< Idx.size() > >
+struct select_attrs;
+
+template<typename H, auto Idx, size_t... I>
+struct select_attrs< H, Idx, std::index_sequence< I... > >
+{
+    using type = rel_header< typename H::template attr_t< Idx[ I ] >... >;
+};
+
+// positions of H in name order
+template<typename H>
+constexpr std::array<size_t, H::size> name_order()
+{
+    std::array<size_t, H::size> order {};
+    for ( size_t i = 0; i < H::size; ++i ) {
+        order[ i ] = i;
+    }
+    std::sort( order.begin(), order.end(),
+        []( size_t a, size_t b ) { return H::names[ a ] < H::names[ b ]; } );
+    return order;
+}
+
+template<typename H>
+constexpr bool distinct_names()
+{
+    constexpr auto order = name_order<H>();
+    for ( size_t i = 1; i < H::size; ++i ) {
+        if ( H::names[ order[ i - 1 ] ] == H::names[ order[ i ] ] ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// number of attributes of A whose presence in B is In
+template<typename A, typename B, bool In>
+constexpr size_t count_in()
+{
+    size_t n = 0;
+    for ( size_t i = 0; i < A::size; ++i ) {
+        n += ( find_name<B>( A::names[ i ] ) < B::size ) == In ? 1U : 0U;
+    }
+    return n;
+}
+
+template<typename A, typename B, bool In>
+constexpr auto positions_in()
+{
+    std::array<size_t, count_in<A, B, In>()> idx {};
+    size_t n = 0;
+    for ( size_t i = 0; i < A::size; ++i ) {
+        if ( ( find_name<B>( A::names[ i ] ) < B::size ) == In ) {
+            idx[ n++ ] = i;
+        }
+    }
+    return idx;
+}
+
+template<typename A, typename B>
+struct concat;
+
+template<typename... As, typename... Bs>
+struct concat< rel_header< As... >, rel_header< Bs... > >
+{
+    using type = rel_header< As..., Bs... >;
+};
+
+// attributes shared by A and B have the same type
+template<typename A, typename B, size_t... I>
+constexpr bool shared_types_match( std::index_sequence< I... > )
+{
+    return ( [] {
+        constexpr size_t j = find_name<B>( A::names[ I ] );
+        if constexpr ( j < B::size ) {
+            return std::is_same_v<
+                 typename A::template attr_t< I >::type
+                ,typename B::template attr_t< j >::type >;
+        } else {
+            return true;
+        }
+    }() && ... );
+}
+
+template<typename A, typename B>
+constexpr bool shared_types_match()
+{
+    return shared_types_match<A, B>( std::make_index_sequence< A::size >() );
+}
+
+}
+
+
+// canonical form, attributes in name order
+template<typename H>
+struct header_canonical
+{
+    static_assert( detail::distinct_names<H>(), "Attribute name repeated" );
+    using type = typename detail::select_attrs< H, detail::name_order<H>() >::type;
+};
+
+template<typename H>
+using canonical_t = typename header_canonical<H>::type;
+
+
+// position of a name in the canonical form, i.e. the relation column
+template<typename H, fixed_string Name>
+constexpr size_t header_index_v = [] {
+    constexpr size_t i = detail::find_name< canonical_t<H> >( Name.view() );
+    static_assert( i < H::size, "No such attribute" );
+    return i;
+}();
+
+template<typename H, fixed_string Name>
+constexpr bool header_contains_v = detail::find_name<H>( Name.view() ) < H::size;
+
+template<typename H, fixed_string Name>
+using attr_type_t = typename canonical_t<H>::template attr_t< header_index_v<H, Name> >::type;
+
+
+template<typename A, typename B>
+struct header_union
+{
+    static_assert( detail::shared_types_match<A, B>(),
+        "Types of shared attributes do not match" );
+    using type = canonical_t< typename detail::concat< A,
+        typename detail::select_attrs< B, detail::positions_in<B, A, false>() >::type
+    >::type >;
+};
+
+template<typename A, typename B>
+using header_union_t = typename header_union<A, B>::type;
+
+template<typename A, typename B>
+struct header_intersect
+{
+    static_assert( detail::shared_types_match<A, B>(),
+        "Types of shared attributes do not match" );
+    using type = canonical_t<
+        typename detail::select_attrs< A, detail::positions_in<A, B, true>() >::type >;
+};
+
+template<typename A, typename B>
+using header_intersect_t = typename header_intersect<A, B>::type;
+
+// attributes of A not in B
+template<typename A, typename B>
+using header_minus_t = canonical_t<
+    typename detail::select_attrs< A, detail::positions_in<A, B, false>() >::type >;
+
+template<typename H, fixed_string... Names>
+struct header_project
+{
+    using names_t = rel_header< attr< Names, void >... >;
+    static_assert( detail::count_in<names_t, H, true>() == sizeof...( Names ),
+        "No such attribute" );
+    using type = canonical_t<
+        typename detail::select_attrs< H, detail::positions_in<H, names_t, true>() >::type >;
+};
+
+template<typename H, fixed_string... Names>
+using header_project_t = typename header_project<H, Names...>::type;
+
+// same attributes, in any order
+template<typename A, typename B>
+constexpr bool same_header_v = std::is_same_v< canonical_t<A>, canonical_t<B> >;
+
+
+// positions in the canonical forms of A and B of their shared
+// attributes, in name order, e.g. the key columns of a natural join
+template<typename A, typename B>
+struct shared_positions
+{
+    using key_t = header_intersect_t<A, B>;
+
+    static constexpr auto positions( auto side )
+    {
+        using H = canonical_t< decltype( side ) >;
+        std::array<size_t, key_t::size> idx {};
+        for ( size_t i = 0; i < key_t::size; ++i ) {
+            idx[ i ] = detail::find_name<H>( key_t::names[ i ] );
+        }
+        return idx;
+    }
+
+    static constexpr auto a = positions( A() );
+    static constexpr auto b = positions( B() );
+};
+
+
+// runtime header
+template<typename H>
+col_tys_t to_col_tys()
+{
+    return [] <size_t... I>( std::index_sequence< I... > ) {
+        return col_tys_t {
+            { std::string( H::names[ I ] ),
+              type_t_traits< typename H::template attr_t< I >::type >::ty() }...
+        };
+    }( std::make_index_sequence< H::size >() );
+}
+
+template<typename H>
+rel_ty_t to_rel_ty()
+{
+    return rel_ty_t( to_col_tys<H>() );
+}
+
+// relation_builder for the attributes of H, in H's order
+template<typename H>
+auto make_header_builder( std::pmr::memory_resource* rsrc )
+{
+    return [&] <size_t... I>( std::index_sequence< I... > ) {
+        return relation_builder< typename H::template attr_t< I >::type... >(
+            rsrc, col_desc< typename H::template attr_t< I >::type >( H::names[ I ] )... );
+    }( std::make_index_sequence< H::size >() );
+}
+
+
+namespace detail
+{
+
+// the column_storage behind a column of T, or nullptr for other storage
+// (encoded, segmented, mapped, nullable), read through IStorage instead
+template<typename T>
+const column_storage<T>* typed_column( const IStorage& s ) noexcept
+{
+    if constexpr ( std::is_same_v<T, bool> || std::is_same_v<T, int>
+            || std::is_same_v<T, float> || std::is_same_v<T, double>
+            || std::is_same_v<T, std::string_view> ) {
+        const auto* u = dynamic_cast< const untyped_column_storage<T>* >( &s );
+        return u ? &u->typed_storage() : nullptr;
+    } else {
+        return nullptr;
+    }
+}
+
+template<typename H, typename Seq = std::make_index_sequence< H::size > >
+struct typed_columns;
+
+template<typename H, size_t... I>
+struct typed_columns< H, std::index_sequence< I... > >
+{
+    using type = std::tuple<
+        const column_storage< typename H::template attr_t< I >::type >*... >;
+
+    static type resolve( const relation& rel ) noexcept
+    {
+        return type( typed_column< typename H::template attr_t< I >::type >(
+            *rel.m_cols[ I ] )... );
+    }
+};
+
+}
+
+
+// A relation known to have header H
+//
+// The header is checked once, on construction, when the typed storage of
+// each column is also resolved, after which columns are found by
+// constant index and values read directly from their storage.
+//
+// Nullable columns need std::optional attributes.
+template<typename H>
+struct static_relation
+{
+    typedef canonical_t<H> header_t;
+
+    template<size_t I>
+    using type_at_t = typename header_t::template attr_t< I >::type;
+
+    explicit static_relation( relation rel ) : m_rel( std::move( rel ) )
+    {
+        if ( !( m_rel.m_ty == to_rel_ty<H>() ) ) {
+            throw_with< std::invalid_argument >(
+                std::ostringstream()
+                << "Relation type " << col_tys_to_string( m_rel.type() )
+                << " does not match " << col_tys_to_string( to_col_tys<header_t>() )
+            );
+        }
+        [&] <size_t... I>( std::index_sequence< I... > ) {
+            ( check_nullable< I >(), ... );
+        }( std::make_index_sequence< header_t::size >() );
+        m_typed = detail::typed_columns<header_t>::resolve( m_rel );
+    }
+
+    size_t size() const noexcept
+    {
+        return m_rel.size();
+    }
+
+    template<fixed_string Name>
+    static constexpr size_t index() noexcept
+    {
+        return header_index_v<H, Name>;
+    }
+
+    // value of the column at position I of header_t
+    template<size_t I>
+    type_at_t<I> value( size_t row ) const
+    {
+        if ( const auto* s = std::get< I >( m_typed ) ) {
+            return s->at( row );
+        }
+        // Note: not the mutable at(), which encoded storage doesn't have
+        return value_ops< type_at_t<I> >::get( std::as_const( *m_rel.m_cols[ I ] ).at( row ) );
+    }
+
+    template<fixed_string Name>
+    attr_type_t<H, Name> get( size_t row ) const
+    {
+        return value< index<Name>() >( row );
+    }
+
+    template<fixed_string Name>
+    const IStorage& column() const noexcept
+    {
+        return *m_rel.m_cols[ index<Name>() ];
+    }
+
+    const relation& rel() const noexcept
+    {
+        return m_rel;
+    }
+
+private:
+    template<size_t I>
+    void check_nullable() const
+    {
+        if ( !is_optional_v< type_at_t<I> > && m_rel.m_cols[ I ]->nullable() ) {
+            throw_with< std::invalid_argument >(
+                std::ostringstream()
+                << "Column '" << header_t::names[ I ]
+                << "' is nullable, but its attribute is not std::optional"
+            );
+        }
+    }
+
+    relation                                        m_rel;
+    typename detail::typed_columns<header_t>::type  m_typed;
+};
+
+
+namespace detail
+{
+
+// value of column J of the join of A and B, from A when it has the
+// attribute
+template<typename U, size_t J, typename A, typename B>
+auto join_value(
+     const static_relation<A>&  a
+    ,const static_relation<B>&  b
+    ,size_t                     ra
+    ,size_t                     rb
+)
+{
+    constexpr size_t i = find_name< canonical_t<A> >( U::names[ J ] );
+    if constexpr ( i < A::size ) {
+        return a.template value< i >( ra );
+    } else {
+        return b.template value< find_name< canonical_t<B> >( U::names[ J ] ) >( rb );
+    }
+}
+
+template<typename K, typename Seq = std::make_index_sequence< K::size > >
+struct join_key_type;
+
+template<typename K, size_t... I>
+struct join_key_type< K, std::index_sequence< I... > >
+{
+    using type = std::tuple< typename K::template attr_t< I >::type... >;
+};
+
+template<typename K>
+using join_key_t = typename join_key_type<K>::type;
+
+// values of the key columns K, at positions Pos of r
+template<typename K, auto Pos, typename R>
+join_key_t<K> join_key( const R& r, size_t row )
+{
+    return [&] <size_t... I>( std::index_sequence< I... > ) {
+        return join_key_t<K>( r.template value< Pos[ I ] >( row )... );
+    }( std::make_index_sequence< K::size >() );
+}
+
+// equality and hash of key values as in rac::natural_join (see value_eq
+// and hash_of): NaNs are equal, as are nulls
+template<typename T>
+bool key_eq( const T& x, const T& y ) noexcept
+{
+    if constexpr ( is_optional_v<T> ) {
+        return x.has_value() == y.has_value() && ( !x || key_eq( *x, *y ) );
+    } else {
+        return strong_ordering<T>::cmp( &x, &y ) == std::strong_ordering::equal;
+    }
+}
+
+template<typename T>
+std::uint64_t key_hash( const T& x ) noexcept
+{
+    if constexpr ( is_optional_v<T> ) {
+        return x ? hash_of( *x ) : 0;
+    } else {
+        return hash_of( x );
+    }
+}
+
+struct tuple_eq
+{
+    template<typename... Ts>
+    bool operator()( const std::tuple< Ts... >& x, const std::tuple< Ts... >& y ) const noexcept
+    {
+        return [&] <size_t... I>( std::index_sequence< I... > ) {
+            return ( key_eq( std::get< I >( x ), std::get< I >( y ) ) && ... );
+        }( std::index_sequence_for< Ts... >() );
+    }
+};
+
+struct tuple_hash
+{
+    template<typename... Ts>
+    size_t operator()( const std::tuple< Ts... >& t ) const noexcept
+    {
+        return std::apply( []( const auto&... v ) {
+            std::uint64_t h = 0;
+            ( ( h = hash_mix( h ^ key_hash( v ) ) ), ... );
+            return size_t( h );
+        }, t );
+    }
+};
+
+}
+
+// Natural join of relations with static headers
+//
+// The key columns (see shared_positions) and the side each output column
+// comes from are resolved at compile time. Hash join, building on b, with
+// the output in the row order of a.
+template<typename A, typename B>
+static_relation< header_union_t<A, B> > natural_join(
+     const static_relation<A>&  a
+    ,const static_relation<B>&  b
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    using pos_t = shared_positions<A, B>;
+    using key_t = typename pos_t::key_t;
+    using out_t = header_union_t<A, B>;
+
+    std::unordered_map<
+         detail::join_key_t<key_t>
+        ,std::vector<size_t>
+        ,detail::tuple_hash
+        ,detail::tuple_eq > rows;
+    for ( size_t rb = 0; rb < b.size(); ++rb ) {
+        rows[ detail::join_key< key_t, pos_t::b >( b, rb ) ].push_back( rb );
+    }
+
+    auto builder = make_header_builder<out_t>( rsrc );
+    for ( size_t ra = 0; ra < a.size(); ++ra ) {
+        const auto it = rows.find( detail::join_key< key_t, pos_t::a >( a, ra ) );
+        if ( it == rows.end() ) {
+            continue;
+        }
+        for ( const size_t rb : it->second ) {
+            [&] <size_t... J>( std::index_sequence< J... > ) {
+                builder.push_back( detail::join_value< out_t, J >( a, b, ra, rb )... );
+            }( std::make_index_sequence< out_t::size >() );
+        }
+    }
+    return static_relation<out_t>( relation( builder.release() ) );
+}
+
+} // namespace rac
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <bit>
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+#include <limits>
+#include <functional>
+#include <string_view>
+
+#include "base.h"
+#include "types.h"
+#include "storage.h"
+
+#ifndef RA_CPP_LIBRARY_HPP
+#define RA_CPP_LIBRARY_HPP
+
+#include <RA_cpp/ra_cpp_library_export.hpp>
+
+#endif
+
+namespace rac
+{
+
+// Column statistics
+//
+// Summaries of a column's values for sizing (e.g. hash tables) and
+// choosing between algorithms: row and null counts, min/max, an
+// approximate distinct count (HyperLogLog) and an equi-depth histogram.
+//
+// Computed in a single pass plus a sort of a bounded sample, see
+// compute_column_stats. relation::stats() computes them lazily, on
+// first request.
+
+
+// HyperLogLog distinct count sketch
+//
+// 2^precision one byte registers, standard error about
+// 1.04 / sqrt( 2^precision ), i.e. 1.6% for the default of 12.
+// Sketches with the same precision can be merged, e.g. across
+// partitions.
+struct hyperloglog
+{
+    static constexpr unsigned default_precision = 12;
+
+    explicit hyperloglog( unsigned precision = default_precision )
+        : m_precision( precision ), m_registers( size_t( 1 ) << precision, 0 )
+    {
+        if ( precision < 4 || precision > 18 ) {
+            throw_with< std::invalid_argument >(
+                std::ostringstream()
+                << "HyperLogLog precision must be in [4, 18], not "
+                << precision
+            );
+        }
+    }
+
+    unsigned precision() const noexcept
+    {
+        return m_precision;
+    }
+
+    // add a (well mixed) 64 bit hash of a value
+    void add( std::uint64_t h ) noexcept
+    {
+        const size_t idx        = h >> ( 64 - m_precision );
+        const std::uint64_t w   = h << m_precision;
+        const auto rho = std::uint8_t( w == 0
+            ? 64 - m_precision + 1
+            : unsigned( std::countl_zero( w ) ) + 1 );
+        m_registers[ idx ] = std::max( m_registers[ idx ], rho );
+    }
+
+    void merge( const hyperloglog& other )
+    {
+        if ( other.m_precision != m_precision ) {
+            throw std::invalid_argument(
+                "Cannot merge HyperLogLog sketches of different precision" );
+        }
+        for ( size_t i = 0; i < m_registers.size(); ++i ) {
+            m_registers[ i ] = std::max( m_registers[ i ], other.m_registers[ i ] );
+        }
+    }
+
+    RA_CPP_LIBRARY_EXPORT double estimate() const noexcept;
+
+private:
+    unsigned                    m_precision;
+    std::vector<std::uint8_t>   m_registers;
+};
+
+
+// splitmix64 finaliser, spreads std::hash (often the identity) over all
+// 64 bits, as HyperLogLog and hash tables indexed by the low bits need
+constexpr std::uint64_t hash_mix( std::uint64_t x ) noexcept
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// 64 bit hash of a value, consistent with IValue::cmp of the type's
+// default operations (e.g. -0.0 and 0.0 hash the same)
+template<typename T>
+std::uint64_t hash_of( const T& x ) noexcept
+{
+    if constexpr ( std::is_floating_point_v<T> ) {
+        // -0.0 == 0.0, and all NaN compare equal
+        const double d = std::isnan( x ) ? std::numeric_limits<double>::quiet_NaN()
+            : ( x == 0 ? 0.0 : double( x ) );
+        return hash_mix( std::bit_cast<std::uint64_t>( d ) );
+    } else if constexpr ( std::is_same_v<T, std::string_view> ) {
+        return hash_mix( std::hash<std::string_view>()( x ) );
+    } else {
+        return hash_mix( std::uint64_t( std::int64_t( x ) ) );
+    }
+}
+
+// hash_of a value as returned by IStorage::at(), 0 for null
+RA_CPP_LIBRARY_EXPORT std::uint64_t hash_value(
+     const type_t&  ty
+    ,const value_t* v
+);
+
+
+// Equi-depth histogram bucket, the rows with values in
+// ( previous bucket's upper, upper ]
+struct histogram_bucket
+{
+    const value_t*  upper;      // points into the column
+    size_t          rows;       // estimated
+    size_t          distinct;   // estimated
+};
+
+
+struct column_stats
+{
+    size_t                          row_count   = 0;
+    size_t                          null_count  = 0;
+    const value_t*                  min         = nullptr;  // into the column,
+    const value_t*                  max         = nullptr;  // nullptr if all null
+    double                          distinct    = 0;
+    std::vector<histogram_bucket>   histogram;
+
+    // estimated number of rows with values <= v, from the histogram
+    RA_CPP_LIBRARY_EXPORT double rows_le(
+         const IValue&  ops
+        ,const value_t* v
+    ) const;
+};
+
+
+// rows sampled for histograms
+constexpr size_t histogram_sample_rows = size_t( 1 ) << 16;
+constexpr size_t default_histogram_buckets = 32;
+
+// Compute statistics for a column, ops must be the column's operations
+// (see IRelationBase::value_ops). Pointers in the result point into
+// col, so are valid for as long as it is.
+RA_CPP_LIBRARY_EXPORT column_stats compute_column_stats(
+     const IStorage&    col
+    ,const IValue&      ops
+    ,size_t             n_buckets = default_histogram_buckets
+);
+
+
+// Lazily computed statistics for each column of a relation, shared by
+// copies of the relation
+struct stats_cache
+{
+    explicit stats_cache( size_t n_cols ) : m_stats( n_cols )
+    {
+    }
+
+    template<typename F>
+    const column_stats& get( size_t col, F compute ) const
+    {
+        const std::lock_guard<std::mutex> lock( m_mutex );
+        auto& s = m_stats.at( col );
+        if ( !s ) {
+            s = std::make_unique<column_stats>( compute() );
+        }
+        return *s;
+    }
+
+private:
+    mutable std::mutex                                  m_mutex;
+    mutable std::vector< std::unique_ptr<column_stats> > m_stats;
+};
+
+} // namespace rac
@@ -9,9 +9,22 @@
 #include <ostream>
 #include <sstream>
 #include <cmath>
+#include <bit>
+#include <array>
+#include <utility>
+#include <string_view>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <cstdint>
+#include <new>
 
 #include "base.h"
 #include "types.h"
+#include "parallel.h"
 
 #ifndef RA_CPP_LIBRARY_HPP
 #define RA_CPP_LIBRARY_HPP
@@ -28,11 +41,21 @@ struct value_t{};
 
 // FIXME: use std::iterator
 
+struct IStorage;
+struct IValue;
+
 // Note: we implement as much of the stdlib iterators as makes sense
 // As we are abstracting over variable sized storage of unknown type
 // we cannot provide anything where the type leaks
 // - no dereferencing, so std::copy and std::move cannot work with
 // these iterators
+//
+// Iterators come in two flavours:
+// - contiguous: a pointer and element size, for storage that is a
+//   plain array of values
+// - indexed: a storage and row index, for storage where values are not
+//   laid out contiguously (e.g. bit-packed), get() goes through
+//   IStorage::at()
 struct const_value_iterator
 {
     //typedef const value_t*  value_type;
@@ -43,33 +66,39 @@ struct const_value_iterator
         : m_ptr( ptr ), m_size( size )
     {}
 
+    explicit constexpr const_value_iterator(
+         const IStorage*    storage
+        ,size_t             idx
+    ) : m_ptr( nullptr ), m_size( 0 ), m_storage( storage ), m_idx( idx )
+    {}
+
 
     // Iterator
 
     // operator* purposefully left out
     constexpr const_value_iterator& operator++() noexcept
     {
-        m_ptr += m_size;
-        return *this;
+        return this->advance( 1 );
     }
 
     // ForwardIterator
     constexpr const_value_iterator operator++(int) noexcept // post increment
     {
-        return const_value_iterator( m_ptr + m_size, m_size );
+        auto it = *this;
+        return it.advance( 1 );
     }
 
     // BidirectionalIterator
 
     constexpr const_value_iterator& operator--() noexcept
     {
-        m_ptr -= m_size;
-        return *this;
+        return this->advance( -1 );
     }
 
     constexpr const_value_iterator operator--(int) noexcept // post-decrement
     {
-        return const_value_iterator( m_ptr - m_size, m_size );
+        auto it = *this;
+        return it.advance( -1 );
     }
 
     // RandomAccessIterator
@@ -82,29 +111,60 @@ struct const_value_iterator
 
     constexpr const_value_iterator& operator+=(size_t n) noexcept
     {
-        m_ptr += n * m_size;
-        return *this;
+        return this->advance( static_cast<difference_type>( n ) );
     }
 
     constexpr const_value_iterator& operator-=(size_t n) noexcept
     {
-        m_ptr -= n * m_size;
-        return *this;
+        return this->advance( -static_cast<difference_type>( n ) );
     }
 
-    constexpr const value_t* get() const noexcept
+    constexpr const_value_iterator& advance( difference_type d ) noexcept
     {
-        return m_ptr;
+        if ( m_storage ) {
+            m_idx = static_cast<size_t>( static_cast<difference_type>( m_idx ) + d );
+        } else {
+            m_ptr += d * static_cast<difference_type>( m_size );
+        }
+        return *this;
     }
 
+    // defined after IStorage
+    inline const value_t* get() const;
+
     constexpr size_t elem_size() const noexcept
     {
         return m_size;
     }
 
+    constexpr bool contiguous() const noexcept
+    {
+        return m_storage == nullptr;
+    }
+
+    constexpr const IStorage* storage() const noexcept
+    {
+        return m_storage;
+    }
+
+    constexpr size_t index() const noexcept
+    {
+        return m_idx;
+    }
+
+    // position for comparison, pointer for contiguous, index otherwise
+    constexpr difference_type pos() const noexcept
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return m_storage ? static_cast<difference_type>( m_idx )
+            : reinterpret_cast<difference_type>( m_ptr );
+    }
+
 private:
     const value_t*  m_ptr;
     size_t          m_size;
+    const IStorage* m_storage = nullptr;
+    size_t          m_idx = 0;
 };
 
 
@@ -113,12 +173,8 @@ constexpr const_value_iterator operator+(
      const const_value_iterator&    it
     ,const T                        d
 ) noexcept {
-    return const_value_iterator(
-         it.get()
-            + static_cast<const_value_iterator::difference_type>(d)
-            * static_cast<long>(it.elem_size())
-        ,it.elem_size()
-    );
+    auto res = it;
+    return res.advance( static_cast<const_value_iterator::difference_type>(d) );
 }
 
 template<typename T>
@@ -126,19 +182,18 @@ constexpr const_value_iterator operator+(
      const T                        d
     ,const const_value_iterator&    it
 ) noexcept {
-    return const_value_iterator(
-         it.get()
-            + static_cast<const_value_iterator::difference_type>(d)
-            * static_cast<long>(it.elem_size())
-        ,it.elem_size()
-    );
+    auto res = it;
+    return res.advance( static_cast<const_value_iterator::difference_type>(d) );
 }
 
 constexpr const_value_iterator::difference_type operator-(
      const const_value_iterator& a
     ,const const_value_iterator& b
 ) noexcept {
-    return ( a.get() - b.get() ) / static_cast<long>(a.elem_size());
+    if ( !a.contiguous() ) {
+        return a.pos() - b.pos();
+    }
+    return ( a.pos() - b.pos() ) / static_cast<long>(a.elem_size());
 }
 
 template<typename T>
@@ -146,26 +201,22 @@ constexpr const_value_iterator operator-(
      const const_value_iterator&    a
     ,const T                        b
 ) noexcept {
-    return const_value_iterator(
-         a.get()
-            - ( static_cast<const_value_iterator::difference_type>(b)
-                * static_cast<long>(a.elem_size()) )
-        ,a.elem_size()
-    );
+    auto res = a;
+    return res.advance( -static_cast<const_value_iterator::difference_type>(b) );
 }
 
 constexpr bool operator==(
      const const_value_iterator& a
     ,const const_value_iterator& b
 ) {
-    return a.get() == b.get();
+    return a.storage() == b.storage() && a.pos() == b.pos();
 }
 
 constexpr auto operator<=>(
      const const_value_iterator& a
     ,const const_value_iterator& b
 ) {
-    return a.get() <=> b.get();
+    return a.pos() <=> b.pos();
 }
 
 
@@ -178,32 +229,36 @@ struct value_iterator
         : m_ptr( ptr ), m_size( size )
     {}
 
+    constexpr explicit value_iterator( IStorage* storage, size_t idx )
+        : m_ptr( nullptr ), m_size( 0 ), m_storage( storage ), m_idx( idx )
+    {}
+
     // Iterator
 
     // operator* purposefully left out
     constexpr value_iterator& operator++() noexcept
     {
-        m_ptr += m_size;
-        return *this;
+        return this->advance( 1 );
     }
 
     // ForwardIterator
     constexpr value_iterator operator++(int) noexcept // post increment
     {
-        return value_iterator( m_ptr + m_size, m_size );
+        auto it = *this;
+        return it.advance( 1 );
     }
 
     // BidirectionalIterator
 
     constexpr value_iterator& operator--() noexcept
     {
-        m_ptr -= m_size;
-        return *this;
+        return this->advance( -1 );
     }
 
     constexpr value_iterator operator--(int) noexcept // post-decrement
     {
-        return value_iterator( m_ptr - m_size, m_size );
+        auto it = *this;
+        return it.advance( -1 );
     }
 
     // RandomAccessIterator
@@ -212,29 +267,64 @@ struct value_iterator
 
     constexpr value_iterator& operator+=( size_t n ) noexcept
     {
-        m_ptr += n * m_size;
-        return *this;
+        return this->advance( static_cast<difference_type>( n ) );
     }
 
     constexpr value_iterator& operator-=( size_t n ) noexcept
     {
-        m_ptr -= n * m_size;
-        return *this;
+        return this->advance( -static_cast<difference_type>( n ) );
     }
 
-    constexpr value_t* get() const noexcept
+    constexpr value_iterator& advance( difference_type d ) noexcept
     {
-        return m_ptr;
+        if ( m_storage ) {
+            m_idx = static_cast<size_t>( static_cast<difference_type>( m_idx ) + d );
+        } else {
+            m_ptr += d * static_cast<difference_type>( m_size );
+        }
+        return *this;
     }
 
+    // defined after IStorage
+    // Note: indexed iterators over storage without addressable values
+    // (e.g. bit-packed) will throw, use IStorage::set() instead
+    inline value_t* get() const;
+
+    // read only access, for storage without mutable element access
+    inline const value_t* cget() const;
+
     constexpr size_t elem_size() const noexcept
     {
         return m_size;
     }
 
+    constexpr bool contiguous() const noexcept
+    {
+        return m_storage == nullptr;
+    }
+
+    constexpr IStorage* storage() const noexcept
+    {
+        return m_storage;
+    }
+
+    constexpr size_t index() const noexcept
+    {
+        return m_idx;
+    }
+
+    constexpr difference_type pos() const noexcept
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return m_storage ? static_cast<difference_type>( m_idx )
+            : reinterpret_cast<difference_type>( m_ptr );
+    }
+
 private:
     value_t*    m_ptr;
     size_t      m_size;
+    IStorage*   m_storage = nullptr;
+    size_t      m_idx = 0;
 };
 
 
@@ -243,12 +333,8 @@ constexpr value_iterator operator+(
      const value_iterator&  it
     ,const T                d
 ) noexcept {
-    return value_iterator(
-         it.get()
-            + static_cast<value_iterator::difference_type>(d)
-            * static_cast<long>(it.elem_size())
-        ,it.elem_size()
-    );
+    auto res = it;
+    return res.advance( static_cast<value_iterator::difference_type>(d) );
 }
 
 template<typename T>
@@ -256,19 +342,18 @@ constexpr value_iterator operator+(
      const T                d
     ,const value_iterator&  it
 ) noexcept {
-    return value_iterator(
-         it.get()
-            + static_cast<value_iterator::difference_type>(d)
-            * static_cast<long>(it.elem_size())
-        ,it.elem_size()
-    );
+    auto res = it;
+    return res.advance( static_cast<value_iterator::difference_type>(d) );
 }
 
 constexpr value_iterator::difference_type operator-(
      const value_iterator& a
     ,const value_iterator& b
 ) noexcept {
-    return ( a.get() - b.get() ) / static_cast<long>(a.elem_size());
+    if ( !a.contiguous() ) {
+        return a.pos() - b.pos();
+    }
+    return ( a.pos() - b.pos() ) / static_cast<long>(a.elem_size());
 }
 
 template<typename T>
@@ -276,27 +361,34 @@ constexpr value_iterator operator-(
      const value_iterator&  a
     ,const T                b
 ) noexcept {
-    return value_iterator(
-         a.get()
-            - ( static_cast<value_iterator::difference_type>(b)
-                * static_cast<long>(a.elem_size()) )
-        ,a.elem_size()
-    );
+    auto res = a;
+    return res.advance( -static_cast<value_iterator::difference_type>(b) );
 }
 
 constexpr bool operator==( const value_iterator& a, const value_iterator& b )
 {
-    return a.get() == b.get();
+    return a.storage() == b.storage() && a.pos() == b.pos();
 }
 
 constexpr auto operator<=>( const value_iterator& a, const value_iterator& b )
 {
-    return a.get() <=> b.get();
+    return a.pos() <=> b.pos();
 }
 
 
 
 
+// Zone map entry, the bounds of the values in a block of rows
+// min and max are in the storage's representation (as from at()), and
+// may be conservative (e.g. after overwriting values)
+struct zone_t
+{
+    const value_t*  min;
+    const value_t*  max;
+    size_t          null_count;
+};
+
+
 // untyped access to aligned, contiguous storage of monotyped values
 //
 // tempting to split out interfaces into pure and mutable, but all
@@ -307,9 +399,14 @@ RA_CPP_LIBRARY_EXPORT struct IStorage
     typedef const_value_iterator    const_iterator;
     typedef value_iterator          iterator;
 
+    // Values read (at) and written (set, push_back, append) have the same
+    // representation, so s.push_back( other.at( i ) ) copies a row of a
+    // column of the same type. For String values are string_records.
+
     // immutable access
     virtual const value_t*  at( size_t idx ) const = 0;
     virtual size_t          size() const noexcept = 0;
+    virtual size_t          capacity() const noexcept = 0;
     virtual bool            empty() const noexcept = 0;
     virtual const_iterator  cbegin() const noexcept = 0;
     virtual const_iterator  cend() const noexcept = 0;
@@ -325,9 +422,19 @@ RA_CPP_LIBRARY_EXPORT struct IStorage
     // resize
     virtual void resize( size_t sz ) = 0;
 
+    // set - assign value at idx
+    // Note: not all storage has addressable values (e.g. bit-packed Bool),
+    // so prefer this to writing through mutable at()
+    virtual void set( size_t idx, const value_t* v ) = 0;
+
     // push_back
     virtual void push_back( const value_t* v ) = 0;
 
+    // append - bulk push_back of `n` contiguous values starting at `first`
+    // Storage grows at most once per call, so prefer this over repeated
+    // push_back when loading data
+    virtual void append( const value_t* first, size_t n ) = 0;
+
     // insert - limit to extend?
 
 
@@ -343,12 +450,208 @@ RA_CPP_LIBRARY_EXPORT struct IStorage
                         ,iterator  to
                         ) = 0;
 
+    // value operations specific to this storage's representation
+    // (e.g. comparing dictionary codes), nullptr if the type's default
+    // operations (untyped_value_ops<T>) apply
+    virtual IValue* ops() const noexcept
+    {
+        return nullptr;
+    }
+
+    // number of null rows, at() returns nullptr for these
+    // (see nullable_storage)
+    virtual size_t null_count() const noexcept
+    {
+        return 0;
+    }
+
+    virtual bool nullable() const noexcept
+    {
+        return false;
+    }
+
+    // zone maps - min/max per block of zone_rows() rows, so range
+    // predicates can skip whole blocks (see candidate_ranges)
+    // zone_rows() is 0 for storage without zone maps
+    virtual size_t zone_rows() const noexcept
+    {
+        return 0;
+    }
+
+    // zone z, if available and up to date
+    virtual std::optional<zone_t> zone( size_t /* z */ ) const noexcept
+    {
+        return std::nullopt;
+    }
+
+    // bring zones up to date after writes through mutable at()
+    virtual void refresh_zones()
+    {
+    }
+
+    // deep copy into rsrc, keeping the representation (e.g. encoding)
+    // where possible, for copy-on-write (see relation::mutable_column)
+    virtual std::shared_ptr<IStorage> clone(
+        std::pmr::memory_resource* rsrc ) const = 0;
+
     virtual ~IStorage() = default;
 };
 
+
+// IStorage whose copy and move write each value through set(), for storage
+// without addressable values (bit-packed, encoded) or whose writes do more
+// than store a value (nullable, strings)
+struct set_based_storage : public IStorage
+{
+    // Note: `to` must be an iterator into this storage
+    void copy(   const const_iterator&  fromb
+                ,const const_iterator&  frome
+                ,iterator               to
+    ) override
+    {
+        size_t i = to.index();
+        for ( auto it = fromb; it != frome; ++it, ++i ) {
+            set( i, it.get() );
+        }
+    }
+
+    void move(   iterator   fromb
+                ,iterator   frome
+                ,iterator   to
+    ) override
+    {
+        // Overlapping ranges, copy backwards if needed
+        // Note: a contiguous fromb is from other storage, so can't overlap
+        const size_t n      = size_t( frome - fromb );
+        const size_t dest   = to.index();
+        if ( fromb.contiguous() || dest <= fromb.index() ) {
+            for ( size_t i = 0; i < n; ++i ) {
+                set( dest + i, ( fromb + i ).cget() );
+            }
+        } else {
+            for ( size_t i = n; i > 0; --i ) {
+                set( dest + i - 1, ( fromb + i - 1 ).cget() );
+            }
+        }
+    }
+};
+
+
+inline const value_t* const_value_iterator::get() const
+{
+    return m_storage ? m_storage->at( m_idx ) : m_ptr;
+}
+
+inline value_t* value_iterator::get() const
+{
+    return m_storage ? m_storage->at( m_idx ) : m_ptr;
+}
+
+inline const value_t* value_iterator::cget() const
+{
+    return m_storage ? std::as_const( *m_storage ).at( m_idx ) : m_ptr;
+}
+
 // We use one monotonic_buffer_resource per column
 // to get good locality without fragmentation
 
+// Column data alignment
+//
+// Column buffers start on a column_alignment (cache line, AVX-512
+// vector) boundary and their allocations are padded to a multiple of it,
+// so vector kernels can use aligned loads and process the last partial
+// vector without a scalar epilogue. Padding values are unspecified.
+constexpr size_t column_alignment = 64;
+
+// bytes allocated for n values of T
+template<typename T>
+constexpr size_t padded_bytes( size_t n ) noexcept
+{
+    return ( n * sizeof( T ) + column_alignment - 1 ) & ~( column_alignment - 1 );
+}
+
+// Allocator for column buffers, allocates from a pmr resource as
+// std::pmr::polymorphic_allocator does, but aligned and padded as above
+template<typename T>
+struct aligned_allocator
+{
+    typedef T value_type;
+
+    static constexpr size_t alignment = std::max( column_alignment, alignof( T ) );
+
+    aligned_allocator() noexcept : m_rsrc( std::pmr::get_default_resource() )
+    {
+    }
+
+    // implicit, as for std::pmr::polymorphic_allocator
+    aligned_allocator( std::pmr::memory_resource* rsrc ) noexcept // NOLINT(google-explicit-constructor)
+        : m_rsrc( rsrc )
+    {
+    }
+
+    template<typename U>
+    aligned_allocator( const aligned_allocator<U>& other ) noexcept // NOLINT(google-explicit-constructor)
+        : m_rsrc( other.resource() )
+    {
+    }
+
+    // so pmr containers of columns pass on their resource
+    template<typename U>
+    aligned_allocator( const std::pmr::polymorphic_allocator<U>& other ) noexcept // NOLINT(google-explicit-constructor)
+        : m_rsrc( other.resource() )
+    {
+    }
+
+    T* allocate( size_t n )
+    {
+        if ( n > std::numeric_limits<size_t>::max() / sizeof( T ) - column_alignment ) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>( m_rsrc->allocate( padded_bytes<T>( n ), alignment ) );
+    }
+
+    void deallocate( T* p, size_t n ) noexcept
+    {
+        m_rsrc->deallocate( p, padded_bytes<T>( n ), alignment );
+    }
+
+    std::pmr::memory_resource* resource() const noexcept
+    {
+        return m_rsrc;
+    }
+
+    // copies use the default resource, as for polymorphic_allocator
+    aligned_allocator select_on_container_copy_construction() const noexcept
+    {
+        return aligned_allocator();
+    }
+
+    template<typename U>
+    friend bool operator==( const aligned_allocator& a, const aligned_allocator<U>& b ) noexcept
+    {
+        return *a.resource() == *b.resource();
+    }
+
+private:
+    std::pmr::memory_resource* m_rsrc;
+};
+
+template<typename T>
+using aligned_vector = std::vector<T, aligned_allocator<T>>;
+
+// reserve room for n more elements, growing geometrically so repeated
+// appends are amortised O(1) per element (an exact reserve reallocates
+// on every call)
+template<typename V>
+constexpr void reserve_more( V& v, size_t n )
+{
+    const size_t sz = v.size() + n;
+    if ( sz > v.capacity() ) {
+        v.reserve( std::max( sz, 2 * v.capacity() ) );
+    }
+}
+
+
 // Make this a base class, so we can specialise, e.g. std::string -> std::pmr::string?
 // Or just have a bunch of helper functions for std::string, etc..
 // and always use std::pmr::string?
@@ -370,7 +673,7 @@ struct column_storage_base
 {
     // types
 
-    typedef std::pmr::vector<T> vec_t;
+    typedef aligned_vector<T> vec_t;
 
     typedef typename vec_t::value_type       value_type;
     typedef typename vec_t::size_type        size_type;
@@ -382,8 +685,24 @@ struct column_storage_base
     //typedef std::shared_ptr<std::pmr::memory_resource> resource_ptr_t;
     typedef std::pmr::memory_resource* resource_ptr_t;
 
+    // zone maps, see zone_min/zone_max
+    static constexpr bool       has_zones   = std::is_arithmetic_v<T>;
+    static constexpr size_type  zone_rows   = 1024;
+
     explicit column_storage_base( resource_ptr_t rsrc )
-        : m_rsrc( rsrc ), m_vec( rsrc ) {
+        : m_rsrc( rsrc ), m_vec( rsrc ), m_zone_min( rsrc ), m_zone_max( rsrc )
+        , m_zone_dirty( rsrc ) {
+        if ( !rsrc ) {
+            throw std::invalid_argument( "Must specify pmr resource" );
+        }
+    }
+
+    // copy into another resource
+    column_storage_base( const column_storage_base& other, resource_ptr_t rsrc )
+        : m_rsrc( rsrc ), m_vec( other.m_vec, rsrc )
+        , m_zone_min( other.m_zone_min, rsrc ), m_zone_max( other.m_zone_max, rsrc )
+        , m_zone_dirty( other.m_zone_dirty, rsrc ), m_zoned( other.m_zoned )
+        , m_all_dirty( other.m_all_dirty ) {
         if ( !rsrc ) {
             throw std::invalid_argument( "Must specify pmr resource" );
         }
@@ -401,6 +720,11 @@ struct column_storage_base
         return this->m_vec.size();
     }
 
+    constexpr size_type capacity() const noexcept
+    {
+        return this->m_vec.capacity();
+    }
+
     constexpr const_iterator cbegin() const noexcept
     {
         return this->m_vec.cbegin();
@@ -426,34 +750,117 @@ struct column_storage_base
         return this->m_vec.data();
     }
 
+    // zone maps
+    //
+    // Min/max of each block of zone_rows rows, kept up to date as the
+    // column is built (push_back, append, resize, set). Writes through
+    // mutable references cannot be tracked value by value, so they mark
+    // zones dirty: that of the row for at() and operator[], all of them
+    // for data() and iterators. Dirty zones are not valid until
+    // refresh_zones(), which recomputes only those.
+
+    constexpr size_type n_zones() const noexcept
+    {
+        return has_zones ? ( size() + zone_rows - 1 ) / zone_rows : 0;
+    }
+
+    constexpr bool zone_valid( size_type z ) const noexcept
+    {
+        return has_zones && z < n_zones()
+            && std::min( ( z + 1 ) * zone_rows, size() ) <= m_zoned
+            && !m_all_dirty && !m_zone_dirty[ z ];
+    }
+
+    constexpr const T& zone_min( size_type z ) const noexcept
+    {
+        return m_zone_min[ z ];
+    }
+
+    constexpr const T& zone_max( size_type z ) const noexcept
+    {
+        return m_zone_max[ z ];
+    }
+
+    void refresh_zones()
+    {
+        if constexpr ( has_zones ) {
+            for ( size_type z = 0; z < m_zone_dirty.size(); ++z ) {
+                if ( m_all_dirty || m_zone_dirty[ z ] ) {
+                    recompute_zone( z );
+                    m_zone_dirty[ z ] = false;
+                }
+            }
+            m_all_dirty = false;
+        }
+        extend_zones();
+    }
+
+    // mark the zones of rows [first, last) dirty, for writers through
+    // raw_data()
+    constexpr void mark_dirty( size_type first, size_type last ) noexcept
+    {
+        if constexpr ( has_zones ) {
+            const size_type end = std::min( last, m_zoned );
+            if ( first >= end ) {
+                return;
+            }
+            for ( size_type z = first / zone_rows; z * zone_rows < end; ++z ) {
+                m_zone_dirty[ z ] = true;
+            }
+        }
+    }
+
     // mutation
 
     constexpr iterator begin() noexcept
     {
+        mark_all_dirty();
         return this->m_vec.begin();
     }
 
     constexpr iterator end() noexcept
     {
+        mark_all_dirty();
         return this->m_vec.end();
     }
 
     constexpr reference at( size_type i )
     {
+        mark_dirty( i, i + 1 );
         return this->m_vec.at( i );
     }
 
     // cppcheck-suppress functionConst
     constexpr reference operator[]( size_type i )
     {
+        mark_dirty( i, i + 1 );
         return this->m_vec[i];
     }
 
     constexpr T* data() noexcept
+    {
+        mark_all_dirty();
+        return this->m_vec.data();
+    }
+
+    // data() without marking zones dirty, the caller marks what it
+    // writes with mark_dirty()
+    constexpr T* raw_data() noexcept
     {
         return this->m_vec.data();
     }
 
+    // assign, widening the zone rather than invalidating it
+    constexpr void set( size_type i, const T& v )
+    {
+        this->m_vec.at( i ) = v;
+        if constexpr ( has_zones ) {
+            if ( i < m_zoned ) {
+                widen_zone( i / zone_rows, v );
+            }
+        }
+    }
+
     constexpr void reserve( size_t sz )
     {
         this->m_vec.reserve( sz );
@@ -461,23 +868,113 @@ struct column_storage_base
 
     constexpr void resize( size_type sz )
     {
-         this->m_vec.resize( sz );
+        if ( sz < size() ) {
+            truncate_zones( sz );
+        }
+        this->m_vec.resize( sz );
+        extend_zones();
     }
 
     constexpr void push_back( const T& v )
     {
         this->m_vec.push_back( v );
+        extend_zones();
     }
 
     constexpr void push_back( const T&& v )
     {
         this->m_vec.push_back( v );
+        extend_zones();
+    }
+
+    // Note: range insert grows geometrically, so repeated appends
+    // are amortised O(1) per value
+    constexpr void append( const T* first, size_type n )
+    {
+        this->m_vec.insert( this->m_vec.end(), first, first + n );
+        extend_zones();
     }
 
 
 protected:
+    constexpr void mark_all_dirty() noexcept
+    {
+        if constexpr ( has_zones ) {
+            m_all_dirty = true;
+        }
+    }
+
+    // drop zones from the block holding row i on, extend_zones() then
+    // recomputes a partial last block
+    constexpr void truncate_zones( size_type i ) noexcept
+    {
+        if constexpr ( has_zones ) {
+            const size_type z = i / zone_rows;
+            if ( z * zone_rows < m_zoned ) {
+                m_zoned = z * zone_rows;
+                m_zone_min.erase( m_zone_min.begin() + long( z ), m_zone_min.end() );
+                m_zone_max.erase( m_zone_max.begin() + long( z ), m_zone_max.end() );
+                m_zone_dirty.resize( z );
+            }
+        }
+    }
+
+    constexpr void recompute_zone( size_type z ) noexcept
+    {
+        const size_type first = z * zone_rows;
+        const size_type last = std::min( first + zone_rows, m_zoned );
+        m_zone_min[ z ] = m_zone_max[ z ] = this->m_vec[ first ];
+        for ( size_type i = first + 1; i < last; ++i ) {
+            widen_zone( z, this->m_vec[ i ] );
+        }
+    }
+
+    // bring zones up to date, from the last valid row
+    constexpr void extend_zones()
+    {
+        if constexpr ( has_zones ) {
+            for ( size_type i = m_zoned; i < size(); ++i ) {
+                const T& v = this->m_vec[ i ];
+                if ( i % zone_rows == 0 ) {
+                    m_zone_min.push_back( v );
+                    m_zone_max.push_back( v );
+                    m_zone_dirty.push_back( false );
+                } else {
+                    widen_zone( i / zone_rows, v );
+                }
+            }
+            m_zoned = size();
+        }
+    }
+
+    // NaN orders first, as in strong_ordering<T>
+    static constexpr bool zone_less( const T& a, const T& b ) noexcept
+    {
+        if constexpr ( std::is_floating_point_v<T> ) {
+            if ( std::isnan( a ) || std::isnan( b ) ) {
+                return std::isnan( a ) && !std::isnan( b );
+            }
+        }
+        return a < b;
+    }
+
+    constexpr void widen_zone( size_type z, const T& v ) noexcept
+    {
+        if ( zone_less( v, m_zone_min[ z ] ) ) {
+            m_zone_min[ z ] = v;
+        }
+        if ( zone_less( m_zone_max[ z ], v ) ) {
+            m_zone_max[ z ] = v;
+        }
+    }
+
     resource_ptr_t  m_rsrc;
     vec_t           m_vec;
+    vec_t           m_zone_min;
+    vec_t           m_zone_max;
+    std::pmr::vector<bool>  m_zone_dirty;
+    size_type       m_zoned = 0;    // rows covered by zones
+    bool            m_all_dirty = false;
 };
 
 
@@ -491,45 +988,1247 @@ struct column_storage : public column_storage_base< T >
     {
     }
 
+    column_storage( const column_storage& other, resource_ptr_t rsrc )
+        : column_storage_base< T >( other, rsrc )
+    {
+    }
+
     virtual ~column_storage() = default;
 };
 
 
-template<typename T>
-struct untyped_column_storage : public IStorage
+// Bit-packed storage for Bool columns
+//
+// One bit per row in 64 bit words. Bits past size() in the last word are
+// always kept clear, so word at a time kernels (count, and_, or_) need no
+// masking.
+template<>
+struct column_storage<bool>
 {
-    typedef std::shared_ptr< column_storage< T > > storage_ptr_t;
-    //typedef column_storage< T >* storage_ptr_t;
+    // types
 
-    explicit untyped_column_storage( storage_ptr_t storage ) :
-        m_storage( storage )
-    {
-    }
+    typedef std::uint64_t               word_t;
+    typedef aligned_vector<word_t>      vec_t;
 
-    virtual ~untyped_column_storage() = default;
+    typedef bool                        value_type;
+    typedef size_t                      size_type;
 
-private:
+    typedef std::pmr::memory_resource* resource_ptr_t;
 
-    // Convenience
-    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
-    static constexpr value_t* v( T* x ) noexcept
-    {
-        return reinterpret_cast<value_t*>(x);
+    static constexpr size_type word_bits = 64;
+
+    explicit column_storage( resource_ptr_t rsrc )
+        : m_rsrc( rsrc ), m_words( rsrc ) {
+        if ( !rsrc ) {
+            throw std::invalid_argument( "Must specify pmr resource" );
+        }
     }
 
-    static constexpr const value_t* cv( const T* x ) noexcept
-    {
+    // copy into another resource
+    column_storage( const column_storage& other, resource_ptr_t rsrc )
+        : m_rsrc( rsrc ), m_words( other.m_words, rsrc ), m_size( other.m_size ) {
+        if ( !rsrc ) {
+            throw std::invalid_argument( "Must specify pmr resource" );
+        }
+    }
+
+    virtual ~column_storage() = default;
+
+    // immutable deconstruction
+
+    constexpr bool empty() const noexcept
+    {
+        return m_size == 0;
+    }
+
+    constexpr size_type size() const noexcept
+    {
+        return m_size;
+    }
+
+    constexpr size_type capacity() const noexcept
+    {
+        return m_words.capacity() * word_bits;
+    }
+
+    constexpr bool at( size_type i ) const
+    {
+        if ( i >= m_size ) {
+            throw std::out_of_range( "column_storage<bool>::at" );
+        }
+        return (*this)[ i ];
+    }
+
+    constexpr bool operator[]( size_type i ) const
+    {
+        return ( m_words[ i / word_bits ] >> ( i % word_bits ) ) & 1U;
+    }
+
+    constexpr const word_t* words() const noexcept
+    {
+        return m_words.data();
+    }
+
+    constexpr size_type n_words() const noexcept
+    {
+        return m_words.size();
+    }
+
+    // mutation
+
+    constexpr void set( size_type i, bool v )
+    {
+        if ( i >= m_size ) {
+            throw std::out_of_range( "column_storage<bool>::set" );
+        }
+        const word_t mask = word_t( 1 ) << ( i % word_bits );
+        if ( v ) {
+            m_words[ i / word_bits ] |= mask;
+        } else {
+            m_words[ i / word_bits ] &= ~mask;
+        }
+    }
+
+    constexpr word_t* words() noexcept
+    {
+        return m_words.data();
+    }
+
+    constexpr void reserve( size_type sz )
+    {
+        m_words.reserve( n_words_for( sz ) );
+    }
+
+    constexpr void resize( size_type sz )
+    {
+        m_words.resize( n_words_for( sz ), 0 );
+        m_size = sz;
+        clear_tail();
+    }
+
+    constexpr void push_back( bool v )
+    {
+        if ( m_size % word_bits == 0 ) {
+            m_words.push_back( 0 );
+        }
+        m_words.back() |= word_t( v ) << ( m_size % word_bits );
+        ++m_size;
+    }
+
+    // pack a whole word at a time once aligned
+    constexpr void append( const bool* first, size_type n )
+    {
+        reserve_more( m_words, n_words_for( m_size + n ) - m_words.size() );
+        size_type i = 0;
+        for ( ; i < n && m_size % word_bits != 0; ++i ) {
+            push_back( first[ i ] );
+        }
+        for ( ; i + word_bits <= n; i += word_bits ) {
+            word_t w = 0;
+            for ( size_type b = 0; b < word_bits; ++b ) {
+                w |= word_t( first[ i + b ] ) << b;
+            }
+            m_words.push_back( w );
+            m_size += word_bits;
+        }
+        for ( ; i < n; ++i ) {
+            push_back( first[ i ] );
+        }
+    }
+
+    // word at a time kernels
+
+    // number of true values
+    constexpr size_type count() const noexcept
+    {
+        size_type c = 0;
+        for ( const auto w : m_words ) {
+            c += size_type( std::popcount( w ) );
+        }
+        return c;
+    }
+
+    // in-place and/or with another column of the same size
+    column_storage& and_( const column_storage& other )
+    {
+        check_size( other );
+        for ( size_type i = 0; i < m_words.size(); ++i ) {
+            m_words[ i ] &= other.m_words[ i ];
+        }
+        return *this;
+    }
+
+    column_storage& or_( const column_storage& other )
+    {
+        check_size( other );
+        for ( size_type i = 0; i < m_words.size(); ++i ) {
+            m_words[ i ] |= other.m_words[ i ];
+        }
+        return *this;
+    }
+
+    // in-place negation
+    constexpr column_storage& not_() noexcept
+    {
+        for ( auto& w : m_words ) {
+            w = ~w;
+        }
+        clear_tail();
+        return *this;
+    }
+
+private:
+    static constexpr size_type n_words_for( size_type sz ) noexcept
+    {
+        return ( sz + word_bits - 1 ) / word_bits;
+    }
+
+    constexpr void clear_tail() noexcept
+    {
+        if ( m_size % word_bits != 0 ) {
+            m_words.back() &= ( word_t( 1 ) << ( m_size % word_bits ) ) - 1;
+        }
+    }
+
+    void check_size( const column_storage& other ) const
+    {
+        if ( other.m_size != m_size ) {
+            throw_with< std::invalid_argument >(
+                std::ostringstream()
+                << "Bool column sizes do not match: "
+                << m_size << " and " << other.m_size
+            );
+        }
+    }
+
+    resource_ptr_t  m_rsrc;
+    vec_t           m_words;
+    size_type       m_size = 0;
+};
+
+
+// String columns
+//
+// Strings are stored as records in a single contiguous character heap,
+// with an array of offsets giving the position of each row's record.
+// A record is the string length (string_record::length_t) followed by
+// the characters, so a pointer to a record is a self-contained value,
+// and it is what the untyped interface hands out (see
+// value_ops<std::string_view>::get) and takes (see string_record_buffer),
+// so a value read from one column may be written to another as is.
+//
+// Records are not aligned, lengths are read with memcpy.
+//
+// Overwriting a row (set()) appends a new record and leaves the old one
+// in the heap until the column is rebuilt.
+struct string_record
+{
+    typedef std::uint32_t length_t;
+
+    // bytes for the record of s, throws std::length_error if s is too
+    // long for a record
+    static constexpr size_t size( std::string_view s )
+    {
+        if ( s.size() > std::numeric_limits<length_t>::max() ) {
+            throw std::length_error( "String too long for string_record" );
+        }
+        return sizeof( length_t ) + s.size();
+    }
+
+    static std::string_view decode( const char* rec ) noexcept
+    {
+        length_t len = 0;
+        std::memcpy( &len, rec, sizeof( length_t ) );
+        return std::string_view( rec + sizeof( length_t ), len );
+    }
+
+    // write record to dest, which must have room for size( s ) bytes
+    // (so s is known to fit)
+    static char* encode( char* dest, std::string_view s ) noexcept
+    {
+        const auto len = static_cast<length_t>( s.size() );
+        std::memcpy( dest, &len, sizeof( length_t ) );
+        // s.data() may be null when empty
+        if ( !s.empty() ) {
+            std::memcpy( dest + sizeof( length_t ), s.data(), s.size() );
+        }
+        return dest + sizeof( length_t ) + s.size();
+    }
+
+    // the record following rec, when records are packed one after another
+    static const char* next( const char* rec ) noexcept
+    {
+        length_t len = 0;
+        std::memcpy( &len, rec, sizeof( length_t ) );
+        return rec + sizeof( length_t ) + len;
+    }
+};
+
+// Strings encoded as records, packed one after another, the form in which
+// IStorage takes String values
+struct string_record_buffer
+{
+    string_record_buffer() = default;
+
+    explicit string_record_buffer( std::string_view s )
+    {
+        assign( &s, 1 );
+    }
+
+    void assign( const std::string_view* first, size_t n )
+    {
+        size_t sz = 0;
+        for ( size_t i = 0; i < n; ++i ) {
+            sz += string_record::size( first[ i ] );
+        }
+        m_buf.resize( sz );
+        char* dest = m_buf.data();
+        for ( size_t i = 0; i < n; ++i ) {
+            dest = string_record::encode( dest, first[ i ] );
+        }
+    }
+
+    const value_t* data() const noexcept
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return reinterpret_cast<const value_t*>( m_buf.data() );
+    }
+
+private:
+    std::vector<char> m_buf;
+};
+
+
+template<typename Offset>
+struct basic_string_column_storage
+{
+    // types
+
+    typedef Offset                      offset_t;
+    typedef aligned_vector<char>        heap_t;
+    typedef aligned_vector<offset_t>    offsets_t;
+
+    typedef std::string_view            value_type;
+    typedef size_t                      size_type;
+
+    typedef std::pmr::memory_resource* resource_ptr_t;
+
+    explicit basic_string_column_storage( resource_ptr_t rsrc )
+        : m_rsrc( rsrc ), m_heap( rsrc ), m_offsets( rsrc ) {
+        if ( !rsrc ) {
+            throw std::invalid_argument( "Must specify pmr resource" );
+        }
+    }
+
+    // immutable deconstruction
+
+    constexpr bool empty() const noexcept
+    {
+        return m_offsets.empty();
+    }
+
+    constexpr size_type size() const noexcept
+    {
+        return m_offsets.size();
+    }
+
+    constexpr size_type capacity() const noexcept
+    {
+        return m_offsets.capacity();
+    }
+
+    std::string_view at( size_type i ) const
+    {
+        return string_record::decode( record_at( m_offsets.at( i ) ) );
+    }
+
+    std::string_view operator[]( size_type i ) const
+    {
+        return string_record::decode( record_at( m_offsets[ i ] ) );
+    }
+
+    // the record for row i
+    constexpr const char* record( size_type i ) const
+    {
+        return m_heap.data() + m_offsets.at( i );
+    }
+
+    constexpr const char* heap() const noexcept
+    {
+        return m_heap.data();
+    }
+
+    constexpr size_type heap_size() const noexcept
+    {
+        return m_heap.size();
+    }
+
+    constexpr const offset_t* offsets() const noexcept
+    {
+        return m_offsets.data();
+    }
+
+    // mutation
+
+    constexpr void reserve( size_type sz )
+    {
+        m_offsets.reserve( sz );
+    }
+
+    // reserve heap space for string data
+    constexpr void reserve_heap( size_type n_chars )
+    {
+        m_heap.reserve( n_chars );
+    }
+
+    // new rows are empty strings, sharing a single record
+    void resize( size_type sz )
+    {
+        if ( sz > m_offsets.size() ) {
+            const offset_t empty = push_record( std::string_view() );
+            m_offsets.resize( sz, empty );
+        } else {
+            m_offsets.resize( sz );
+        }
+    }
+
+    void set( size_type i, std::string_view v )
+    {
+        if ( i >= m_offsets.size() ) {
+            throw std::out_of_range( "basic_string_column_storage::set" );
+        }
+        m_offsets[ i ] = push_record( v );
+    }
+
+    void push_back( std::string_view v )
+    {
+        m_offsets.push_back( push_record( v ) );
+    }
+
+    // heap and offsets grow once for the whole batch
+    // Note: values must not be views into this column's heap
+    void append( const std::string_view* first, size_type n )
+    {
+        size_type n_chars = 0;
+        for ( size_type i = 0; i < n; ++i ) {
+            n_chars += string_record::size( first[ i ] );
+        }
+        const size_type start = m_heap.size();
+        check_offset( start + n_chars );
+        m_heap.resize( start + n_chars );
+        reserve_more( m_offsets, n );
+
+        char* dest = m_heap.data() + start;
+        for ( size_type i = 0; i < n; ++i ) {
+            m_offsets.push_back(
+                static_cast<offset_t>( dest - m_heap.data() ) );
+            dest = string_record::encode( dest, first[ i ] );
+        }
+    }
+
+    // append n records packed one after another (see
+    // string_record_buffer), copied to the heap in one go
+    void append_records( const char* first, size_type n )
+    {
+        const char* last = first;
+        for ( size_type i = 0; i < n; ++i ) {
+            last = string_record::next( last );
+        }
+        const std::less<const char*> lt;
+        if ( !lt( first, m_heap.data() ) && lt( first, m_heap.data() + m_heap.size() ) ) {
+            // records from our own heap, which moves as it grows
+            const std::vector<char> copy( first, last );
+            append_records( copy.data(), n );
+            return;
+        }
+        const size_type start = m_heap.size();
+        check_offset( start + size_type( last - first ) );
+        m_heap.insert( m_heap.end(), first, last );
+        reserve_more( m_offsets, n );
+
+        const char* rec = m_heap.data() + start;
+        for ( size_type i = 0; i < n; ++i ) {
+            m_offsets.push_back(
+                static_cast<offset_t>( rec - m_heap.data() ) );
+            rec = string_record::next( rec );
+        }
+    }
+
+    // replace contents with a copy of another column, a copy of the
+    // heap and offsets
+    template<typename O>
+    void assign( const basic_string_column_storage<O>& other )
+    {
+        check_offset( other.heap_size() );
+        m_heap.assign( other.heap(), other.heap() + other.heap_size() );
+        m_offsets.assign( other.offsets(), other.offsets() + other.size() );
+    }
+
+    // append another column, copying its heap in one go and rebasing
+    // its offsets
+    template<typename O>
+    void append( const basic_string_column_storage<O>& other )
+    {
+        const size_type base = m_heap.size();
+        check_offset( base + other.heap_size() );
+        m_heap.insert( m_heap.end(), other.heap(), other.heap() + other.heap_size() );
+        reserve_more( m_offsets, other.size() );
+        for ( size_type i = 0; i < other.size(); ++i ) {
+            m_offsets.push_back(
+                static_cast<offset_t>( base + other.offsets()[ i ] ) );
+        }
+    }
+
+private:
+    constexpr const char* record_at( offset_t off ) const noexcept
+    {
+        return m_heap.data() + off;
+    }
+
+    static void check_offset( size_type sz )
+    {
+        if ( sz > std::numeric_limits<offset_t>::max() ) {
+            throw std::length_error( "String column heap exceeds offset range" );
+        }
+    }
+
+    // v may be a view into our own heap (e.g. copying rows within the
+    // column), which moves as the heap grows
+    offset_t push_record( std::string_view v )
+    {
+        const size_type start = m_heap.size();
+        check_offset( start + string_record::size( v ) );
+
+        const std::less<const char*> lt;
+        const bool aliased = !lt( v.data(), m_heap.data() )
+            && lt( v.data(), m_heap.data() + m_heap.size() );
+        const auto off = v.data() - m_heap.data();
+
+        m_heap.resize( start + string_record::size( v ) );
+        if ( aliased ) {
+            v = std::string_view( m_heap.data() + off, v.size() );
+        }
+        string_record::encode( m_heap.data() + start, v );
+        return static_cast<offset_t>( start );
+    }
+
+    resource_ptr_t  m_rsrc;
+    heap_t          m_heap;
+    offsets_t       m_offsets;
+};
+
+
+// 64 bit offsets by default, basic_string_column_storage<std::uint32_t>
+// halves the offsets for columns with under 4GB of string data
+template<>
+struct column_storage<std::string_view>
+    : public basic_string_column_storage<std::uint64_t>
+{
+    explicit column_storage( resource_ptr_t rsrc )
+        : basic_string_column_storage<std::uint64_t>( rsrc )
+    {
+    }
+
+    virtual ~column_storage() = default;
+};
+
+
+template<typename T>
+struct untyped_column_storage : public IStorage
+{
+    typedef std::shared_ptr< column_storage< T > > storage_ptr_t;
+    //typedef column_storage< T >* storage_ptr_t;
+
+    explicit untyped_column_storage( storage_ptr_t storage ) :
+        m_storage( storage )
+    {
+    }
+
+    virtual ~untyped_column_storage() = default;
+
+    const column_storage< T >& typed_storage() const noexcept
+    {
+        return *m_storage;
+    }
+
+private:
+
+    // Convenience
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    static constexpr value_t* v( T* x ) noexcept
+    {
+        return reinterpret_cast<value_t*>(x);
+    }
+
+    static constexpr const value_t* cv( const T* x ) noexcept
+    {
         return reinterpret_cast<const value_t*>(x);
     }
 
-    static constexpr T* t( value_t * x ) noexcept
+    static constexpr T* t( value_t * x ) noexcept
+    {
+        return reinterpret_cast<T*>(x);
+    }
+
+    // cppcheck-suppress unusedPrivateFunction
+    static constexpr const T* ct( const value_t  * x ) noexcept
+    {
+        return reinterpret_cast<const T*>(x);
+    }
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+
+public:
+
+    // IStorage interface
+
+    // Note: const access must not go through the mutable accessors of
+    // column_storage, which invalidate its zone maps
+    const value_t* at( size_t idx ) const override
+    {
+        return cv( &( std::as_const( *m_storage ).at( idx ) ) );
+    }
+
+    size_t size() const noexcept override
+    {
+        return m_storage->size();
+    }
+
+    size_t capacity() const noexcept override
+    {
+        return m_storage->capacity();
+    }
+
+    bool empty() const noexcept override
+    {
+        return m_storage->empty();
+    }
+
+    const_iterator cbegin() const noexcept override
+    {
+        return const_value_iterator( cv( std::as_const( *m_storage ).data() ), sizeof( T ) ); // FIXME: sizeof?
+    }
+
+    const_iterator cend() const noexcept override
+    {
+        return const_value_iterator( cv( std::as_const( *m_storage ).data() + m_storage->size() ), sizeof( T ) ); // FIXME: sizeof?
+    }
+
+    value_t* at( size_t idx ) override
+    {
+        return v( &( m_storage->at( idx ) ) );
+    }
+
+
+    iterator begin() noexcept override
+    {
+        // writes through iterators go via copy() and move(), which mark
+        // what they write dirty
+        return value_iterator( v( m_storage->raw_data() ), sizeof( T ) ); // FIXME: sizeof?
+    }
+
+    iterator end() noexcept override
+    {
+        return value_iterator( v( m_storage->raw_data() + m_storage->size() ), sizeof( T ) ); // FIXME: sizeof
+    }
+
+    void reserve( size_t sz ) override
+    {
+        m_storage->reserve( sz );
+    }
+
+    void resize( size_t sz ) override
+    {
+        m_storage->resize( sz );
+    }
+
+    void set( size_t idx, const value_t* v ) override
+    {
+        m_storage->set( idx, *ct( v ) );
+    }
+
+    void push_back( const value_t* v ) override
+    {
+        const T* v_ = ct( v );
+        m_storage->push_back( *v_ );
+    }
+
+    void append( const value_t* first, size_t n ) override
+    {
+        m_storage->append( ct( first ), n );
+    }
+
+    void copy(   const const_iterator&  fromb
+                ,const const_iterator&  frome
+                ,iterator               to
+    ) override
+    {
+        T* to_      = t( to.get() );
+        const size_t dest = size_t( to_ - m_storage->raw_data() );
+        size_t n = 0;
+        if ( !fromb.contiguous() ) {
+            // e.g. from segmented storage
+            for ( auto it = fromb; it != frome; ++it, ++to_, ++n ) {
+                *to_ = *ct( it.get() );
+            }
+        } else {
+            const T* fb = ct( fromb.get() );
+            const T* fe = ct( frome.get() );
+            n = size_t( fe - fb );
+            // see bulk_policy
+            bulk_copy( fb, fe, to_ );
+        }
+        m_storage->mark_dirty( dest, dest + n );
+        m_storage->refresh_zones();
+    }
+
+    void move(   iterator   fromb
+                ,iterator   frome
+                ,iterator   to
+    ) override
+    {
+        T* fb   = t( fromb.get() );
+        T* fe   = t( frome.get() );
+        T* to_  = t( to.get() );
+        const size_t dest = size_t( to_ - m_storage->raw_data() );
+
+        bulk_move( fb, fe, to_ );
+        m_storage->mark_dirty( dest, dest + size_t( fe - fb ) );
+        m_storage->refresh_zones();
+    }
+
+    size_t zone_rows() const noexcept override
+    {
+        return column_storage<T>::has_zones ? column_storage<T>::zone_rows : 0;
+    }
+
+    std::optional<zone_t> zone( size_t z ) const noexcept override
+    {
+        const column_storage<T>& s = *m_storage;
+        if ( !s.zone_valid( z ) ) {
+            return std::nullopt;
+        }
+        return zone_t { cv( &s.zone_min( z ) ), cv( &s.zone_max( z ) ), 0 };
+    }
+
+    void refresh_zones() override
+    {
+        m_storage->refresh_zones();
+    }
+
+    std::shared_ptr<IStorage> clone(
+        std::pmr::memory_resource* rsrc ) const override
+    {
+        return std::make_shared< untyped_column_storage< T > >(
+            std::make_shared< column_storage< T > >( *m_storage, rsrc ) );
+    }
+
+private:
+    storage_ptr_t m_storage;
+};
+
+
+
+// Bit-packed Bool columns have no addressable values, so we hand out
+// pointers to canonical true/false values, and mutable element access
+// is only available via set()
+template<>
+struct untyped_column_storage<bool> : public set_based_storage
+{
+    typedef std::shared_ptr< column_storage< bool > > storage_ptr_t;
+
+    explicit untyped_column_storage( storage_ptr_t storage ) :
+        m_storage( storage )
+    {
+    }
+
+    virtual ~untyped_column_storage() = default;
+
+    const column_storage< bool >& typed_storage() const noexcept
+    {
+        return *m_storage;
+    }
+
+private:
+
+    // Convenience
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    static const value_t* cv( bool x ) noexcept
+    {
+        static constexpr std::array<bool, 2> values { false, true };
+        return reinterpret_cast<const value_t*>( &values[ x ? 1 : 0 ] );
+    }
+
+    static constexpr bool ct( const value_t* x ) noexcept
+    {
+        return *reinterpret_cast<const bool*>( x );
+    }
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+
+public:
+
+    // IStorage interface
+
+    const value_t* at( size_t idx ) const override
+    {
+        return cv( m_storage->at( idx ) );
+    }
+
+    size_t size() const noexcept override
+    {
+        return m_storage->size();
+    }
+
+    size_t capacity() const noexcept override
+    {
+        return m_storage->capacity();
+    }
+
+    bool empty() const noexcept override
+    {
+        return m_storage->empty();
+    }
+
+    const_iterator cbegin() const noexcept override
+    {
+        return const_value_iterator( this, 0 );
+    }
+
+    const_iterator cend() const noexcept override
+    {
+        return const_value_iterator( this, m_storage->size() );
+    }
+
+    value_t* at( size_t /* idx */ ) override
+    {
+        throw std::logic_error(
+            "Bit-packed Bool storage has no mutable element access, use set()" );
+    }
+
+    iterator begin() noexcept override
+    {
+        return value_iterator( this, 0 );
+    }
+
+    iterator end() noexcept override
+    {
+        return value_iterator( this, m_storage->size() );
+    }
+
+    void reserve( size_t sz ) override
+    {
+        m_storage->reserve( sz );
+    }
+
+    void resize( size_t sz ) override
+    {
+        m_storage->resize( sz );
+    }
+
+    void set( size_t idx, const value_t* v ) override
+    {
+        m_storage->set( idx, ct( v ) );
+    }
+
+    void push_back( const value_t* v ) override
+    {
+        m_storage->push_back( ct( v ) );
+    }
+
+    void append( const value_t* first, size_t n ) override
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        m_storage->append( reinterpret_cast<const bool*>( first ), n );
+    }
+
+    std::shared_ptr<IStorage> clone(
+        std::pmr::memory_resource* rsrc ) const override
+    {
+        return std::make_shared< untyped_column_storage< bool > >(
+            std::make_shared< column_storage< bool > >( *m_storage, rsrc ) );
+    }
+
+private:
+    storage_ptr_t m_storage;
+};
+
+
+
+// String columns hand out pointers to records (see string_record), which
+// are not fixed size, so iteration is indexed and mutable element access
+// is only available via set()
+template<typename S>
+struct untyped_string_column_storage : public set_based_storage
+{
+    typedef std::shared_ptr< S > storage_ptr_t;
+
+    explicit untyped_string_column_storage( storage_ptr_t storage ) :
+        m_storage( storage )
+    {
+    }
+
+    virtual ~untyped_string_column_storage() = default;
+
+    const S& typed_storage() const noexcept
+    {
+        return *m_storage;
+    }
+
+private:
+
+    // Convenience
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    static const value_t* cv( const char* x ) noexcept
+    {
+        return reinterpret_cast<const value_t*>( x );
+    }
+
+    static const char* ct( const value_t* x ) noexcept
+    {
+        return reinterpret_cast<const char*>( x );
+    }
+
+    static std::string_view decode( const value_t* x ) noexcept
+    {
+        return string_record::decode( ct( x ) );
+    }
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+
+public:
+
+    // IStorage interface
+
+    const value_t* at( size_t idx ) const override
+    {
+        return cv( m_storage->record( idx ) );
+    }
+
+    size_t size() const noexcept override
+    {
+        return m_storage->size();
+    }
+
+    size_t capacity() const noexcept override
+    {
+        return m_storage->capacity();
+    }
+
+    bool empty() const noexcept override
+    {
+        return m_storage->empty();
+    }
+
+    const_iterator cbegin() const noexcept override
+    {
+        return const_value_iterator( this, 0 );
+    }
+
+    const_iterator cend() const noexcept override
+    {
+        return const_value_iterator( this, m_storage->size() );
+    }
+
+    value_t* at( size_t /* idx */ ) override
+    {
+        throw std::logic_error(
+            "String storage has no mutable element access, use set()" );
+    }
+
+    iterator begin() noexcept override
+    {
+        return value_iterator( this, 0 );
+    }
+
+    iterator end() noexcept override
+    {
+        return value_iterator( this, m_storage->size() );
+    }
+
+    void reserve( size_t sz ) override
+    {
+        m_storage->reserve( sz );
+    }
+
+    void resize( size_t sz ) override
+    {
+        m_storage->resize( sz );
+    }
+
+    // values are records, see string_record_buffer
+    void set( size_t idx, const value_t* v ) override
+    {
+        m_storage->set( idx, decode( v ) );
+    }
+
+    void push_back( const value_t* v ) override
+    {
+        m_storage->push_back( decode( v ) );
+    }
+
+    void append( const value_t* first, size_t n ) override
+    {
+        m_storage->append_records( ct( first ), n );
+    }
+
+    std::shared_ptr<IStorage> clone(
+        std::pmr::memory_resource* rsrc ) const override
+    {
+        auto s = std::make_shared< S >( rsrc );
+        s->assign( *m_storage );
+        return std::make_shared< untyped_string_column_storage< S > >( s );
+    }
+
+private:
+    storage_ptr_t m_storage;
+};
+
+
+template<>
+struct untyped_column_storage<std::string_view>
+    : public untyped_string_column_storage< column_storage< std::string_view > >
+{
+    explicit untyped_column_storage( storage_ptr_t storage )
+        : untyped_string_column_storage< column_storage< std::string_view > >(
+            storage )
+    {
+    }
+
+    virtual ~untyped_column_storage() = default;
+};
+
+
+
+// Segmented columns
+//
+// Rows are stored in fixed size segments (a power of two, 64K rows by
+// default) with a directory of segments, so appends never move existing
+// rows: growth allocates a new segment rather than copying the column,
+// avoiding latency spikes and the transient 2-3x memory of a vector
+// doubling (which a pool resource then holds on to).
+//
+// Row i is at segment i >> shift, offset i & mask. Each segment is
+// contiguous, see for_each_segment for segment at a time scans.
+template<typename T>
+struct segmented_column_storage
+{
+    static_assert( !std::is_same_v<T, bool> && !std::is_same_v<T, std::string_view>,
+        "Segmented storage is for fixed size, addressable values" );
+
+    // types
+
+    typedef aligned_vector<T>               segment_t;
+    typedef std::pmr::vector<segment_t>     directory_t;
+
+    typedef T                               value_type;
+    typedef size_t                          size_type;
+
+    typedef std::pmr::memory_resource* resource_ptr_t;
+
+    static constexpr size_type default_segment_rows = size_type( 1 ) << 16;
+
+    explicit segmented_column_storage(
+         resource_ptr_t rsrc
+        ,size_type      segment_rows = default_segment_rows
+    )
+        : m_rsrc( rsrc ), m_segs( rsrc )
+        , m_shift( unsigned( std::countr_zero( segment_rows ) ) )
+        , m_size( 0 )
+    {
+        if ( !rsrc ) {
+            throw std::invalid_argument( "Must specify pmr resource" );
+        }
+        if ( !std::has_single_bit( segment_rows ) ) {
+            throw_with< std::invalid_argument >(
+                std::ostringstream()
+                << "Segment rows must be a power of two, not "
+                << segment_rows
+            );
+        }
+    }
+
+    // copy into another resource
+    segmented_column_storage( const segmented_column_storage& other, resource_ptr_t rsrc )
+        : m_rsrc( rsrc ), m_segs( other.m_segs, rsrc )
+        , m_shift( other.m_shift ), m_size( other.m_size )
+    {
+        // keep room in the last segment, so appends do not move it
+        if ( !m_segs.empty() ) {
+            m_segs.back().reserve( segment_rows() );
+        }
+    }
+
+    virtual ~segmented_column_storage() = default;
+
+    // immutable deconstruction
+
+    constexpr bool empty() const noexcept
+    {
+        return m_size == 0;
+    }
+
+    constexpr size_type size() const noexcept
+    {
+        return m_size;
+    }
+
+    constexpr size_type capacity() const noexcept
+    {
+        return m_segs.size() * segment_rows();
+    }
+
+    constexpr size_type segment_rows() const noexcept
+    {
+        return size_type( 1 ) << m_shift;
+    }
+
+    constexpr size_type n_segments() const noexcept
+    {
+        return m_segs.size();
+    }
+
+    constexpr const T* segment( size_type s ) const noexcept
+    {
+        return m_segs[ s ].data();
+    }
+
+    constexpr const T& at( size_type i ) const
+    {
+        if ( i >= m_size ) {
+            throw std::out_of_range( "segmented_column_storage::at" );
+        }
+        return ( *this )[ i ];
+    }
+
+    constexpr const T& operator[]( size_type i ) const
+    {
+        return m_segs[ i >> m_shift ][ i & mask() ];
+    }
+
+    // f( const T* values, start row, n ) for each segment
+    template<typename F>
+    constexpr void for_each_segment( F f ) const
+    {
+        for ( size_type s = 0; s < m_segs.size(); ++s ) {
+            f( static_cast<const T*>( m_segs[ s ].data() ), s << m_shift,
+                m_segs[ s ].size() );
+        }
+    }
+
+    // mutable deconstruction
+
+    constexpr T& at( size_type i )
+    {
+        if ( i >= m_size ) {
+            throw std::out_of_range( "segmented_column_storage::at" );
+        }
+        return ( *this )[ i ];
+    }
+
+    constexpr T& operator[]( size_type i )
+    {
+        return m_segs[ i >> m_shift ][ i & mask() ];
+    }
+
+    // mutation
+
+    // Note: only the directory is reserved, segments are allocated on use
+    void reserve( size_type sz )
+    {
+        m_segs.reserve( ( sz + mask() ) >> m_shift );
+    }
+
+    void resize( size_type sz )
+    {
+        while ( m_size < sz ) {
+            segment_t& seg  = back_segment();
+            const size_type k = std::min( sz - m_size, segment_rows() - seg.size() );
+            seg.resize( seg.size() + k );
+            m_size += k;
+        }
+        if ( sz < m_size ) {
+            m_segs.resize( ( sz + mask() ) >> m_shift );
+            if ( !m_segs.empty() ) {
+                m_segs.back().resize( sz - ( ( m_segs.size() - 1 ) << m_shift ) );
+            }
+            m_size = sz;
+        }
+    }
+
+    void push_back( const T& v )
+    {
+        back_segment().push_back( v );
+        ++m_size;
+    }
+
+    void append( const T* first, size_type n )
+    {
+        while ( n > 0 ) {
+            segment_t& seg  = back_segment();
+            const size_type k = std::min( n, segment_rows() - seg.size() );
+            seg.insert( seg.end(), first, first + k );
+            first   += k;
+            n       -= k;
+            m_size  += k;
+        }
+    }
+
+private:
+    constexpr size_type mask() const noexcept
+    {
+        return segment_rows() - 1;
+    }
+
+    // the last segment, adding one if it is full
+    segment_t& back_segment()
+    {
+        if ( m_segs.empty() || m_segs.back().size() == segment_rows() ) {
+            m_segs.emplace_back().reserve( segment_rows() );
+        }
+        return m_segs.back();
+    }
+
+    resource_ptr_t  m_rsrc;
+    directory_t     m_segs;
+    unsigned        m_shift;
+    size_type       m_size;
+};
+
+
+// Segments are not contiguous with each other, so iteration is indexed
+template<typename T>
+struct untyped_segmented_column_storage : public set_based_storage
+{
+    typedef segmented_column_storage<T>     storage_t;
+    typedef std::shared_ptr< storage_t >    storage_ptr_t;
+
+    explicit untyped_segmented_column_storage( storage_ptr_t storage )
+        : m_storage( storage )
+    {
+    }
+
+    virtual ~untyped_segmented_column_storage() = default;
+
+    const storage_t& typed_storage() const noexcept
     {
-        return reinterpret_cast<T*>(x);
+        return *m_storage;
     }
 
-    static constexpr const T* ct( const value_t  * x ) noexcept
+private:
+
+    // Convenience
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    static constexpr const value_t* cv( const T* x ) noexcept
     {
-        return reinterpret_cast<const T*>(x);
+        return reinterpret_cast<const value_t*>( x );
+    }
+
+    static constexpr value_t* v( T* x ) noexcept
+    {
+        return reinterpret_cast<value_t*>( x );
+    }
+
+    static constexpr const T* ct( const value_t* x ) noexcept
+    {
+        return reinterpret_cast<const T*>( x );
     }
     // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
 
@@ -539,7 +2238,7 @@ public:
 
     const value_t* at( size_t idx ) const override
     {
-        return cv( &( m_storage->at( idx ) ) );
+        return cv( &std::as_const( *m_storage ).at( idx ) );
     }
 
     size_t size() const noexcept override
@@ -547,6 +2246,11 @@ public:
         return m_storage->size();
     }
 
+    size_t capacity() const noexcept override
+    {
+        return m_storage->capacity();
+    }
+
     bool empty() const noexcept override
     {
         return m_storage->empty();
@@ -554,28 +2258,27 @@ public:
 
     const_iterator cbegin() const noexcept override
     {
-        return const_value_iterator( cv( m_storage->data() ), sizeof( T ) ); // FIXME: sizeof?
+        return const_value_iterator( this, 0 );
     }
 
     const_iterator cend() const noexcept override
     {
-        return const_value_iterator( cv( m_storage->data() + m_storage->size() ), sizeof( T ) ); // FIXME: sizeof?
+        return const_value_iterator( this, m_storage->size() );
     }
 
     value_t* at( size_t idx ) override
     {
-        return v( &( m_storage->at( idx ) ) );
+        return v( &m_storage->at( idx ) );
     }
 
-
     iterator begin() noexcept override
     {
-        return value_iterator( v( m_storage->data() ), sizeof( T ) ); // FIXME: sizeof?
+        return value_iterator( this, 0 );
     }
 
     iterator end() noexcept override
     {
-        return value_iterator( v( m_storage->data() + m_storage->size() ), sizeof( T ) ); // FIXME: sizeof
+        return value_iterator( this, m_storage->size() );
     }
 
     void reserve( size_t sz ) override
@@ -588,39 +2291,27 @@ public:
         m_storage->resize( sz );
     }
 
-    void push_back( const value_t* v ) override
+    void set( size_t idx, const value_t* v ) override
     {
-        const T* v_ = ct( v );
-        m_storage->push_back( *v_ );
+        m_storage->at( idx ) = *ct( v );
     }
 
-    void copy(   const const_iterator&  fromb
-                ,const const_iterator&  frome
-                ,iterator               to
-    ) override
+    void push_back( const value_t* v ) override
     {
-        const T* fb = ct( fromb.get() );
-        const T* fe = ct( frome.get() );
-        T* to_      = t( to.get() );
-        // abstract out execution policy?
-        // select based on size?
-        // std::copy( std::execution::par_unseq, fb, fe, to_ );
-        std::copy( fb, fe, to_ );
+        m_storage->push_back( *ct( v ) );
     }
 
-    void move(   iterator   fromb
-                ,iterator   frome
-                ,iterator   to
-    ) override
+    void append( const value_t* first, size_t n ) override
     {
-        T* fb   = t( fromb.get() );
-        T* fe   = t( frome.get() );
-        T* to_  = t( to.get() );
+        m_storage->append( ct( first ), n );
+    }
 
-        // std::move( std::execution::par_unseq, fb, fe, to_ );
-        // std::move( std::execution::unseq, fb, fe, to_ );
-        std::move( fb, fe, to_ );
-    } 
+    std::shared_ptr<IStorage> clone(
+        std::pmr::memory_resource* rsrc ) const override
+    {
+        return std::make_shared< untyped_segmented_column_storage< T > >(
+            std::make_shared< storage_t >( *m_storage, rsrc ) );
+    }
 
 private:
     storage_ptr_t m_storage;
@@ -628,6 +2319,229 @@ private:
 
 
 
+// Nullable columns
+//
+// A nullable column is any base storage plus a validity bitmap (one bit
+// per row, set for non-null rows), rather than storage of
+// std::optional<T>, which would double the width of numeric columns. The
+// base values stay dense; null rows hold a default value.
+//
+// at() returns nullptr for null rows, and null aware value operations
+// (see nullable_value_ops) handle nullptr. push_back() and set() take
+// nullptr for null, append() only appends non-null values.
+struct nullable_storage : public set_based_storage
+{
+    typedef std::shared_ptr<IStorage>   storage_ptr_t;
+    typedef column_storage<bool>        validity_t;
+
+    nullable_storage( storage_ptr_t values, std::pmr::memory_resource* rsrc )
+        : m_values( std::move( values ) ), m_valid( rsrc )
+    {
+        if ( !m_values ) {
+            throw std::invalid_argument( "Must specify base storage" );
+        }
+        m_valid.resize( m_values->size() );
+        for ( size_t i = 0; i < m_valid.size(); ++i ) {
+            m_valid.set( i, true );
+        }
+    }
+
+    // copy with validity
+    nullable_storage( storage_ptr_t values, const validity_t& valid
+                    , std::pmr::memory_resource* rsrc )
+        : m_values( std::move( values ) ), m_valid( valid, rsrc )
+    {
+    }
+
+    virtual ~nullable_storage() = default;
+
+    const IStorage& values() const noexcept
+    {
+        return *m_values;
+    }
+
+    const validity_t& validity() const noexcept
+    {
+        return m_valid;
+    }
+
+    bool is_null( size_t idx ) const
+    {
+        return !m_valid.at( idx );
+    }
+
+    // call f( row ) for each non-null row, a validity word at a time, so
+    // runs of nulls or non-nulls cost one test per 64 rows
+    template<typename F>
+    void for_each_valid( F f ) const
+    {
+        const std::uint64_t* words = m_valid.words();
+        for ( size_t w = 0; w < m_valid.n_words(); ++w ) {
+            std::uint64_t bits = words[ w ];
+            const size_t base  = w * validity_t::word_bits;
+            if ( bits == ~std::uint64_t( 0 ) ) {
+                for ( size_t i = 0; i < validity_t::word_bits; ++i ) {
+                    f( base + i );
+                }
+                continue;
+            }
+            while ( bits != 0 ) {
+                f( base + size_t( std::countr_zero( bits ) ) );
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    void push_null()
+    {
+        m_values->resize( m_values->size() + 1 );
+        m_valid.push_back( false );
+    }
+
+    // IStorage interface
+
+    const value_t* at( size_t idx ) const override
+    {
+        return m_valid.at( idx ) ? std::as_const( *m_values ).at( idx ) : nullptr;
+    }
+
+    size_t size() const noexcept override
+    {
+        return m_valid.size();
+    }
+
+    size_t capacity() const noexcept override
+    {
+        return std::min( m_values->capacity(), m_valid.capacity() );
+    }
+
+    bool empty() const noexcept override
+    {
+        return m_valid.empty();
+    }
+
+    const_iterator cbegin() const noexcept override
+    {
+        return const_value_iterator( this, 0 );
+    }
+
+    const_iterator cend() const noexcept override
+    {
+        return const_value_iterator( this, size() );
+    }
+
+    value_t* at( size_t idx ) override
+    {
+        return m_valid.at( idx ) ? m_values->at( idx ) : nullptr;
+    }
+
+    iterator begin() noexcept override
+    {
+        return value_iterator( this, 0 );
+    }
+
+    iterator end() noexcept override
+    {
+        return value_iterator( this, size() );
+    }
+
+    void reserve( size_t sz ) override
+    {
+        m_values->reserve( sz );
+        m_valid.reserve( sz );
+    }
+
+    // new rows are null
+    void resize( size_t sz ) override
+    {
+        m_values->resize( sz );
+        m_valid.resize( sz );
+    }
+
+    void set( size_t idx, const value_t* v ) override
+    {
+        if ( v ) {
+            m_values->set( idx, v );
+        }
+        m_valid.set( idx, v != nullptr );
+    }
+
+    void push_back( const value_t* v ) override
+    {
+        if ( !v ) {
+            push_null();
+            return;
+        }
+        m_values->push_back( v );
+        m_valid.push_back( true );
+    }
+
+    void append( const value_t* first, size_t n ) override
+    {
+        m_values->append( first, n );
+        m_valid.resize( m_valid.size() + n );
+        for ( size_t i = m_valid.size() - n; i < m_valid.size(); ++i ) {
+            m_valid.set( i, true );
+        }
+    }
+
+    size_t null_count() const noexcept override
+    {
+        return m_valid.size() - m_valid.count();
+    }
+
+    bool nullable() const noexcept override
+    {
+        return true;
+    }
+
+    std::shared_ptr<IStorage> clone(
+        std::pmr::memory_resource* rsrc ) const override
+    {
+        return std::make_shared<nullable_storage>(
+            m_values->clone( rsrc ), m_valid, rsrc );
+    }
+
+    // zones of the values, with null counts from the validity bitmap
+    // Note: null rows hold default values, which widen the bounds
+    size_t zone_rows() const noexcept override
+    {
+        const size_t rows = m_values->zone_rows();
+        return rows % validity_t::word_bits == 0 ? rows : 0;
+    }
+
+    std::optional<zone_t> zone( size_t z ) const noexcept override
+    {
+        const size_t rows = zone_rows();
+        if ( rows == 0 ) {
+            return std::nullopt;
+        }
+        auto zn = m_values->zone( z );
+        if ( zn ) {
+            const size_t first  = z * rows / validity_t::word_bits;
+            const size_t last   = std::min(
+                ( z + 1 ) * rows / validity_t::word_bits, m_valid.n_words() );
+            size_t valid = 0;
+            for ( size_t w = first; w < last; ++w ) {
+                valid += size_t( std::popcount( m_valid.words()[ w ] ) );
+            }
+            zn->null_count = std::min( rows, size() - z * rows ) - valid;
+        }
+        return zn;
+    }
+
+    void refresh_zones() override
+    {
+        m_values->refresh_zones();
+    }
+
+private:
+    storage_ptr_t   m_values;
+    validity_t      m_valid;
+};
+
+
+
 template<typename T>
 struct value_ops_base
 {
@@ -641,6 +2555,13 @@ struct value_ops_base
         return us;
     }
 
+    // typed access to a value as returned by IStorage::at()
+    static constexpr const T& get( const value_t* v ) noexcept
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return *reinterpret_cast<const T*>( v );
+    }
+
 };
 
 
@@ -649,7 +2570,7 @@ struct value_ops : public value_ops_base< T >
 {
 };
 
-// FIXME: std::vector<bool> is specialised, so this needs to be too...
+// Note: storage is bit-packed, see column_storage<bool>
 template<>
 struct value_ops<bool> : public value_ops_base<bool>
 {
@@ -685,9 +2606,107 @@ struct value_ops<double> : public value_ops_base<double>
 
 };
 
+// Note: IStorage::at() returns a string_record, and values are passed in
+// to IStorage as string_records, see string_record_buffer
+template<>
+struct value_ops<std::string_view> : public value_ops_base<std::string_view>
+{
+    static constexpr const type_t type() noexcept {
+        return type_t( { String } );
+    }
+
+    static std::string_view get( const value_t* v ) noexcept
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return string_record::decode( reinterpret_cast<const char*>( v ) );
+    }
+
+};
+
+// Nullable columns of T, see nullable_storage
+// Values are passed in to IStorage as for T, or nullptr for null
+template<typename T>
+struct value_ops< std::optional<T> >
+{
+    typedef std::shared_ptr<IStorage> storage_ptr_t;
+
+    static constexpr const type_t type() noexcept {
+        return value_ops<T>::type();
+    }
+
+    static storage_ptr_t make_storage( std::pmr::memory_resource* rsrc )
+    {
+        return std::make_shared<nullable_storage>(
+            value_ops<T>::make_storage( rsrc ), rsrc );
+    }
+
+    static std::optional<T> get( const value_t* v ) noexcept
+    {
+        return v ? std::optional<T>( value_ops<T>::get( v ) ) : std::nullopt;
+    }
+};
+
+template<typename T>
+struct is_optional : std::false_type {};
+
+template<typename T>
+struct is_optional< std::optional<T> > : std::true_type {};
+
+template<typename T>
+inline constexpr bool is_optional_v = is_optional<T>::value;
+
+
+
+
+
+
+// Dispatch on a dynamic type to typed code
+//
+// Calls f with the type_t_traits<T> for the C++ type of ty, e.g.
+//
+//   visit_type( ty, [&]<typename T>( type_t_traits<T> ) { ... } );
+//
+// f must return the same type for all types
+template<typename F>
+decltype(auto) visit_type( const type_t& ty, F&& f )
+{
+    switch ( ty.ty_con ) {
+        case Bool:      return f( type_t_traits<bool>() );
+        case Int:       return f( type_t_traits<int>() );
+        case Float:     return f( type_t_traits<float>() );
+        case Double:    return f( type_t_traits<double>() );
+        case String:    return f( type_t_traits<std::string_view>() );
+        case Void:
+        case Date:
+        case Time:
+        case Object:
+            break;
+    }
+    throw std::invalid_argument(
+        "No storage for type " + std::string( ty_to_string( ty ) ) );
+}
 
 
+// Row ranges [begin, end) of col that may hold values in [lo, hi]
+// (as ordered by ops), from the column's zone maps. Blocks without an up
+// to date zone are included, as is the whole column if it has no zone
+// map. lo and hi are in the storage's representation.
+RA_CPP_LIBRARY_EXPORT std::vector< std::pair<size_t, size_t> > candidate_ranges(
+     const IStorage&    col
+    ,const IValue&      ops
+    ,const value_t*     lo
+    ,const value_t*     hi
+);
+
 
+// Empty segmented storage (see segmented_column_storage) for Int, Float
+// and Double columns, nullptr for types without it
+RA_CPP_LIBRARY_EXPORT std::shared_ptr<IStorage> make_segmented_storage(
+     const type_t&              ty
+    ,std::pmr::memory_resource* rsrc
+    ,size_t                     segment_rows =
+        segmented_column_storage<int>::default_segment_rows
+);
 
 
 // IValue - Dynamically/monotyped value operations
@@ -827,6 +2846,7 @@ private:
         return reinterpret_cast<T*>(x);
     }
 
+    // cppcheck-suppress unusedPrivateFunction
     static constexpr const T* ct( const value_t  * x ) noexcept
     {
         return reinterpret_cast<const T*>(x);
@@ -846,13 +2866,15 @@ public:
     std::strong_ordering cmp( const value_t* a, const value_t* b )
         const noexcept override
     {
-        return strong_ordering<T>::cmp( ct( a ), ct( b ) );
+        const auto& a_ = val_t::get( a );
+        const auto& b_ = val_t::get( b );
+        return strong_ordering<T>::cmp( &a_, &b_ );
     }
 
     //
     std::ostream& to_stream( const value_t* v, std::ostream& os ) const override
     {
-        return os << *ct( v );
+        return os << val_t::get( v );
     }
 
     storage_ptr_t make_storage(
@@ -874,6 +2896,75 @@ public:
     virtual ~untyped_value_ops() = default;
 };
 
+// Null aware operations over another type's operations
+// Nulls compare equal to each other and less than all values, and are
+// written as "null"
+struct nullable_value_ops : public IValue
+{
+    explicit nullable_value_ops( IValue* ops ) noexcept : m_ops( ops )
+    {
+    }
+
+    virtual ~nullable_value_ops() = default;
+
+    IValue* base_ops() const noexcept
+    {
+        return m_ops;
+    }
+
+    // IValue
+
+    constexpr type_t type() const noexcept override
+    {
+        return m_ops->type();
+    }
+
+    std::strong_ordering cmp( const value_t* a, const value_t* b )
+        const noexcept override
+    {
+        if ( !a ) {
+            return b ? std::strong_ordering::less : std::strong_ordering::equal;
+        }
+        if ( !b ) {
+            return std::strong_ordering::greater;
+        }
+        return m_ops->cmp( a, b );
+    }
+
+    std::ostream& to_stream( const value_t* v, std::ostream& os ) const override
+    {
+        return v ? m_ops->to_stream( v, os ) : os << "null";
+    }
+
+    storage_ptr_t make_storage(
+        std::pmr::memory_resource* rsrc
+    ) const override
+    {
+        return std::make_shared<nullable_storage>(
+            m_ops->make_storage( rsrc ), rsrc );
+    }
+
+private:
+    IValue* m_ops;
+};
+
+template<typename T>
+struct untyped_value_ops< std::optional<T> > : public nullable_value_ops
+{
+    untyped_value_ops() noexcept
+        : nullable_value_ops( untyped_value_ops<T>::ops() )
+    {
+    }
+
+    virtual ~untyped_value_ops() = default;
+
+    static IValue* ops() noexcept
+    {
+        static untyped_value_ops< std::optional<T> > ops;
+        return &ops;
+    }
+};
+
 // FIXME:
 struct column_storage_t
 {
@@ -896,9 +2987,7 @@ struct col_helper
     )
     {
         return std::tuple_cat(
-            // FIXME: this is wrong, should be using
-            // value_ops::get<> or similar
-            std::tuple<T>( *(reinterpret_cast<const T*>( cols[ col ]->at( row ) ) ) ),
+            std::tuple<T>( value_ops<T>::get( std::as_const( *cols[ col ] ).at( row ) ) ),
             col_helper<Ts...>::row( cols, col + 1, row )
         );
     }
@@ -914,7 +3003,7 @@ struct col_helper<T>
         ,size_t                                     row
     )
     {
-        return std::tuple<T>( *(reinterpret_cast<const T*>( cols[ col ]->at( row ) ) ) );
+        return std::tuple<T>( value_ops<T>::get( std::as_const( *cols[ col ] ).at( row ) ) );
     }
 };
 
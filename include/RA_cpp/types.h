@@ -3,6 +3,7 @@
 #include <vector>
 //#include <string>
 #include <string_view>
+#include <optional>
 #include <tuple>
 #include <map>
 #include <stdexcept>
@@ -11,6 +12,11 @@
 #include <ostream>
 #include <sstream>
 #include <initializer_list>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <shared_mutex>
 
 #include "base.h"
 
@@ -110,6 +116,12 @@ template<> struct type_t_traits<std::string_view>
     static constexpr type_t ty() { return type_t { ty_con_t::String }; }
 };
 
+// nullable columns have the type of their values
+template<typename T> struct type_t_traits< std::optional<T> >
+{
+    static constexpr type_t ty() { return type_t_traits<T>::ty(); }
+};
+
 
 // FIXME: date, time, object, std:optional, etc..
 
@@ -136,6 +148,44 @@ RA_CPP_LIBRARY_EXPORT std::string col_tys_to_string( const col_tys_t& col_tys );
 typedef std::string_view cstring_t;
 
 
+// Attribute (column name) interning
+//
+// Names are interned to small integer ids, so headers can be compared
+// and combined without string comparisons or copies. Ids are assigned in
+// order of first use and are only meaningful within a process (and
+// interner), they are not stable across runs.
+//
+// rel_ty_t uses global_attributes(). Separate interners (e.g. one per
+// catalog) can be created, but their ids must not be mixed.
+
+typedef std::uint32_t attr_id_t;
+
+RA_CPP_LIBRARY_EXPORT struct attribute_interner
+{
+    attribute_interner() = default;
+    attribute_interner( const attribute_interner& ) = delete;
+    attribute_interner& operator=( const attribute_interner& ) = delete;
+
+    // id of name, adding it if new
+    attr_id_t intern( std::string_view name );
+
+    // id of name, if interned
+    std::optional<attr_id_t> find( std::string_view name ) const;
+
+    // name of an id, valid for the life of the interner
+    std::string_view name( attr_id_t id ) const;
+
+    size_t size() const;
+
+private:
+    mutable std::shared_mutex                       m_mutex;
+    std::deque<std::string>                         m_names;    // stable
+    std::unordered_map<std::string_view, attr_id_t> m_ids;
+};
+
+RA_CPP_LIBRARY_EXPORT attribute_interner& global_attributes();
+
+
 // Relation type
 //
 // A relation type is built up of typed and named columns, but has no
@@ -144,6 +194,14 @@ RA_CPP_LIBRARY_EXPORT struct rel_ty_t
 {
 private:
     void construct();
+    void index();
+
+    // already in canonical order, with interned names
+    rel_ty_t( col_tys_t&& col_tys, std::vector<attr_id_t>&& ids )
+    : m_tys( std::move( col_tys ) ), m_ids( std::move( ids ) )
+    {
+        index();
+    }
 
 public:
 
@@ -154,7 +212,7 @@ public:
     }
 
     explicit inline rel_ty_t( col_tys_t&& col_tys )
-    : m_tys( col_tys )
+    : m_tys( std::move( col_tys ) )
     {
         construct();
     }
@@ -171,35 +229,21 @@ public:
     [[nodiscard]] static
     rel_ty_t union_( const rel_ty_t& a, const rel_ty_t& b );
 
-#ifdef _MSC_VER
-    #pragma warning(push)
-    #pragma warning(disable:4100)
-#else
-    #pragma GCC diagnostic push
-    #pragma GCC diagnostic ignored "-Wunused-parameter"
-#endif
-
-    // project
+    // project, the named columns of a
+    // Note: names are sorted, then merged with the columns
     template <typename Iterator>
     [[nodiscard]] static
     rel_ty_t project( const rel_ty_t& a, Iterator begin, Iterator end )
     {
-        throw not_implemented();
+        return project_names( a, std::vector<std::string_view>( begin, end ) );
     }
 
-    // minus
-
-    [[nodiscard]] static inline
-    rel_ty_t minus( const rel_ty_t& a, const rel_ty_t& b )
-    {
-        throw not_implemented();
-    }
+    [[nodiscard]] static
+    rel_ty_t project_names( const rel_ty_t& a, std::vector<std::string_view> names );
 
-#ifdef _MSC_VER
-    #pragma warning(pop)
-#else
-    #pragma GCC diagnostic pop
-#endif
+    // minus, the columns of a not in b
+    [[nodiscard]] static
+    rel_ty_t minus( const rel_ty_t& a, const rel_ty_t& b );
 
     // intersect
     [[nodiscard]] static
@@ -208,13 +252,41 @@ public:
     // all_but
     // FIXME: "exclude"/"excluding"?
 
+    // position of a column in m_tys
+    std::optional<size_t> index_of( attr_id_t id ) const noexcept;
+    std::optional<size_t> index_of( std::string_view name ) const;
+
+    bool contains( attr_id_t id ) const noexcept
+    {
+        return index_of( id ).has_value();
+    }
+
+    // sorted by name, the canonical column order
     col_tys_t m_tys;
+
+    // interned names of m_tys, in the same order
+    std::vector<attr_id_t> m_ids;
+
+    // ( id, position in m_tys ), sorted by id, for lookups and merges
+    std::vector< std::pair< attr_id_t, size_t > > m_by_id;
+
+    // of the ids and types, so unequal headers usually compare in O(1)
+    // Note: ids are per process, so is the hash
+    size_t m_hash = 0;
 };
 
 
 inline bool operator==(const rel_ty_t& ta, const rel_ty_t& tb)
 {
-    return ta.m_tys == tb.m_tys;
+    if ( ta.m_hash != tb.m_hash || ta.m_ids != tb.m_ids ) {
+        return false;
+    }
+    for ( size_t i = 0; i < ta.m_tys.size(); ++i ) {
+        if ( ta.m_tys[ i ].second != tb.m_tys[ i ].second ) {
+            return false;
+        }
+    }
+    return true;
 }
 
 inline auto operator<=>(const rel_ty_t& ta, const rel_ty_t& tb)
@@ -223,4 +295,14 @@ inline auto operator<=>(const rel_ty_t& ta, const rel_ty_t& tb)
 }
 
 
-}
\ No newline at end of file
+}
+
+// for header keyed caches
+template<>
+struct std::hash<rac::rel_ty_t>
+{
+    size_t operator()( const rac::rel_ty_t& ty ) const noexcept
+    {
+        return ty.m_hash;
+    }
+};
\ No newline at end of file
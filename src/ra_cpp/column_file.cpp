@@ -0,0 +1,494 @@
+#include <RA_cpp/column_file.h>
+
+#include <fstream>
+#include <limits>
+#include <optional>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace rac
+{
+
+RA_CPP_LIBRARY_EXPORT struct mapped_column_storage;
+
+// NOLINTBEGIN(readability-identifier-length)
+// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+
+namespace
+{
+
+constexpr std::uint64_t align_up( std::uint64_t x ) noexcept
+{
+    const std::uint64_t a = column_file_header::alignment;
+    return ( x + a - 1 ) / a * a;
+}
+
+constexpr size_t elem_size( const type_t& ty ) noexcept
+{
+    switch ( ty.ty_con ) {
+        case Int:       return sizeof( int );
+        case Float:     return sizeof( float );
+        case Double:    return sizeof( double );
+        case Void: case Bool: case String: case Date: case Time: case Object:
+            break;
+    }
+    return 0;
+}
+
+constexpr size_t bool_words( size_t n_rows ) noexcept
+{
+    return n_rows / 64 + ( n_rows % 64 != 0 ? 1 : 0 );
+}
+
+// a * b, or nullopt if it overflows
+constexpr std::optional<std::uint64_t> checked_mul( std::uint64_t a, std::uint64_t b ) noexcept
+{
+    if ( b != 0 && a > std::numeric_limits<std::uint64_t>::max() / b ) {
+        return std::nullopt;
+    }
+    return a * b;
+}
+
+IValue* ops_for( const type_t& ty )
+{
+    return visit_type( ty, []<typename T>( type_t_traits<T> ) {
+        return untyped_value_ops<T>::ops();
+    } );
+}
+
+[[noreturn]] void bad_file( const std::string& path, const char* what )
+{
+    throw std::runtime_error(
+        "Bad column file '" + path + "': " + what );
+}
+
+template<typename T>
+void write_pod( std::ofstream& os, const T& x )
+{
+    os.write( reinterpret_cast<const char*>( &x ), sizeof( T ) );
+}
+
+void pad_to( std::ofstream& os, std::uint64_t offset )
+{
+    static constexpr std::array<char, column_file_header::alignment> zeros {};
+    const auto pos = std::uint64_t( os.tellp() );
+    os.write( zeros.data(), std::streamsize( offset - pos ) );
+}
+
+}
+
+//
+// mapped_column_storage
+//
+
+mapped_column_storage::mapped_column_storage(
+     mapping_ptr_t              mapping
+    ,const type_t&              ty
+    ,size_t                     n_rows
+    ,const char*                data
+    ,const char*                heap
+    ,size_t                     heap_size
+)
+    : m_mapping( std::move( mapping ) ), m_ty( ty ), m_size( n_rows )
+    , m_elem_size( elem_size( ty ) ), m_data( data )
+    , m_heap( heap ), m_heap_size( heap_size )
+{
+    if ( m_elem_size == 0 && ty.ty_con != Bool && ty.ty_con != String ) {
+        throw_with< std::invalid_argument >(
+            std::ostringstream()
+            << "No mapped storage for type " << ty_to_string( ty )
+        );
+    }
+}
+
+const value_t* mapped_column_storage::at( size_t idx ) const
+{
+    if ( idx >= m_size ) {
+        throw std::out_of_range( "mapped_column_storage::at" );
+    }
+    if ( m_elem_size != 0 ) {
+        return reinterpret_cast<const value_t*>( m_data + idx * m_elem_size );
+    }
+    if ( m_ty.ty_con == Bool ) {
+        static constexpr std::array<bool, 2> values { false, true };
+        std::uint64_t word = 0;
+        std::memcpy( &word, m_data + ( idx / 64 ) * sizeof( word ), sizeof( word ) );
+        return reinterpret_cast<const value_t*>(
+            &values[ ( word >> ( idx % 64 ) ) & 1U ] );
+    }
+    // the whole record must be in the heap
+    std::uint64_t off = 0;
+    std::memcpy( &off, m_data + idx * sizeof( off ), sizeof( off ) );
+    string_record::length_t len = 0;
+    if ( off > m_heap_size || m_heap_size - off < sizeof( len ) ) {
+        throw std::out_of_range( "mapped_column_storage: bad string offset" );
+    }
+    std::memcpy( &len, m_heap + off, sizeof( len ) );
+    if ( len > m_heap_size - off - sizeof( len ) ) {
+        throw std::out_of_range( "mapped_column_storage: bad string length" );
+    }
+    return reinterpret_cast<const value_t*>( m_heap + off );
+}
+
+size_t mapped_column_storage::size() const noexcept
+{
+    return m_size;
+}
+
+size_t mapped_column_storage::capacity() const noexcept
+{
+    return m_size;
+}
+
+bool mapped_column_storage::empty() const noexcept
+{
+    return m_size == 0;
+}
+
+IStorage::const_iterator mapped_column_storage::cbegin() const noexcept
+{
+    if ( m_elem_size != 0 ) {
+        return const_value_iterator(
+            reinterpret_cast<const value_t*>( m_data ), m_elem_size );
+    }
+    return const_value_iterator( this, 0 );
+}
+
+IStorage::const_iterator mapped_column_storage::cend() const noexcept
+{
+    if ( m_elem_size != 0 ) {
+        return const_value_iterator(
+            reinterpret_cast<const value_t*>( m_data + m_size * m_elem_size ),
+            m_elem_size );
+    }
+    return const_value_iterator( this, m_size );
+}
+
+value_t* mapped_column_storage::at( size_t /* idx */ )
+{
+    throw std::logic_error( "Mapped columns are read-only" );
+}
+
+IStorage::iterator mapped_column_storage::begin() noexcept
+{
+    return value_iterator( this, 0 );
+}
+
+IStorage::iterator mapped_column_storage::end() noexcept
+{
+    return value_iterator( this, m_size );
+}
+
+void mapped_column_storage::reserve( size_t /* sz */ )
+{
+    throw std::logic_error( "Mapped columns are read-only" );
+}
+
+void mapped_column_storage::resize( size_t /* sz */ )
+{
+    throw std::logic_error( "Mapped columns are read-only" );
+}
+
+void mapped_column_storage::set( size_t /* idx */, const value_t* /* v */ )
+{
+    throw std::logic_error( "Mapped columns are read-only" );
+}
+
+void mapped_column_storage::push_back( const value_t* /* v */ )
+{
+    throw std::logic_error( "Mapped columns are read-only" );
+}
+
+void mapped_column_storage::append( const value_t* /* first */, size_t /* n */ )
+{
+    throw std::logic_error( "Mapped columns are read-only" );
+}
+
+void mapped_column_storage::copy(    const const_iterator&  /* fromb */
+                                    ,const const_iterator&  /* frome */
+                                    ,iterator               /* to */
+)
+{
+    throw std::logic_error( "Mapped columns are read-only" );
+}
+
+void mapped_column_storage::move(    iterator   /* fromb */
+                                    ,iterator   /* frome */
+                                    ,iterator   /* to */
+)
+{
+    throw std::logic_error( "Mapped columns are read-only" );
+}
+
+std::shared_ptr<IStorage> mapped_column_storage::clone(
+    std::pmr::memory_resource* rsrc ) const
+{
+    return visit_type( m_ty, [&]<typename T>( type_t_traits<T> ) {
+        auto s = value_ops<T>::make_storage( rsrc );
+        s->reserve( m_size );
+        for ( size_t i = 0; i < m_size; ++i ) {
+            s->push_back( at( i ) );
+        }
+        return s;
+    } );
+}
+
+//
+// Writing
+//
+
+void write_column_file(
+     const relation&    rel
+    ,const std::string& path
+)
+{
+    const col_tys_t& tys    = rel.type();
+    const size_t n_cols     = tys.size();
+    const size_t n_rows     = rel.size();
+
+    // layout
+    std::vector<column_file_entry> entries( n_cols );
+    std::uint64_t offset = sizeof( column_file_header )
+        + n_cols * sizeof( column_file_entry );
+    for ( size_t c = 0; c < n_cols; ++c ) {
+        entries[ c ].ty_con         = std::uint32_t( tys[ c ].second.ty_con );
+        entries[ c ].name_size      = std::uint32_t( tys[ c ].first.size() );
+        entries[ c ].name_offset    = offset;
+        offset += tys[ c ].first.size();
+    }
+    std::vector<std::uint32_t> keys { std::uint32_t( rel.m_keys.size() ) };
+    for ( const auto& key : rel.m_keys ) {
+        keys.push_back( std::uint32_t( key.size() ) );
+        for ( const auto& col_ty : key ) {
+            keys.push_back( std::uint32_t( rel.col_index( col_ty.first ) ) );
+        }
+    }
+    const std::uint64_t keys_offset = offset;
+    offset += keys.size() * sizeof( std::uint32_t );
+    for ( size_t c = 0; c < n_cols; ++c ) {
+        const type_t& ty = tys[ c ].second;
+        column_file_entry& e = entries[ c ];
+        if ( rel.m_cols[ c ]->nullable() ) {
+            throw_with< std::invalid_argument >(
+                std::ostringstream()
+                << "Cannot write nullable column '" << tys[ c ].first << "'"
+            );
+        }
+        if ( ty.ty_con == Bool ) {
+            e.data_size = bool_words( n_rows ) * sizeof( std::uint64_t );
+        } else if ( ty.ty_con == String ) {
+            e.data_size = n_rows * sizeof( std::uint64_t );
+            for ( size_t r = 0; r < n_rows; ++r ) {
+                e.heap_size += string_record::size(
+                    value_ops<std::string_view>::get( rel.at( r, c ) ) );
+            }
+        } else if ( elem_size( ty ) != 0 ) {
+            e.data_size = n_rows * elem_size( ty );
+        } else {
+            throw_with< std::invalid_argument >(
+                std::ostringstream()
+                << "Cannot write column '" << tys[ c ].first
+                << "' of type " << ty_to_string( ty )
+            );
+        }
+        e.data_offset = offset = align_up( offset );
+        offset += e.data_size;
+        if ( ty.ty_con == String ) {
+            e.heap_offset = offset = align_up( offset );
+            offset += e.heap_size;
+        }
+    }
+
+    std::ofstream os( path, std::ios::binary | std::ios::trunc );
+    if ( !os ) {
+        throw_with< std::runtime_error >(
+            std::ostringstream() << "Cannot open '" << path << "' for writing" );
+    }
+
+    column_file_header hdr {};
+    hdr.magic   = column_file_header::file_magic;
+    hdr.version = column_file_header::file_version;
+    hdr.endian  = column_file_header::byte_order;
+    hdr.n_rows  = n_rows;
+    hdr.n_cols  = n_cols;
+    hdr.keys_offset = keys_offset;
+    hdr.keys_size   = keys.size() * sizeof( std::uint32_t );
+    write_pod( os, hdr );
+    for ( const auto& e : entries ) {
+        write_pod( os, e );
+    }
+    for ( const auto& [ name, ty ] : tys ) {
+        os.write( name.data(), std::streamsize( name.size() ) );
+    }
+    os.write( reinterpret_cast<const char*>( keys.data() ), std::streamsize( hdr.keys_size ) );
+
+    // sections
+    std::vector<char> buf;
+    for ( size_t c = 0; c < n_cols; ++c ) {
+        const type_t& ty = tys[ c ].second;
+        const column_file_entry& e = entries[ c ];
+        pad_to( os, e.data_offset );
+        if ( ty.ty_con == Bool ) {
+            std::vector<std::uint64_t> words( bool_words( n_rows ) );
+            for ( size_t r = 0; r < n_rows; ++r ) {
+                if ( value_ops<bool>::get( rel.at( r, c ) ) ) {
+                    words[ r / 64 ] |= std::uint64_t( 1 ) << ( r % 64 );
+                }
+            }
+            os.write( reinterpret_cast<const char*>( words.data() ),
+                std::streamsize( e.data_size ) );
+        } else if ( ty.ty_con == String ) {
+            std::vector<std::uint64_t> offsets( n_rows );
+            buf.resize( e.heap_size );
+            char* dest = buf.data();
+            for ( size_t r = 0; r < n_rows; ++r ) {
+                offsets[ r ] = std::uint64_t( dest - buf.data() );
+                dest = string_record::encode( dest,
+                    value_ops<std::string_view>::get( rel.at( r, c ) ) );
+            }
+            os.write( reinterpret_cast<const char*>( offsets.data() ),
+                std::streamsize( e.data_size ) );
+            pad_to( os, e.heap_offset );
+            os.write( buf.data(), std::streamsize( e.heap_size ) );
+        } else {
+            const size_t sz = elem_size( ty );
+            buf.resize( e.data_size );
+            for ( size_t r = 0; r < n_rows; ++r ) {
+                std::memcpy( buf.data() + r * sz, rel.at( r, c ), sz );
+            }
+            os.write( buf.data(), std::streamsize( e.data_size ) );
+        }
+    }
+
+    if ( !os.flush() ) {
+        throw_with< std::runtime_error >(
+            std::ostringstream() << "Error writing '" << path << "'" );
+    }
+}
+
+//
+// Reading
+//
+
+std::shared_ptr<relation> open_column_file( const std::string& path )
+{
+#if defined(_WIN32)
+    (void) path;
+    throw not_implemented();
+#else
+    const int fd = ::open( path.c_str(), O_RDONLY | O_CLOEXEC );
+    if ( fd < 0 ) {
+        throw_with< std::runtime_error >(
+            std::ostringstream() << "Cannot open '" << path << "'" );
+    }
+    struct stat st {};
+    if ( ::fstat( fd, &st ) != 0 ) {
+        ::close( fd );
+        bad_file( path, "cannot stat" );
+    }
+    const auto file_size = size_t( st.st_size );
+    if ( file_size < sizeof( column_file_header ) ) {
+        ::close( fd );
+        bad_file( path, "too short" );
+    }
+    void* addr = ::mmap( nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if ( addr == MAP_FAILED ) {
+        bad_file( path, "cannot map" );
+    }
+    const mapped_column_storage::mapping_ptr_t mapping(
+        addr, [ file_size ]( const void* p ) {
+            ::munmap( const_cast<void*>( p ), file_size );
+        } );
+    const char* base = static_cast<const char*>( addr );
+
+    column_file_header hdr {};
+    std::memcpy( &hdr, base, sizeof( hdr ) );
+    if ( hdr.magic != column_file_header::file_magic ) {
+        bad_file( path, "not a column file" );
+    }
+    if ( hdr.version != column_file_header::file_version ) {
+        bad_file( path, "unsupported version" );
+    }
+    if ( hdr.endian != column_file_header::byte_order ) {
+        bad_file( path, "byte order does not match" );
+    }
+    if ( hdr.n_cols > ( file_size - sizeof( hdr ) ) / sizeof( column_file_entry ) ) {
+        bad_file( path, "truncated column directory" );
+    }
+
+    auto in_file = [ file_size ]( std::uint64_t off, std::uint64_t sz ) {
+        return off <= file_size && sz <= file_size - off;
+    };
+
+    relation_builder_resources res;
+    const size_t n_rows = hdr.n_rows;
+    for ( size_t c = 0; c < hdr.n_cols; ++c ) {
+        column_file_entry e {};
+        std::memcpy( &e,
+            base + sizeof( hdr ) + c * sizeof( column_file_entry ), sizeof( e ) );
+        if ( e.ty_con > Object ) {
+            bad_file( path, "unrecognised column type" );
+        }
+        const type_t ty { ty_con_t( e.ty_con ) };
+        if ( !in_file( e.name_offset, e.name_size )
+            || !in_file( e.data_offset, e.data_size )
+            || !in_file( e.heap_offset, e.heap_size ) ) {
+            bad_file( path, "section out of range" );
+        }
+        const std::optional<std::uint64_t> expected =
+              ty.ty_con == Bool     ? checked_mul( bool_words( n_rows ), sizeof( std::uint64_t ) )
+            : ty.ty_con == String   ? checked_mul( n_rows, sizeof( std::uint64_t ) )
+            : checked_mul( n_rows, elem_size( ty ) );
+        if ( !expected || e.data_size != *expected || ( *expected == 0 && n_rows != 0 ) ) {
+            bad_file( path, "column size does not match row count" );
+        }
+
+        res.m_col_tys.emplace_back(
+            std::string( base + e.name_offset, e.name_size ), ty );
+        res.m_ops.push_back( ops_for( ty ) );
+        res.m_resources.emplace_back( nullptr );
+        res.m_cols.push_back( std::make_shared<mapped_column_storage>(
+            mapping, ty, n_rows, base + e.data_offset,
+            base + e.heap_offset, e.heap_size ) );
+    }
+    auto rel = std::make_shared<relation>( std::move( res ) );
+
+    // keys
+    if ( !in_file( hdr.keys_offset, hdr.keys_size )
+            || hdr.keys_size % sizeof( std::uint32_t ) != 0 ) {
+        bad_file( path, "keys out of range" );
+    }
+    std::vector<std::uint32_t> keys( hdr.keys_size / sizeof( std::uint32_t ) );
+    std::memcpy( keys.data(), base + hdr.keys_offset, hdr.keys_size );
+    size_t k = 0;
+    const auto next = [&]() {
+        if ( k == keys.size() ) {
+            bad_file( path, "truncated keys" );
+        }
+        return keys[ k++ ];
+    };
+    for ( std::uint32_t n_keys = next(); n_keys > 0; --n_keys ) {
+        col_tys_t key;
+        for ( std::uint32_t n = next(); n > 0; --n ) {
+            const std::uint32_t c = next();
+            if ( c >= hdr.n_cols ) {
+                bad_file( path, "key column out of range" );
+            }
+            key.push_back( rel->m_ty.m_tys[ c ] );
+        }
+        rel->m_keys.push_back( std::move( key ) );
+    }
+    return rel;
+#endif
+}
+
+// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+// NOLINTEND(readability-identifier-length)
+
+} // namespace rac
@@ -0,0 +1,192 @@
+#include <RA_cpp/encoding.h>
+
+namespace rac
+{
+
+// NOLINTBEGIN(readability-identifier-length)
+
+namespace
+{
+
+template<typename Code>
+IValue::storage_ptr_t make_dictionary_storage(
+     const std::vector<std::string_view>&   vs
+    ,std::pmr::memory_resource*             rsrc
+)
+{
+    auto s = std::make_shared< dictionary_column_storage< Code > >( rsrc );
+    s->append( vs.data(), vs.size() );
+    return std::make_shared< untyped_dictionary_column_storage< Code > >( s );
+}
+
+template<typename T>
+IValue::storage_ptr_t make_rle_storage(
+     const IStorage&            col
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    auto s = std::make_shared< rle_column_storage< T > >( rsrc );
+    const size_t n = col.size();
+    for ( size_t i = 0; i < n; ++i ) {
+        s->push_back( value_ops<T>::get( col.at( i ) ) );
+    }
+    return std::make_shared< untyped_rle_column_storage< T > >( s );
+}
+
+template<typename T>
+IValue::storage_ptr_t make_packed_storage(
+     const IStorage&            col
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    auto s = std::make_shared< packed_column_storage< T > >( rsrc );
+    const size_t n = col.size();
+    s->reserve( n );
+    for ( size_t i = 0; i < n; ++i ) {
+        s->push_back( value_ops<T>::get( col.at( i ) ) );
+    }
+    return std::make_shared< untyped_packed_column_storage< T > >( s );
+}
+
+template<typename T>
+size_t count_runs( const IStorage& col )
+{
+    const size_t n = col.size();
+    size_t runs = n == 0 ? 0 : 1;
+    for ( size_t i = 1; i < n; ++i ) {
+        if ( !( value_ops<T>::get( col.at( i ) )
+                == value_ops<T>::get( col.at( i - 1 ) ) ) ) {
+            ++runs;
+        }
+    }
+    return runs;
+}
+
+}
+
+IValue::storage_ptr_t dictionary_encode(
+     const IStorage&            col
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    const size_t n = col.size();
+    std::vector<std::string_view> vs;
+    vs.reserve( n );
+    for ( size_t i = 0; i < n; ++i ) {
+        vs.push_back( value_ops<std::string_view>::get( col.at( i ) ) );
+    }
+
+    const std::unordered_set<std::string_view> distinct( vs.cbegin(), vs.cend() );
+    const size_t n_distinct = distinct.size();
+
+    if ( n_distinct <= dictionary_column_storage<std::uint8_t>::max_size ) {
+        return make_dictionary_storage<std::uint8_t>( vs, rsrc );
+    }
+    if ( n_distinct <= dictionary_column_storage<std::uint16_t>::max_size ) {
+        return make_dictionary_storage<std::uint16_t>( vs, rsrc );
+    }
+    return make_dictionary_storage<std::uint32_t>( vs, rsrc );
+}
+
+IValue::storage_ptr_t rle_encode(
+     const IStorage&            col
+    ,const type_t&              ty
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    switch ( ty.ty_con ) {
+        case Int:       return make_rle_storage<int>( col, rsrc );
+        case Float:     return make_rle_storage<float>( col, rsrc );
+        case Double:    return make_rle_storage<double>( col, rsrc );
+        case Void: case Bool: case String: case Date: case Time: case Object:
+            break;
+    }
+    throw_with< std::invalid_argument >(
+        std::ostringstream()
+        << "RLE encoding requires Int, Float or Double, not "
+        << ty_to_string( ty )
+    );
+}
+
+IValue::storage_ptr_t packed_encode(
+     const IStorage&            col
+    ,const type_t&              ty
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    if ( ty.ty_con != Int ) {
+        throw_with< std::invalid_argument >(
+            std::ostringstream()
+            << "Packed encoding requires Int, not "
+            << ty_to_string( ty )
+        );
+    }
+    return make_packed_storage<int>( col, rsrc );
+}
+
+encoding_t choose_encoding(
+     const IStorage&            col
+    ,const type_t&              ty
+)
+{
+    const size_t n = col.size();
+    if ( n == 0 || col.nullable() ) {
+        return Plain;
+    }
+    switch ( ty.ty_con ) {
+        case Int: case Float: case Double: {
+            const size_t runs = visit_type( ty,
+                [&]<typename T>( type_t_traits<T> ) {
+                    return count_runs<T>( col );
+                } );
+            return n >= runs * rle_min_run_length ? Rle : Plain;
+        }
+        case String: {
+            std::unordered_set<std::string_view> distinct;
+            for ( size_t i = 0; i < n; ++i ) {
+                distinct.insert( value_ops<std::string_view>::get( col.at( i ) ) );
+            }
+            return n >= distinct.size() * dictionary_min_repeats
+                ? Dictionary : Plain;
+        }
+        case Void: case Bool: case Date: case Time: case Object:
+            break;
+    }
+    return Plain;
+}
+
+IValue::storage_ptr_t encode_storage(
+     const IStorage&            col
+    ,const type_t&              ty
+    ,encoding_t                 enc
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    if ( col.nullable() && enc != Plain && enc != Auto ) {
+        throw std::invalid_argument( "Cannot encode a nullable column" );
+    }
+    switch ( enc ) {
+        case Plain:
+            return nullptr;
+        case Dictionary:
+            if ( ty.ty_con != String ) {
+                throw_with< std::invalid_argument >(
+                    std::ostringstream()
+                    << "Dictionary encoding requires String, not "
+                    << ty_to_string( ty )
+                );
+            }
+            return dictionary_encode( col, rsrc );
+        case Rle:
+            return rle_encode( col, ty, rsrc );
+        case Packed:
+            return packed_encode( col, ty, rsrc );
+        case Auto:
+            return encode_storage( col, ty, choose_encoding( col, ty ), rsrc );
+    }
+    throw std::invalid_argument( "Unrecognised encoding" );
+}
+
+// NOLINTEND(readability-identifier-length)
+
+} // namespace rac
@@ -0,0 +1,32 @@
+#include <RA_cpp/memory.h>
+
+#include <iomanip>
+
+namespace rac
+{
+
+std::ostream& operator<<( std::ostream& os, const memory_usage_t& usage )
+{
+    const auto row = [&]( std::string_view name, const memory_stats& requested
+                        , const memory_stats& reserved ) {
+        os << std::left << std::setw( 20 ) << name << std::right
+           << std::setw( 14 ) << requested.bytes_live
+           << std::setw( 14 ) << requested.peak_bytes
+           << std::setw( 14 ) << reserved.bytes_live
+           << std::setw( 10 ) << requested.allocations
+           << "\n";
+    };
+    os << std::left << std::setw( 20 ) << "column" << std::right
+       << std::setw( 14 ) << "live"
+       << std::setw( 14 ) << "peak"
+       << std::setw( 14 ) << "reserved"
+       << std::setw( 10 ) << "allocs"
+       << "\n";
+    for ( const auto& c : usage.columns ) {
+        row( c.name, c.requested, c.reserved );
+    }
+    row( "total", usage.requested(), usage.reserved() );
+    return os;
+}
+
+} // namespace rac
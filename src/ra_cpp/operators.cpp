@@ -0,0 +1,2068 @@
+#include <RA_cpp/operators.h>
+#include <RA_cpp/encoding.h>
+#include <RA_cpp/statistics.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace rac
+{
+
+// NOLINTBEGIN(readability-identifier-length)
+
+namespace
+{
+
+// values of a non-null column of fixed size values stored contiguously,
+// or nullptr
+template<typename T>
+const T* contiguous_data( const IStorage& col )
+{
+    if constexpr ( std::is_arithmetic_v<T> && !std::is_same_v<T, bool> ) {
+        const auto it = col.cbegin();
+        if ( !col.empty() && !col.nullable() && it.contiguous()
+                && it.elem_size() == sizeof( T ) ) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            return reinterpret_cast<const T*>( it.get() );
+        }
+    }
+    return nullptr;
+}
+
+// Values of a non-null column a block of rows at a time, in place for
+// plain columns and blocks within a segment, copied or decoded into a
+// buffer for blocks spanning segments and bit-packed columns, so loops
+// over them run over arrays rather than through IStorage::at()
+template<typename T>
+struct block_reader
+{
+    explicit block_reader( const IStorage& col )
+        : m_data( contiguous_data<T>( col ) )
+    {
+        if constexpr ( std::is_arithmetic_v<T> && !std::is_same_v<T, bool> ) {
+            if ( const auto* p = dynamic_cast< const untyped_segmented_column_storage<T>* >( &col ) ) {
+                m_segmented = &p->typed_storage();
+            }
+        }
+        if constexpr ( std::is_same_v<T, int> ) {
+            if ( const auto* p = dynamic_cast< const untyped_packed_column_storage<T>* >( &col ) ) {
+                m_packed = &p->typed_storage();
+            }
+        }
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return m_data || m_segmented || m_packed;
+    }
+
+    // values of rows [first, first + n), buf has room for n
+    const T* read( size_t first, size_t n, T* buf ) const
+    {
+        if ( m_data ) {
+            return m_data + first;
+        }
+        if constexpr ( std::is_arithmetic_v<T> && !std::is_same_v<T, bool> ) {
+            if ( m_segmented ) {
+                const size_t rows = m_segmented->segment_rows();
+                if ( first % rows + n <= rows ) {
+                    return m_segmented->segment( first / rows ) + first % rows;
+                }
+                for ( size_t i = 0; i < n; ++i ) {
+                    buf[ i ] = ( *m_segmented )[ first + i ];
+                }
+                return buf;
+            }
+        }
+        if constexpr ( std::is_same_v<T, int> ) {
+            m_packed->decode_range( first, n, buf );
+        }
+        return buf;
+    }
+
+private:
+    const T*                                m_data;
+    const segmented_column_storage<T>*      m_segmented = nullptr;
+    const packed_column_storage<int>*       m_packed = nullptr;
+};
+
+// the base values of a nullable column, else the column
+const IStorage& dense_values( const IStorage& col )
+{
+    const auto* p = dynamic_cast<const nullable_storage*>( &col );
+    return p ? p->values() : col;
+}
+
+// the validity bitmap of a nullable column, else nullptr
+const column_storage<bool>* validity_of( const IStorage& col )
+{
+    const auto* p = dynamic_cast<const nullable_storage*>( &col );
+    return p ? &p->validity() : nullptr;
+}
+
+// a word with the low n bits set, n <= 64
+constexpr std::uint64_t low_bits( size_t n ) noexcept
+{
+    return n >= 64 ? ~std::uint64_t( 0 ) : ( std::uint64_t( 1 ) << n ) - 1;
+}
+
+// validity of rows [row, row + n) as the low bits of a word, where the
+// rows are within one validity word
+std::uint64_t validity_bits( const column_storage<bool>& valid, size_t row, size_t n )
+{
+    constexpr size_t bits = column_storage<bool>::word_bits;
+    return ( valid.words()[ row / bits ] >> ( row % bits ) ) & low_bits( n );
+}
+
+template<typename T>
+bool typed_value_eq( const value_t* a, const value_t* b )
+{
+    if ( !a || !b ) {
+        return a == b;
+    }
+    const auto x = value_ops<T>::get( a );
+    const auto y = value_ops<T>::get( b );
+    return strong_ordering<T>::cmp( &x, &y ) == std::strong_ordering::equal;
+}
+
+template<typename T>
+std::strong_ordering typed_value_cmp( const value_t* a, const value_t* b )
+{
+    if ( !a || !b ) {
+        return ( a != nullptr ) <=> ( b != nullptr );
+    }
+    const auto x = value_ops<T>::get( a );
+    const auto y = value_ops<T>::get( b );
+    return strong_ordering<T>::cmp( &x, &y );
+}
+
+constexpr std::uint64_t hash_combine( std::uint64_t h, std::uint64_t x ) noexcept
+{
+    return ( h ^ x ) * 0x9e3779b97f4a7c15ULL;
+}
+
+// hash of null values
+constexpr std::uint64_t null_hash = 0x6a09e667f3bcc908ULL;
+
+
+// Hash table over the key columns of a relation's rows
+//
+// Chained through arrays: buckets hold the first row + 1 (0 for empty),
+// next the following row + 1 of each row's chain. Rows are inserted in
+// reverse, so chains are in row order and so is the join's output for
+// each probe row.
+struct join_hash_table
+{
+    join_hash_table(
+         const relation&                rel
+        ,const std::vector<size_t>&     cols
+    ) : m_hashes( rel.size(), 0 ), m_next( rel.size(), 0 )
+    {
+        const size_t n = rel.size();
+        for ( const size_t c : cols ) {
+            hash_column( *rel.m_cols[ c ], rel.m_ty.m_tys[ c ].second,
+                0, n, m_hashes.data() );
+        }
+        const size_t n_buckets = std::bit_ceil( std::max( n * 2, size_t( 16 ) ) );
+        m_mask = n_buckets - 1;
+        m_buckets.assign( n_buckets, 0 );
+        for ( size_t r = n; r-- > 0; ) {
+            size_t& head = m_buckets[ m_hashes[ r ] & m_mask ];
+            m_next[ r ] = head;
+            head = r + 1;
+        }
+    }
+
+    // f( row ) for each row with hash h
+    template<typename F>
+    void for_each_candidate( std::uint64_t h, F f ) const
+    {
+        for ( size_t e = m_buckets[ h & m_mask ]; e != 0; e = m_next[ e - 1 ] ) {
+            if ( m_hashes[ e - 1 ] == h ) {
+                f( e - 1 );
+            }
+        }
+    }
+
+private:
+    std::vector<std::uint64_t>  m_hashes;
+    std::vector<size_t>         m_next;
+    std::vector<size_t>         m_buckets;
+    size_t                      m_mask = 0;
+};
+
+// Rows of a column, gathered with others' into one output column
+struct gather_part
+{
+    const IStorage&         col;
+    std::span<const size_t> rows;
+};
+
+// New plain column of the rows of each part in turn, see gather_column
+IValue::storage_ptr_t gather_parts(
+     const type_t&                  ty
+    ,std::span<const gather_part>   parts
+    ,std::pmr::memory_resource*     rsrc
+)
+{
+    return visit_type( ty, [&]<typename T>( type_t_traits<T> ) -> IValue::storage_ptr_t {
+        auto s = std::make_shared< column_storage<T> >( rsrc );
+        size_t n = 0;
+        bool nullable = false;
+        for ( const auto& part : parts ) {
+            n += part.rows.size();
+            nullable = nullable || part.col.nullable();
+        }
+        s->reserve( n );
+        for ( const auto& [ col, rows ] : parts ) {
+            const T* data = contiguous_data<T>( col );
+            for ( const size_t r : rows ) {
+                if ( data && r != null_row ) {
+                    s->push_back( data[ r ] );
+                    continue;
+                }
+                const value_t* v = r == null_row ? nullptr : col.at( r );
+                if ( v ) {
+                    s->push_back( value_ops<T>::get( v ) );
+                } else {
+                    s->push_back( T() );
+                    nullable = true;
+                }
+            }
+        }
+        auto values = std::make_shared< untyped_column_storage<T> >( s );
+        if ( !nullable ) {
+            return values;
+        }
+        auto ns = std::make_shared<nullable_storage>( values, rsrc );
+        size_t i = 0;
+        for ( const auto& [ col, rows ] : parts ) {
+            for ( const size_t r : rows ) {
+                if ( r == null_row || !col.at( r ) ) {
+                    ns->set( i, nullptr );
+                }
+                ++i;
+            }
+        }
+        return ns;
+    } );
+}
+
+// the natural join of a and b from matched rows, common columns from a
+relation join_output(
+     const relation&            a
+    ,const row_map_t&           a_rows
+    ,const relation&            b
+    ,const row_map_t&           b_rows
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    const rel_ty_t out_ty = rel_ty_t::union_( a.m_ty, b.m_ty );
+    relation_builder_resources res;
+    for ( size_t c = 0; c < out_ty.m_tys.size(); ++c ) {
+        const auto in_a         = a.m_ty.index_of( out_ty.m_ids[ c ] );
+        const relation& src     = in_a ? a : b;
+        const size_t src_col    = in_a ? *in_a : *b.m_ty.index_of( out_ty.m_ids[ c ] );
+        const type_t& ty        = out_ty.m_tys[ c ].second;
+        relation::resource_ptr_t r = std::make_shared<column_resource>( rsrc );
+        auto s = gather_column( *src.m_cols[ src_col ], ty, in_a ? a_rows : b_rows, r.get() );
+        res.m_col_tys.push_back( out_ty.m_tys[ c ] );
+        res.m_ops.push_back( default_ops( ty, s->nullable() ) );
+        res.m_resources.push_back( r );
+        res.m_cols.push_back( s );
+    }
+    return relation( std::move( res ) );
+}
+
+// rows of rel
+relation gather_rows(
+     const relation&            rel
+    ,const row_map_t&           rows
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    relation_builder_resources res;
+    for ( size_t c = 0; c < rel.m_cols.size(); ++c ) {
+        const type_t& ty = rel.m_ty.m_tys[ c ].second;
+        relation::resource_ptr_t r = std::make_shared<column_resource>( rsrc );
+        auto s = gather_column( *rel.m_cols[ c ], ty, rows, r.get() );
+        res.m_col_tys.push_back( rel.m_ty.m_tys[ c ] );
+        res.m_ops.push_back( default_ops( ty, s->nullable() ) );
+        res.m_resources.push_back( r );
+        res.m_cols.push_back( s );
+    }
+    return relation( std::move( res ) );
+}
+
+// the product of rows a_sel of a and b_sel of b, in row order
+void product_rows(
+     const row_map_t&   a_sel
+    ,const row_map_t&   b_sel
+    ,row_map_t&         a_rows
+    ,row_map_t&         b_rows
+)
+{
+    a_rows.reserve( a_sel.size() * b_sel.size() );
+    b_rows.reserve( a_sel.size() * b_sel.size() );
+    for ( const size_t ar : a_sel ) {
+        a_rows.insert( a_rows.end(), b_sel.size(), ar );
+        b_rows.insert( b_rows.end(), b_sel.cbegin(), b_sel.cend() );
+    }
+}
+
+row_map_t all_rows( size_t n )
+{
+    row_map_t rows( n );
+    std::iota( rows.begin(), rows.end(), size_t( 0 ) );
+    return rows;
+}
+
+// header of the product of a and b
+rel_ty_t product_type( const relation* a, const relation* b )
+{
+    if ( !a || !b ) {
+        throw std::invalid_argument( "Product of null relation" );
+    }
+    const rel_ty_t common = rel_ty_t::intersect( a->m_ty, b->m_ty );
+    if ( !common.m_tys.empty() ) {
+        throw_with< std::invalid_argument >(
+            std::ostringstream()
+            << "Product of relations with common attributes "
+            << col_tys_to_string( common.m_tys )
+        );
+    }
+    return rel_ty_t::union_( a->m_ty, b->m_ty );
+}
+
+// the conjuncts of pred, flattening nested ands
+void conjuncts( const predicate& pred, std::vector<predicate>& out )
+{
+    if ( pred.kind == predicate::And ) {
+        for ( const auto& a : pred.args ) {
+            conjuncts( a, out );
+        }
+    } else {
+        out.push_back( pred );
+    }
+}
+
+// every column pred refers to is in ty
+bool refers_only_to( const predicate& pred, const rel_ty_t& ty )
+{
+    if ( pred.kind == predicate::Compare || pred.kind == predicate::IsNull ) {
+        return ty.index_of( pred.col ).has_value();
+    }
+    return std::all_of( pred.args.cbegin(), pred.args.cend(),
+        [&]( const predicate& a ) { return refers_only_to( a, ty ); } );
+}
+
+void require_same_type( const relation& a, const relation& b )
+{
+    if ( !( a.m_ty == b.m_ty ) ) {
+        throw_with< std::invalid_argument >(
+            std::ostringstream()
+            << "Set operator on relations of different types "
+            << col_tys_to_string( a.type() ) << " and "
+            << col_tys_to_string( b.type() )
+        );
+    }
+}
+
+// Inputs of a set operator, hashed by row
+struct set_inputs
+{
+    set_inputs( const relation& a, const relation& b ) : rels { &a, &b }
+    {
+        require_same_type( a, b );
+        for ( size_t c = 0; c < a.m_cols.size(); ++c ) {
+            eqs.push_back( value_eq( a.m_ty.m_tys[ c ].second ) );
+        }
+        for ( size_t side = 0; side < 2; ++side ) {
+            const relation& rel = *rels[ side ];
+            hashes[ side ].assign( rel.size(), 0 );
+            for ( size_t c = 0; c < rel.m_cols.size(); ++c ) {
+                hash_column( *rel.m_cols[ c ], rel.m_ty.m_tys[ c ].second,
+                    0, rel.size(), hashes[ side ].data() );
+            }
+        }
+    }
+
+    bool rows_equal( size_t x_side, size_t x, size_t y_side, size_t y ) const
+    {
+        for ( size_t c = 0; c < eqs.size(); ++c ) {
+            if ( !eqs[ c ]( rels[ x_side ]->at( x, c ), rels[ y_side ]->at( y, c ) ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::array<const relation*, 2>                  rels;
+    std::array<std::vector<std::uint64_t>, 2>       hashes;
+    std::vector<value_eq_t>                         eqs;
+};
+
+// Flat hash set of rows of set_inputs, open addressing with linear
+// probing. Slots hold the hash and the row, so most probes compare only
+// hashes.
+struct row_hash_set
+{
+    row_hash_set( const set_inputs& in, size_t max_rows )
+        : m_in( in )
+        , m_slots( std::bit_ceil( std::max( max_rows * 2, size_t( 16 ) ) ) )
+        , m_mask( m_slots.size() - 1 )
+    {
+    }
+
+    // the row equal to row of side, if present, as ( side, row )
+    std::optional< std::pair<size_t, size_t> > find( size_t side, size_t row ) const
+    {
+        const std::uint64_t h = m_in.hashes[ side ][ row ];
+        for ( size_t i = h & m_mask; m_slots[ i ].entry != 0; i = ( i + 1 ) & m_mask ) {
+            const slot& sl = m_slots[ i ];
+            if ( sl.hash == h && m_in.rows_equal( sl.side(), sl.row(), side, row ) ) {
+                return std::pair( sl.side(), sl.row() );
+            }
+        }
+        return std::nullopt;
+    }
+
+    // adds row of side unless an equal row is present (or known not to
+    // be, if distinct), returning whether it was added
+    bool insert( size_t side, size_t row, bool distinct = false )
+    {
+        const std::uint64_t h = m_in.hashes[ side ][ row ];
+        size_t i = h & m_mask;
+        for ( ; m_slots[ i ].entry != 0; i = ( i + 1 ) & m_mask ) {
+            const slot& sl = m_slots[ i ];
+            if ( !distinct && sl.hash == h
+                    && m_in.rows_equal( sl.side(), sl.row(), side, row ) ) {
+                return false;
+            }
+        }
+        m_slots[ i ] = slot { h, ( row << 1 | side ) + 1 };
+        return true;
+    }
+
+private:
+    struct slot
+    {
+        std::uint64_t   hash = 0;
+        size_t          entry = 0;  // ( row << 1 | side ) + 1, 0 if empty
+
+        size_t side() const noexcept { return ( entry - 1 ) & 1; }
+        size_t row() const noexcept { return ( entry - 1 ) >> 1; }
+    };
+
+    const set_inputs&   m_in;
+    std::vector<slot>   m_slots;
+    size_t              m_mask;
+};
+
+// all the rows of rel, without duplicates
+relation distinct( const relation& rel, std::pmr::memory_resource* rsrc )
+{
+    std::vector<std::string> names;
+    for ( const auto& col_ty : rel.type() ) {
+        names.push_back( col_ty.first );
+    }
+    return names.empty() ? rel : project( rel, names, rsrc );
+}
+
+// rows of a, keyed as a or on all attributes
+relation gather_set_rows(
+     const relation&            a
+    ,const row_map_t&           rows
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    relation out = gather_rows( a, rows, rsrc );
+    out.m_keys = a.m_keys.empty() ? std::vector<col_tys_t> { out.m_ty.m_tys } : a.m_keys;
+    return out;
+}
+
+// rows of a in ( b ) if in, else not in b
+relation semi_join(
+     const relation&            a
+    ,const relation&            b
+    ,bool                       in
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    set_inputs inputs( a, b );
+    const size_t na = a.size();
+    const size_t nb = b.size();
+    const bool a_keyed = !a.m_keys.empty();
+    row_map_t rows;
+    if ( a_keyed && nb < na ) {
+        // table over b, probed with a
+        row_hash_set table( inputs, nb );
+        for ( size_t r = 0; r < nb; ++r ) {
+            table.insert( 1, r );
+        }
+        for ( size_t r = 0; r < na; ++r ) {
+            if ( table.find( 0, r ).has_value() == in ) {
+                rows.push_back( r );
+            }
+        }
+    } else {
+        // table over a, deduplicating it, marking rows found in b
+        row_hash_set table( inputs, na );
+        std::vector<std::uint8_t> found( na, 0 );
+        row_map_t a_rows;
+        for ( size_t r = 0; r < na; ++r ) {
+            if ( table.insert( 0, r, a_keyed ) ) {
+                a_rows.push_back( r );
+            }
+        }
+        for ( size_t r = 0; r < nb; ++r ) {
+            if ( const auto e = table.find( 1, r ) ) {
+                found[ e->second ] = 1;
+            }
+        }
+        for ( const size_t r : a_rows ) {
+            if ( ( found[ r ] != 0 ) == in ) {
+                rows.push_back( r );
+            }
+        }
+    }
+    return gather_set_rows( a, rows, rsrc );
+}
+
+// Accumulators of one aggregate over groups
+struct agg_state
+{
+    agg_state() = default;
+    agg_state( const agg_state& ) = delete;
+    agg_state& operator=( const agg_state& ) = delete;
+    virtual ~agg_state() = default;
+
+    virtual void resize( size_t groups ) = 0;
+
+    // rows [first, first + n) are of groups gids, or all of group 0 if
+    // gids is nullptr
+    virtual void update( size_t first, size_t n, const size_t* gids ) = 0;
+
+    virtual IValue::storage_ptr_t result( std::pmr::memory_resource* rsrc ) const = 0;
+};
+
+typedef std::unique_ptr<agg_state> agg_state_ptr;
+
+int checked_int( std::int64_t x )
+{
+    if ( !std::in_range<int>( x ) ) {
+        throw std::overflow_error( "Aggregate out of range of Int" );
+    }
+    return static_cast<int>( x );
+}
+
+// New plain column of value( g ) for groups g, null where empty
+template<typename R, typename F>
+IValue::storage_ptr_t result_column( size_t groups, F value, std::pmr::memory_resource* rsrc )
+{
+    auto s = std::make_shared< column_storage<R> >( rsrc );
+    s->reserve( groups );
+    row_map_t nulls;
+    for ( size_t g = 0; g < groups; ++g ) {
+        const std::optional<R> v = value( g );
+        s->push_back( v.value_or( R() ) );
+        if ( !v ) {
+            nulls.push_back( g );
+        }
+    }
+    auto values = std::make_shared< untyped_column_storage<R> >( s );
+    if ( nulls.empty() ) {
+        return values;
+    }
+    auto ns = std::make_shared<nullable_storage>( values, rsrc );
+    for ( const size_t g : nulls ) {
+        ns->set( g, nullptr );
+    }
+    return ns;
+}
+
+// Count of rows
+struct row_count_state : agg_state
+{
+    void resize( size_t groups ) override
+    {
+        m_count.resize( groups, 0 );
+    }
+
+    void update( size_t /* first */, size_t n, const size_t* gids ) override
+    {
+        if ( !gids ) {
+            m_count[ 0 ] += std::int64_t( n );
+            return;
+        }
+        for ( size_t i = 0; i < n; ++i ) {
+            ++m_count[ gids[ i ] ];
+        }
+    }
+
+    IValue::storage_ptr_t result( std::pmr::memory_resource* rsrc ) const override
+    {
+        return result_column<int>( m_count.size(), [&]( size_t g ) {
+            return std::optional( checked_int( m_count[ g ] ) );
+        }, rsrc );
+    }
+
+private:
+    std::vector<std::int64_t>   m_count;
+};
+
+// Aggregate Op of a column of T
+template<typename T, agg_op_t Op>
+struct column_agg_state : agg_state
+{
+    // Sum of integers accumulates exactly, others in double
+    typedef std::conditional_t< Op == Min || Op == Max, T,
+        std::conditional_t< Op == Sum && std::is_integral_v<T>, std::int64_t, double > > acc_t;
+
+    explicit column_agg_state( const IStorage& col )
+        : m_col( col ), m_valid( validity_of( col ) ), m_values( dense_values( col ) )
+    {
+        if constexpr ( std::is_arithmetic_v<T> && !std::is_same_v<T, bool> ) {
+            const auto* p = dynamic_cast< const untyped_rle_column_storage<T>* >( &col );
+            m_rle = p ? &p->typed_storage() : nullptr;
+        }
+    }
+
+    static constexpr acc_t init() noexcept
+    {
+        if constexpr ( Op == Min ) {
+            return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                : std::numeric_limits<T>::max();
+        } else if constexpr ( Op == Max ) {
+            return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity()
+                : std::numeric_limits<T>::lowest();
+        } else {
+            return acc_t( 0 );
+        }
+    }
+
+    template<typename U>
+    static void step( acc_t& acc, U x ) noexcept
+    {
+        if constexpr ( Op == Min ) {
+            acc = x < acc ? x : acc;
+        } else if constexpr ( Op == Max ) {
+            acc = x > acc ? x : acc;
+        } else if constexpr ( Op != Count && std::is_same_v<U, acc_t> ) {
+            acc += x;
+        } else if constexpr ( Op != Count ) {
+            acc += static_cast<acc_t>( x );
+        }
+    }
+
+    // step by n copies of x, as for a run
+    static void step_n( acc_t& acc, T x, size_t n ) noexcept
+    {
+        if constexpr ( Op == Min || Op == Max ) {
+            step( acc, x );
+        } else if constexpr ( Op != Count && std::is_same_v<T, acc_t> ) {
+            acc += x * static_cast<acc_t>( n );
+        } else if constexpr ( Op != Count ) {
+            acc += static_cast<acc_t>( x ) * static_cast<acc_t>( n );
+        }
+    }
+
+    // reduction of n values, in independent lanes the compiler can keep
+    // in vector registers
+    static acc_t reduce( const T* data, size_t n ) noexcept
+    {
+        constexpr size_t lanes = 8;
+        std::array<acc_t, lanes> lane;
+        lane.fill( init() );
+        size_t i = 0;
+        for ( ; i + lanes <= n; i += lanes ) {
+            for ( size_t j = 0; j < lanes; ++j ) {
+                step( lane[ j ], data[ i + j ] );
+            }
+        }
+        for ( ; i < n; ++i ) {
+            step( lane[ 0 ], data[ i ] );
+        }
+        acc_t acc = init();
+        for ( const acc_t l : lane ) {
+            step( acc, l );
+        }
+        return acc;
+    }
+
+    void resize( size_t groups ) override
+    {
+        m_acc.resize( groups, init() );
+        m_count.resize( groups, 0 );
+    }
+
+    void update( size_t first, size_t n, const size_t* gids ) override
+    {
+        if constexpr ( Op == Count ) {
+            // counts need only the validity
+            if ( m_valid || !m_col.nullable() ) {
+                update_counts( first, n, gids );
+                return;
+            }
+        }
+        if ( m_values ) {
+            std::array<T, summarize_batch_rows> buf;
+            for ( size_t done = 0; done < n; done += summarize_batch_rows ) {
+                const size_t k = std::min( summarize_batch_rows, n - done );
+                const T* vs = m_values.read( first + done, k, buf.data() );
+                if ( m_valid ) {
+                    update_valid( vs, first + done, k, gids ? gids + done : nullptr );
+                } else {
+                    update_values( vs, k, gids ? gids + done : nullptr );
+                }
+            }
+        } else if ( m_rle ) {
+            update_runs( first, n, gids );
+        } else {
+            for ( size_t i = 0; i < n; ++i ) {
+                const value_t* v = m_col.at( first + i );
+                if ( v ) {
+                    const size_t g = gids ? gids[ i ] : 0;
+                    if constexpr ( Op != Count ) {
+                        step( m_acc[ g ], value_ops<T>::get( v ) );
+                    }
+                    ++m_count[ g ];
+                }
+            }
+        }
+    }
+
+    IValue::storage_ptr_t result( std::pmr::memory_resource* rsrc ) const override
+    {
+        const size_t groups = m_count.size();
+        if constexpr ( Op == Count ) {
+            return result_column<int>( groups, [&]( size_t g ) {
+                return std::optional( checked_int( m_count[ g ] ) );
+            }, rsrc );
+        } else if constexpr ( Op == Sum && std::is_integral_v<T> ) {
+            return result_column<double>( groups, [&]( size_t g ) {
+                return std::optional( double( m_acc[ g ] ) );
+            }, rsrc );
+        } else if constexpr ( Op == Sum ) {
+            return result_column<double>( groups, [&]( size_t g ) {
+                return std::optional( m_acc[ g ] );
+            }, rsrc );
+        } else if constexpr ( Op == Avg ) {
+            return result_column<double>( groups, [&]( size_t g ) {
+                return m_count[ g ] == 0 ? std::nullopt
+                    : std::optional( m_acc[ g ] / double( m_count[ g ] ) );
+            }, rsrc );
+        } else {
+            return result_column<T>( groups, [&]( size_t g ) {
+                return m_count[ g ] == 0 ? std::nullopt : std::optional( m_acc[ g ] );
+            }, rsrc );
+        }
+    }
+
+private:
+    // n non-null values, of groups gids or all of group 0
+    void update_values( const T* vs, size_t n, const size_t* gids )
+    {
+        if ( !gids ) {
+            if constexpr ( Op != Count ) {
+                step( m_acc[ 0 ], reduce( vs, n ) );
+            }
+            m_count[ 0 ] += std::int64_t( n );
+            return;
+        }
+        for ( size_t i = 0; i < n; ++i ) {
+            step( m_acc[ gids[ i ] ], vs[ i ] );
+            ++m_count[ gids[ i ] ];
+        }
+    }
+
+    // values of rows [row, row + n) of a nullable column, stepping only
+    // the valid ones, a validity word at a time
+    void update_valid( const T* vs, size_t row, size_t n, const size_t* gids )
+    {
+        constexpr size_t bits = column_storage<bool>::word_bits;
+        for ( size_t i = 0; i < n; ) {
+            const size_t k = std::min( bits - ( row + i ) % bits, n - i );
+            std::uint64_t w = validity_bits( *m_valid, row + i, k );
+            if ( w == low_bits( k ) ) {
+                update_values( vs + i, k, gids ? gids + i : nullptr );
+            } else {
+                for ( ; w != 0; w &= w - 1 ) {
+                    const size_t j = i + size_t( std::countr_zero( w ) );
+                    const size_t g = gids ? gids[ j ] : 0;
+                    step( m_acc[ g ], vs[ j ] );
+                    ++m_count[ g ];
+                }
+            }
+            i += k;
+        }
+    }
+
+    // non-null rows [first, first + n), from the validity words if any
+    void update_counts( size_t first, size_t n, const size_t* gids )
+    {
+        if ( !m_valid && !gids ) {
+            m_count[ 0 ] += std::int64_t( n );
+            return;
+        }
+        constexpr size_t bits = column_storage<bool>::word_bits;
+        for ( size_t i = 0; i < n; ) {
+            const size_t k = std::min( bits - ( first + i ) % bits, n - i );
+            std::uint64_t w = m_valid ? validity_bits( *m_valid, first + i, k ) : low_bits( k );
+            if ( !gids ) {
+                m_count[ 0 ] += std::popcount( w );
+            } else {
+                for ( ; w != 0; w &= w - 1 ) {
+                    ++m_count[ gids[ i + size_t( std::countr_zero( w ) ) ] ];
+                }
+            }
+            i += k;
+        }
+    }
+
+    // rows [first, first + n) of an RLE column, a run at a time
+    void update_runs( size_t first, size_t n, const size_t* gids )
+    {
+        if constexpr ( std::is_arithmetic_v<T> && !std::is_same_v<T, bool> ) {
+            const size_t* ends = m_rle->ends();
+            const size_t last  = first + n;
+            for ( size_t r = m_rle->run( first ), row = first; row < last; ++r ) {
+                const size_t end = std::min( ends[ r ], last );
+                const T v = m_rle->values()[ r ];
+                if ( !gids ) {
+                    step_n( m_acc[ 0 ], v, end - row );
+                    m_count[ 0 ] += std::int64_t( end - row );
+                } else {
+                    for ( size_t i = row - first; i < end - first; ++i ) {
+                        step( m_acc[ gids[ i ] ], v );
+                        ++m_count[ gids[ i ] ];
+                    }
+                }
+                row = end;
+            }
+        }
+    }
+
+    const IStorage&                 m_col;
+    const column_storage<bool>*     m_valid;
+    block_reader<T>                 m_values;       // dense, also of nullable columns
+    const rle_column_storage<T>*    m_rle = nullptr;
+    std::vector<acc_t>              m_acc;
+    std::vector<std::int64_t>       m_count;        // of non-null values
+};
+
+agg_state_ptr make_agg_state( const relation& rel, const aggregate& agg )
+{
+    if ( agg.col.empty() ) {
+        if ( agg.op != Count ) {
+            throw_with< std::invalid_argument >(
+                std::ostringstream()
+                << "Aggregate '" << agg.as << "' has no column"
+            );
+        }
+        return std::make_unique<row_count_state>();
+    }
+    const size_t c = rel.col_index( agg.col );
+    const type_t& ty = rel.m_ty.m_tys[ c ].second;
+    aggregate_type( agg.op, ty );   // checks the type
+    return visit_type( ty, [&]<typename T>( type_t_traits<T> ) -> agg_state_ptr {
+        const IStorage& col = *rel.m_cols[ c ];
+        if constexpr ( std::is_arithmetic_v<T> && !std::is_same_v<T, bool> ) {
+            switch ( agg.op ) {
+                case Count: return std::make_unique< column_agg_state<T, Count> >( col );
+                case Sum:   return std::make_unique< column_agg_state<T, Sum> >( col );
+                case Min:   return std::make_unique< column_agg_state<T, Min> >( col );
+                case Max:   return std::make_unique< column_agg_state<T, Max> >( col );
+                case Avg:   return std::make_unique< column_agg_state<T, Avg> >( col );
+            }
+        } else {
+            if ( agg.op == Count ) {
+                return std::make_unique< column_agg_state<T, Count> >( col );
+            }
+        }
+        throw std::invalid_argument( "Unrecognised aggregate" );
+    } );
+}
+
+// Flat hash table of the groups of rows of a relation, on some columns
+// Slots hold the group's hash and id + 1 (0 if empty).
+struct group_table
+{
+    group_table( const relation& rel, const std::vector<size_t>& cols )
+        : m_rel( rel ), m_cols( cols ), m_slots( 64 )
+    {
+        for ( const size_t c : m_cols ) {
+            m_eqs.push_back( value_eq( rel.m_ty.m_tys[ c ].second ) );
+        }
+    }
+
+    size_t size() const noexcept
+    {
+        return m_rows.size();
+    }
+
+    // first row of each group
+    const row_map_t& rows() const noexcept
+    {
+        return m_rows;
+    }
+
+    // groups of rows [first, first + n), adding new ones
+    void assign( size_t first, size_t n, size_t* gids )
+    {
+        std::fill_n( m_batch.begin(), n, 0 );
+        for ( const size_t c : m_cols ) {
+            hash_column( *m_rel.m_cols[ c ], m_rel.m_ty.m_tys[ c ].second,
+                first, n, m_batch.data() );
+        }
+        for ( size_t i = 0; i < n; ++i ) {
+            gids[ i ] = find_or_add( m_batch[ i ], first + i );
+        }
+    }
+
+private:
+    size_t find_or_add( std::uint64_t h, size_t row )
+    {
+        const size_t mask = m_slots.size() - 1;
+        size_t i = h & mask;
+        for ( ; m_slots[ i ].second != 0; i = ( i + 1 ) & mask ) {
+            const size_t g = m_slots[ i ].second - 1;
+            if ( m_slots[ i ].first == h && rows_equal( m_rows[ g ], row ) ) {
+                return g;
+            }
+        }
+        const size_t g = m_rows.size();
+        m_slots[ i ] = { h, g + 1 };
+        m_rows.push_back( row );
+        if ( m_rows.size() * 2 > m_slots.size() ) {
+            grow();
+        }
+        return g;
+    }
+
+    void grow()
+    {
+        std::vector< std::pair<std::uint64_t, size_t> > slots( m_slots.size() * 2 );
+        const size_t mask = slots.size() - 1;
+        for ( const auto& sl : m_slots ) {
+            if ( sl.second != 0 ) {
+                size_t i = sl.first & mask;
+                while ( slots[ i ].second != 0 ) {
+                    i = ( i + 1 ) & mask;
+                }
+                slots[ i ] = sl;
+            }
+        }
+        m_slots = std::move( slots );
+    }
+
+    bool rows_equal( size_t x, size_t y ) const
+    {
+        for ( size_t k = 0; k < m_cols.size(); ++k ) {
+            if ( !m_eqs[ k ]( m_rel.at( x, m_cols[ k ] ), m_rel.at( y, m_cols[ k ] ) ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const relation&                                 m_rel;
+    std::vector<size_t>                             m_cols;
+    std::vector<value_eq_t>                         m_eqs;
+    std::vector< std::pair<std::uint64_t, size_t> > m_slots;
+    row_map_t                                       m_rows;
+    std::array<std::uint64_t, summarize_batch_rows> m_batch {};
+};
+
+// Key columns of one input of a merge join, in merge order
+struct merge_input
+{
+    const relation&         rel;
+    const size_t*           rows;   // nullptr for identity
+    std::vector<size_t>     cols;
+
+    size_t row( size_t i ) const noexcept
+    {
+        return rows ? rows[ i ] : i;
+    }
+};
+
+relation merge_join_inputs(
+     const merge_input&         a
+    ,const merge_input&         b
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    std::vector<value_cmp_t> cmps;
+    for ( const size_t c : a.cols ) {
+        cmps.push_back( value_cmp( a.rel.m_ty.m_tys[ c ].second ) );
+    }
+    // compare rows i of x and j of y
+    const auto cmp = [&]( const merge_input& x, size_t i, const merge_input& y, size_t j ) {
+        const size_t xr = x.row( i );
+        const size_t yr = y.row( j );
+        for ( size_t k = 0; k < cmps.size(); ++k ) {
+            const auto c = cmps[ k ]( x.rel.at( xr, x.cols[ k ] ), y.rel.at( yr, y.cols[ k ] ) );
+            if ( c != std::strong_ordering::equal ) {
+                return c;
+            }
+        }
+        return std::strong_ordering::equal;
+    };
+
+    row_map_t a_rows, b_rows;
+    const size_t na = a.rel.size();
+    const size_t nb = b.rel.size();
+    size_t i = 0, j = 0;
+    while ( i < na && j < nb ) {
+        const auto c = cmp( a, i, b, j );
+        if ( c == std::strong_ordering::less ) {
+            ++i;
+        } else if ( c == std::strong_ordering::greater ) {
+            ++j;
+        } else {
+            // runs of equal keys, output their product
+            size_t i_end = i + 1;
+            while ( i_end < na && cmp( a, i_end, a, i ) == std::strong_ordering::equal ) {
+                ++i_end;
+            }
+            size_t j_end = j + 1;
+            while ( j_end < nb && cmp( b, j_end, b, j ) == std::strong_ordering::equal ) {
+                ++j_end;
+            }
+            for ( size_t x = i; x < i_end; ++x ) {
+                for ( size_t y = j; y < j_end; ++y ) {
+                    a_rows.push_back( a.row( x ) );
+                    b_rows.push_back( b.row( y ) );
+                }
+            }
+            i = i_end;
+            j = j_end;
+        }
+    }
+    return join_output( a.rel, a_rows, b.rel, b_rows, rsrc );
+}
+
+const relation& view_relation( const table_view& v )
+{
+    const auto* rel = dynamic_cast<const relation*>( v.base().get() );
+    if ( !rel ) {
+        throw std::invalid_argument( "merge_join requires views of relations" );
+    }
+    return *rel;
+}
+
+
+// Truth values of three valued logic, ordered so that and is min, or is
+// max and not is True - x
+constexpr std::uint8_t False    = 0;
+constexpr std::uint8_t Unknown  = 1;
+constexpr std::uint8_t True     = 2;
+
+// Predicate compiled against a relation's columns
+struct block_predicate
+{
+    block_predicate() = default;
+    block_predicate( const block_predicate& ) = delete;
+    block_predicate& operator=( const block_predicate& ) = delete;
+    virtual ~block_predicate() = default;
+
+    // mask[ i ] = the truth value of the predicate for row first + i
+    virtual void eval( size_t first, size_t n, std::uint8_t* mask ) const = 0;
+};
+
+typedef std::unique_ptr<block_predicate> block_predicate_ptr;
+
+template<typename T>
+bool apply_cmp( cmp_op_t op, const T& x, const T& y )
+{
+    switch ( op ) {
+        case Eq: return x == y;
+        case Ne: return x != y;
+        case Lt: return x < y;
+        case Le: return x <= y;
+        case Gt: return x > y;
+        case Ge: return x >= y;
+    }
+    return false;
+}
+
+// mask[ i ] = data[ i ] op v, one loop per operator so each vectorizes
+template<typename T>
+void compare_block( cmp_op_t op, const T* data, size_t n, T v, std::uint8_t* mask )
+{
+    const auto truth = []( bool b ) { return b ? True : False; };
+    switch ( op ) {
+        case Eq: for ( size_t i = 0; i < n; ++i ) { mask[ i ] = truth( data[ i ] == v ); } break;
+        case Ne: for ( size_t i = 0; i < n; ++i ) { mask[ i ] = truth( data[ i ] != v ); } break;
+        case Lt: for ( size_t i = 0; i < n; ++i ) { mask[ i ] = truth( data[ i ] < v ); } break;
+        case Le: for ( size_t i = 0; i < n; ++i ) { mask[ i ] = truth( data[ i ] <= v ); } break;
+        case Gt: for ( size_t i = 0; i < n; ++i ) { mask[ i ] = truth( data[ i ] > v ); } break;
+        case Ge: for ( size_t i = 0; i < n; ++i ) { mask[ i ] = truth( data[ i ] >= v ); } break;
+    }
+}
+
+// the literal as a value of type T, if it converts
+template<typename T>
+std::optional<T> literal_value( const literal_t& lit )
+{
+    if constexpr ( std::is_same_v<T, bool> ) {
+        if ( std::holds_alternative<bool>( lit ) ) {
+            return std::get<bool>( lit );
+        }
+    } else if constexpr ( std::is_same_v<T, std::string_view> ) {
+        if ( std::holds_alternative<std::string>( lit ) ) {
+            return std::string_view( std::get<std::string>( lit ) );
+        }
+    } else if constexpr ( std::is_integral_v<T> ) {
+        if ( std::holds_alternative<std::int64_t>( lit ) ) {
+            const std::int64_t x = std::get<std::int64_t>( lit );
+            if ( std::in_range<T>( x ) ) {
+                return static_cast<T>( x );
+            }
+        } else if ( std::holds_alternative<double>( lit ) ) {
+            const double x = std::get<double>( lit );
+            if ( x >= double( std::numeric_limits<T>::min() )
+                    && x <= double( std::numeric_limits<T>::max() )
+                    && double( static_cast<T>( x ) ) == x ) {
+                return static_cast<T>( x );
+            }
+        }
+    } else {
+        if ( std::holds_alternative<std::int64_t>( lit ) ) {
+            return static_cast<T>( std::get<std::int64_t>( lit ) );
+        }
+        if ( std::holds_alternative<double>( lit ) ) {
+            if constexpr ( std::is_same_v<T, double> ) {
+                return std::get<double>( lit );
+            } else {
+                return static_cast<T>( std::get<double>( lit ) );
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+// rows of a nullable column that are null are Unknown, a validity word at
+// a time, so words with no nulls cost one test
+void mask_nulls( const column_storage<bool>& valid, size_t first, size_t n, std::uint8_t* mask )
+{
+    constexpr size_t bits = column_storage<bool>::word_bits;
+    for ( size_t i = 0; i < n; ) {
+        const size_t k = std::min( bits - ( first + i ) % bits, n - i );
+        const std::uint64_t w = validity_bits( valid, first + i, k );
+        if ( w != low_bits( k ) ) {
+            for ( size_t j = 0; j < k; ++j ) {
+                if ( ( ( w >> j ) & 1U ) == 0 ) {
+                    mask[ i + j ] = Unknown;
+                }
+            }
+        }
+        i += k;
+    }
+}
+
+// mask[ i ] = codes[ i ] in [lo, hi), or not in it if negate, one
+// unsigned compare per row
+template<typename Code>
+void code_range_block( const Code* codes, size_t n, size_t lo, size_t hi, bool negate
+                     , std::uint8_t* mask )
+{
+    const size_t width = hi - lo;
+    for ( size_t i = 0; i < n; ++i ) {
+        mask[ i ] = ( ( size_t( codes[ i ] ) - lo < width ) != negate ) ? True : False;
+    }
+}
+
+// Compares a column with a constant, with a path per encoding that avoids
+// IStorage::at() per row: dense values a block at a time (see
+// block_reader), dictionary codes against the constant's code range, RLE
+// runs once per run. Nullable columns take the path of their dense
+// values, then nulls are masked with the validity words.
+template<typename T>
+struct compare_predicate : block_predicate
+{
+    compare_predicate( const IStorage& col, cmp_op_t op, T v )
+        : m_col( col ), m_base( dense_values( col ) ), m_valid( validity_of( col ) )
+        , m_values( m_base ), m_op( op ), m_v( v )
+    {
+        if constexpr ( std::is_same_v<T, std::string_view> ) {
+            init_codes< std::uint8_t >() || init_codes< std::uint16_t >()
+                || init_codes< std::uint32_t >();
+        } else if constexpr ( std::is_arithmetic_v<T> && !std::is_same_v<T, bool> ) {
+            if ( const auto* p = dynamic_cast< const untyped_rle_column_storage<T>* >( &m_base ) ) {
+                m_rle = &p->typed_storage();
+            }
+        }
+    }
+
+    void eval( size_t first, size_t n, std::uint8_t* mask ) const override
+    {
+        if ( !may_match( first, n ) ) {
+            std::fill_n( mask, n, False );
+            return;
+        }
+        if ( !eval_dense( first, n, mask ) ) {
+            // comparisons with null are unknown
+            for ( size_t i = 0; i < n; ++i ) {
+                const value_t* v = m_col.at( first + i );
+                mask[ i ] = !v ? Unknown
+                    : apply_cmp( m_op, value_ops<T>::get( v ), m_v ) ? True : False;
+            }
+            return;
+        }
+        if ( m_valid ) {
+            mask_nulls( *m_valid, first, n, mask );
+        }
+    }
+
+private:
+    // compares the dense values, false if they have no typed path
+    bool eval_dense( size_t first, size_t n, std::uint8_t* mask ) const
+    {
+        if ( m_values ) {
+            std::array<T, filter_block_rows> buf;
+            compare_block( m_op, m_values.read( first, n, buf.data() ), n, m_v, mask );
+            return true;
+        }
+        if constexpr ( std::is_same_v<T, std::string_view> ) {
+            if ( m_codes ) {
+                std::visit( [&]( const auto* codes ) {
+                    code_range_block( codes + first, n, m_code_lo, m_code_hi, m_code_negate, mask );
+                }, *m_codes );
+                return true;
+            }
+        } else if constexpr ( std::is_arithmetic_v<T> && !std::is_same_v<T, bool> ) {
+            if ( m_rle ) {
+                const size_t* ends = m_rle->ends();
+                const size_t last  = first + n;
+                for ( size_t r = m_rle->run( first ), row = first; row < last; ++r ) {
+                    const size_t end = std::min( ends[ r ], last );
+                    std::fill( mask + ( row - first ), mask + ( end - first )
+                        , apply_cmp( m_op, m_rle->values()[ r ], m_v ) ? True : False );
+                    row = end;
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // the rows matching, as a range of codes of a dictionary column (or
+    // the rows outside it, for Ne), looked up once
+    template<typename Code>
+    bool init_codes()
+    {
+        const auto* p = dynamic_cast< const untyped_dictionary_column_storage<Code>* >( &m_base );
+        if ( !p ) {
+            return false;
+        }
+        const auto& dict = p->typed_storage();
+        const size_t lb  = dict.lower_bound( m_v );
+        const size_t ub  = dict.find( m_v ) ? lb + 1 : lb;
+        const size_t end = dict.dictionary().size();
+        switch ( m_op ) {
+            case Eq: m_code_lo = lb; m_code_hi = ub; break;
+            case Ne: m_code_lo = lb; m_code_hi = ub; m_code_negate = true; break;
+            case Lt: m_code_lo = 0;  m_code_hi = lb; break;
+            case Le: m_code_lo = 0;  m_code_hi = ub; break;
+            case Gt: m_code_lo = ub; m_code_hi = end; break;
+            case Ge: m_code_lo = lb; m_code_hi = end; break;
+        }
+        m_codes = dict.codes();
+        return true;
+    }
+
+    // false if the zone maps show no row in [first, first + n) can match
+    // Note: zones with nulls are evaluated, as those rows are Unknown
+    bool may_match( size_t first, size_t n ) const noexcept
+    {
+        const size_t rows = m_col.zone_rows();
+        if ( rows == 0 ) {
+            return true;
+        }
+        for ( size_t z = first / rows; z * rows < first + n; ++z ) {
+            const auto zn = m_col.zone( z );
+            if ( !zn || zn->null_count != 0
+                    || zone_may_match( value_ops<T>::get( zn->min ),
+                        value_ops<T>::get( zn->max ) ) ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool zone_may_match( const T& lo, const T& hi ) const noexcept
+    {
+        // NaN orders first, so a NaN min hides the smallest number
+        if constexpr ( std::is_floating_point_v<T> ) {
+            if ( std::isnan( lo ) || std::isnan( hi ) ) {
+                return true;
+            }
+        }
+        switch ( m_op ) {
+            case Eq: return !( m_v < lo ) && !( hi < m_v );
+            // NaN is not in the bounds, but is != everything
+            case Ne: return std::is_floating_point_v<T> || lo != m_v || hi != m_v;
+            case Lt: return lo < m_v;
+            case Le: return lo <= m_v;
+            case Gt: return hi > m_v;
+            case Ge: return hi >= m_v;
+        }
+        return true;
+    }
+
+    typedef std::variant< const std::uint8_t*, const std::uint16_t*, const std::uint32_t* >
+        codes_t;
+
+    const IStorage&             m_col;
+    const IStorage&             m_base;
+    const column_storage<bool>* m_valid;
+    block_reader<T>             m_values;
+    cmp_op_t                    m_op;
+    T                           m_v;
+
+    std::optional<codes_t>      m_codes;
+    size_t                      m_code_lo       = 0;
+    size_t                      m_code_hi       = 0;
+    bool                        m_code_negate   = false;
+
+    const rle_column_storage<T>* m_rle = nullptr;
+};
+
+struct is_null_predicate : block_predicate
+{
+    explicit is_null_predicate( const IStorage& col ) : m_col( col )
+    {
+    }
+
+    void eval( size_t first, size_t n, std::uint8_t* mask ) const override
+    {
+        if ( m_col.null_count() == 0 ) {
+            std::fill_n( mask, n, False );
+            return;
+        }
+        for ( size_t i = 0; i < n; ++i ) {
+            mask[ i ] = m_col.at( first + i ) == nullptr ? True : False;
+        }
+    }
+
+private:
+    const IStorage& m_col;
+};
+
+// And and Or, stopping once the result is known for every row
+struct bool_predicate : block_predicate
+{
+    bool_predicate( bool is_and, std::vector<block_predicate_ptr>&& args )
+        : m_and( is_and ), m_args( std::move( args ) )
+    {
+    }
+
+    void eval( size_t first, size_t n, std::uint8_t* mask ) const override
+    {
+        const std::uint8_t unit = m_and ? True : False;
+        const std::uint8_t zero = m_and ? False : True;
+        std::fill_n( mask, n, unit );
+        std::array<std::uint8_t, filter_block_rows> arg {};
+        for ( const auto& a : m_args ) {
+            // all rows decided when all are zero
+            if ( std::all_of( mask, mask + n, [&]( std::uint8_t x ) { return x == zero; } ) ) {
+                return;
+            }
+            a->eval( first, n, arg.data() );
+            if ( m_and ) {
+                for ( size_t i = 0; i < n; ++i ) { mask[ i ] = std::min( mask[ i ], arg[ i ] ); }
+            } else {
+                for ( size_t i = 0; i < n; ++i ) { mask[ i ] = std::max( mask[ i ], arg[ i ] ); }
+            }
+        }
+    }
+
+private:
+    bool                                m_and;
+    std::vector<block_predicate_ptr>    m_args;
+};
+
+struct not_predicate : block_predicate
+{
+    explicit not_predicate( block_predicate_ptr&& arg ) : m_arg( std::move( arg ) )
+    {
+    }
+
+    void eval( size_t first, size_t n, std::uint8_t* mask ) const override
+    {
+        m_arg->eval( first, n, mask );
+        for ( size_t i = 0; i < n; ++i ) {
+            mask[ i ] = std::uint8_t( True - mask[ i ] );
+        }
+    }
+
+private:
+    block_predicate_ptr m_arg;
+};
+
+block_predicate_ptr compile_predicate( const relation& rel, const predicate& pred )
+{
+    switch ( pred.kind ) {
+        case predicate::Compare: {
+            const size_t c = rel.col_index( pred.col );
+            return visit_type( rel.m_ty.m_tys[ c ].second,
+                [&]<typename T>( type_t_traits<T> ) -> block_predicate_ptr {
+                    const auto v = literal_value<T>( pred.value );
+                    if ( !v ) {
+                        throw_with< std::invalid_argument >(
+                            std::ostringstream()
+                            << "Constant can't be compared with column '" << pred.col
+                            << "' of type " << ty_to_string( type_t_traits<T>::ty() )
+                        );
+                    }
+                    return std::make_unique< compare_predicate<T> >(
+                        *rel.m_cols[ c ], pred.op, *v );
+                } );
+        }
+        case predicate::IsNull:
+            return std::make_unique<is_null_predicate>( *rel.m_cols[ rel.col_index( pred.col ) ] );
+        case predicate::And:
+        case predicate::Or: {
+            std::vector<block_predicate_ptr> args;
+            for ( const auto& a : pred.args ) {
+                args.push_back( compile_predicate( rel, a ) );
+            }
+            return std::make_unique<bool_predicate>( pred.kind == predicate::And, std::move( args ) );
+        }
+        case predicate::Not:
+            if ( pred.args.size() != 1 ) {
+                throw std::invalid_argument( "Not predicate must have one argument" );
+            }
+            return std::make_unique<not_predicate>( compile_predicate( rel, pred.args[ 0 ] ) );
+    }
+    throw std::invalid_argument( "Unrecognised predicate" );
+}
+
+}
+
+
+IValue* default_ops( const type_t& ty, bool nullable )
+{
+    return visit_type( ty, [&]<typename T>( type_t_traits<T> ) {
+        return nullable ? untyped_value_ops< std::optional<T> >::ops()
+            : untyped_value_ops<T>::ops();
+    } );
+}
+
+IValue::storage_ptr_t gather_column(
+     const IStorage&            col
+    ,const type_t&              ty
+    ,std::span<const size_t>    rows
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    const gather_part part { col, rows };
+    return gather_parts( ty, std::span( &part, 1 ), rsrc );
+}
+
+void hash_column(
+     const IStorage&            col
+    ,const type_t&              ty
+    ,size_t                     first
+    ,size_t                     n
+    ,std::uint64_t*             hashes
+)
+{
+    visit_type( ty, [&]<typename T>( type_t_traits<T> ) {
+        const T* data = contiguous_data<T>( col );
+        if ( data ) {
+            for ( size_t i = 0; i < n; ++i ) {
+                hashes[ i ] = hash_combine( hashes[ i ], hash_of<T>( data[ first + i ] ) );
+            }
+            return;
+        }
+        for ( size_t i = 0; i < n; ++i ) {
+            const value_t* v = col.at( first + i );
+            hashes[ i ] = hash_combine( hashes[ i ],
+                v ? hash_of<T>( value_ops<T>::get( v ) ) : null_hash );
+        }
+    } );
+}
+
+value_eq_t value_eq( const type_t& ty )
+{
+    return visit_type( ty, [&]<typename T>( type_t_traits<T> ) -> value_eq_t {
+        return &typed_value_eq<T>;
+    } );
+}
+
+value_cmp_t value_cmp( const type_t& ty )
+{
+    return visit_type( ty, [&]<typename T>( type_t_traits<T> ) -> value_cmp_t {
+        return &typed_value_cmp<T>;
+    } );
+}
+
+
+relation natural_join(
+     const relation&            a
+    ,const relation&            b
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    const rel_ty_t key      = rel_ty_t::intersect( a.m_ty, b.m_ty );
+
+    // build on the smaller input
+    const bool build_a      = a.size() <= b.size();
+    const relation& build   = build_a ? a : b;
+    const relation& probe   = build_a ? b : a;
+
+    std::vector<size_t> build_cols, probe_cols;
+    std::vector<value_eq_t> eqs;
+    for ( size_t k = 0; k < key.m_ids.size(); ++k ) {
+        build_cols.push_back( *build.m_ty.index_of( key.m_ids[ k ] ) );
+        probe_cols.push_back( *probe.m_ty.index_of( key.m_ids[ k ] ) );
+        eqs.push_back( value_eq( key.m_tys[ k ].second ) );
+    }
+    const auto keys_equal = [&]( size_t br, size_t pr ) {
+        for ( size_t k = 0; k < eqs.size(); ++k ) {
+            if ( !eqs[ k ]( build.at( br, build_cols[ k ] ), probe.at( pr, probe_cols[ k ] ) ) ) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    const join_hash_table table( build, build_cols );
+
+    row_map_t build_rows, probe_rows;
+    std::vector<std::uint64_t> hashes( join_batch_rows );
+    const size_t n_probe = probe.size();
+    for ( size_t first = 0; first < n_probe; first += join_batch_rows ) {
+        const size_t n = std::min( join_batch_rows, n_probe - first );
+        std::fill_n( hashes.begin(), n, 0 );
+        for ( const size_t c : probe_cols ) {
+            hash_column( *probe.m_cols[ c ], probe.m_ty.m_tys[ c ].second,
+                first, n, hashes.data() );
+        }
+        for ( size_t i = 0; i < n; ++i ) {
+            table.for_each_candidate( hashes[ i ], [&]( size_t br ) {
+                if ( keys_equal( br, first + i ) ) {
+                    build_rows.push_back( br );
+                    probe_rows.push_back( first + i );
+                }
+            } );
+        }
+    }
+
+    return build_a ? join_output( a, build_rows, b, probe_rows, rsrc )
+        : join_output( a, probe_rows, b, build_rows, rsrc );
+}
+
+relation merge_join(
+     const table_view&          a
+    ,const table_view&          b
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    const relation& a_rel = view_relation( a );
+    const relation& b_rel = view_relation( b );
+    const rel_ty_t key = rel_ty_t::intersect( a_rel.m_ty, b_rel.m_ty );
+
+    // views on the common attributes, in the same order
+    bool same = a.type().size() == key.m_tys.size() && b.type().size() == key.m_tys.size();
+    for ( size_t k = 0; same && k < a.type().size(); ++k ) {
+        same = a.type()[ k ].first == b.type()[ k ].first
+            && key.index_of( a.type()[ k ].first );
+    }
+    if ( !same ) {
+        throw_with< std::invalid_argument >(
+            std::ostringstream()
+            << "merge_join views must be on the common attributes "
+            << col_tys_to_string( key.m_tys ) << " in the same order, not "
+            << col_tys_to_string( a.type() ) << " and "
+            << col_tys_to_string( b.type() )
+        );
+    }
+    return merge_join_inputs(
+         merge_input { a_rel, a.row_map().data(), a.col_map() }
+        ,merge_input { b_rel, b.row_map().data(), b.col_map() }
+        ,rsrc
+    );
+}
+
+relation merge_join(
+     const relation&            a
+    ,const relation&            b
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    const rel_ty_t key = rel_ty_t::intersect( a.m_ty, b.m_ty );
+    merge_input a_in { a, nullptr, {} };
+    merge_input b_in { b, nullptr, {} };
+    for ( const attr_id_t id : key.m_ids ) {
+        a_in.cols.push_back( *a.m_ty.index_of( id ) );
+        b_in.cols.push_back( *b.m_ty.index_of( id ) );
+    }
+
+    // check the sort order
+    std::vector<value_cmp_t> cmps;
+    for ( const size_t c : a_in.cols ) {
+        cmps.push_back( value_cmp( a.m_ty.m_tys[ c ].second ) );
+    }
+    for ( const merge_input* in : { &a_in, &b_in } ) {
+        for ( size_t r = 1; r < in->rel.size(); ++r ) {
+            for ( size_t k = 0; k < in->cols.size(); ++k ) {
+                const size_t c = in->cols[ k ];
+                const auto o = cmps[ k ]( in->rel.at( r - 1, c ), in->rel.at( r, c ) );
+                if ( o == std::strong_ordering::less ) {
+                    break;
+                }
+                if ( o == std::strong_ordering::greater ) {
+                    throw_with< std::invalid_argument >(
+                        std::ostringstream()
+                        << "merge_join input not sorted on "
+                        << col_tys_to_string( key.m_tys ) << " at row " << r
+                    );
+                }
+            }
+        }
+    }
+    return merge_join_inputs( a_in, b_in, rsrc );
+}
+
+// NOLINTEND(readability-identifier-length)
+
+row_map_t select_rows(
+     const relation&    rel
+    ,const predicate&   pred
+)
+{
+    const block_predicate_ptr p = compile_predicate( rel, pred );
+    row_map_t rows;
+    std::array<std::uint8_t, filter_block_rows> mask {};
+    const size_t n_rows = rel.size();
+    for ( size_t first = 0; first < n_rows; first += filter_block_rows ) {
+        const size_t n = std::min( filter_block_rows, n_rows - first );
+        p->eval( first, n, mask.data() );
+        // branch free selection vector, of the rows that are True
+        size_t k = rows.size();
+        rows.resize( k + n );
+        for ( size_t i = 0; i < n; ++i ) {
+            rows[ k ] = first + i;
+            k += size_t( mask[ i ] >> 1U );
+        }
+        rows.resize( k );
+    }
+    return rows;
+}
+
+relation filter(
+     const relation&            rel
+    ,const predicate&           pred
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    // a subset of the rows, so keys still hold
+    relation out = gather_rows( rel, select_rows( rel, pred ), rsrc );
+    out.m_keys = rel.m_keys;
+    return out;
+}
+
+bool keeps_key(
+     const relation&                    rel
+    ,const std::vector<std::string>&    names
+)
+{
+    return std::any_of( rel.m_keys.cbegin(), rel.m_keys.cend(), [&]( const col_tys_t& key ) {
+        return std::all_of( key.cbegin(), key.cend(), [&]( const auto& col_ty ) {
+            return std::find( names.cbegin(), names.cend(), col_ty.first ) != names.cend();
+        } );
+    } );
+}
+
+relation project(
+     const relation&                    rel
+    ,const std::vector<std::string>&    names
+    ,std::pmr::memory_resource*         rsrc
+)
+{
+    if ( names.empty() ) {
+        throw std::invalid_argument( "Projection on no attributes" );
+    }
+    // checks the names
+    relation cols = rel.select_columns( names );
+    if ( keeps_key( rel, names ) ) {
+        return cols;
+    }
+
+    const size_t n = cols.size();
+    const size_t n_cols = cols.m_cols.size();
+    std::vector<std::uint64_t> hashes( n, 0 );
+    std::vector<value_eq_t> eqs;
+    for ( size_t c = 0; c < n_cols; ++c ) {
+        const type_t& ty = cols.m_ty.m_tys[ c ].second;
+        hash_column( *cols.m_cols[ c ], ty, 0, n, hashes.data() );
+        eqs.push_back( value_eq( ty ) );
+    }
+    const auto rows_equal = [&]( size_t x, size_t y ) {
+        for ( size_t c = 0; c < n_cols; ++c ) {
+            if ( !eqs[ c ]( cols.at( x, c ), cols.at( y, c ) ) ) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // chained table of the distinct rows so far, entries are row + 1
+    const size_t n_buckets = std::bit_ceil( std::max( n * 2, size_t( 16 ) ) );
+    const size_t mask = n_buckets - 1;
+    std::vector<size_t> buckets( n_buckets, 0 );
+    std::vector<size_t> next( n, 0 );
+    row_map_t rows;
+    for ( size_t r = 0; r < n; ++r ) {
+        size_t& head = buckets[ hashes[ r ] & mask ];
+        bool seen = false;
+        for ( size_t e = head; e != 0 && !seen; e = next[ e - 1 ] ) {
+            seen = hashes[ e - 1 ] == hashes[ r ] && rows_equal( e - 1, r );
+        }
+        if ( !seen ) {
+            next[ r ] = head;
+            head = r + 1;
+            rows.push_back( r );
+        }
+    }
+
+    if ( rows.size() == n ) {
+        cols.m_keys.assign( 1, cols.m_ty.m_tys );
+        return cols;
+    }
+    relation out = gather_rows( cols, rows, rsrc );
+    out.m_keys.assign( 1, out.m_ty.m_tys );
+    return out;
+}
+
+product_view::product_view(
+     std::shared_ptr<const relation>    a
+    ,std::shared_ptr<const relation>    b
+)
+    : m_a( std::move( a ) ), m_b( std::move( b ) )
+    , m_ty( product_type( m_a.get(), m_b.get() ) )
+{
+    for ( const attr_id_t id : m_ty.m_ids ) {
+        const auto in_a = m_a->m_ty.index_of( id );
+        const size_t c = in_a ? *in_a : *m_b->m_ty.index_of( id );
+        m_src.emplace_back( in_a.has_value(), c );
+        m_ops.push_back( in_a ? m_a->m_ops[ c ] : m_b->m_ops[ c ] );
+    }
+    for ( const auto& ka : m_a->m_keys ) {
+        for ( const auto& kb : m_b->m_keys ) {
+            col_tys_t key;
+            std::merge( ka.cbegin(), ka.cend(), kb.cbegin(), kb.cend(),
+                std::back_inserter( key ) );
+            m_keys.push_back( std::move( key ) );
+        }
+    }
+}
+
+const col_tys_t& product_view::type() const noexcept
+{
+    return m_ty.m_tys;
+}
+
+size_t product_view::size() const noexcept
+{
+    return m_a->size() * m_b->size();
+}
+
+const value_t* product_view::at( size_t row, size_t col ) const
+{
+    if ( row >= size() ) {
+        throw std::out_of_range( "product_view::at" );
+    }
+    const auto& [ in_a, c ] = m_src.at( col );
+    const size_t m = m_b->size();
+    return in_a ? m_a->at( row / m, c ) : m_b->at( row % m, c );
+}
+
+const std::vector<IValue*>& product_view::value_ops() const noexcept
+{
+    return m_ops;
+}
+
+const std::vector<col_tys_t>& product_view::keys() const noexcept
+{
+    return m_keys;
+}
+
+#ifdef _MSC_VER
+    #pragma warning(push)
+    #pragma warning(disable:4100)
+#else
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wunused-parameter"
+#endif
+
+row_slice_t product_view::rowSlice( size_t start, size_t end ) const
+{
+    throw not_implemented();
+}
+
+// NOLINTBEGIN(bugprone-easily-swappable-parameters)
+col_slice_t product_view::colSlice( size_t col, size_t start, size_t end ) const
+{
+    throw not_implemented();
+}
+// NOLINTEND(bugprone-easily-swappable-parameters)
+
+#ifdef _MSC_VER
+    #pragma warning(pop)
+#else
+    #pragma GCC diagnostic pop
+#endif
+
+relation product_view::materialize( std::pmr::memory_resource* rsrc ) const
+{
+    row_map_t a_rows, b_rows;
+    product_rows( all_rows( m_a->size() ), all_rows( m_b->size() ), a_rows, b_rows );
+    relation out = join_output( *m_a, a_rows, *m_b, b_rows, rsrc );
+    out.m_keys = m_keys;
+    return out;
+}
+
+product_view product(
+     std::shared_ptr<const relation>    a
+    ,std::shared_ptr<const relation>    b
+)
+{
+    return product_view( std::move( a ), std::move( b ) );
+}
+
+relation filter(
+     const product_view&        prod
+    ,const predicate&           pred
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    const relation& a = prod.left();
+    const relation& b = prod.right();
+    std::vector<predicate> all, on_a, on_b, rest;
+    conjuncts( pred, all );
+    for ( auto& p : all ) {
+        if ( refers_only_to( p, a.m_ty ) ) {
+            on_a.push_back( std::move( p ) );
+        } else if ( refers_only_to( p, b.m_ty ) ) {
+            on_b.push_back( std::move( p ) );
+        } else {
+            rest.push_back( std::move( p ) );
+        }
+    }
+    const row_map_t a_sel = on_a.empty() ? all_rows( a.size() )
+        : select_rows( a, and_( std::move( on_a ) ) );
+    const row_map_t b_sel = on_b.empty() ? all_rows( b.size() )
+        : select_rows( b, and_( std::move( on_b ) ) );
+
+    row_map_t a_rows, b_rows;
+    product_rows( a_sel, b_sel, a_rows, b_rows );
+    relation out = join_output( a, a_rows, b, b_rows, rsrc );
+    out.m_keys = prod.keys();
+    if ( rest.empty() ) {
+        return out;
+    }
+    // conjuncts over both inputs, on the restricted product
+    return filter( out, and_( std::move( rest ) ), rsrc );
+}
+
+relation union_(
+     const relation&            a
+    ,const relation&            b
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    require_same_type( a, b );
+    if ( b.size() == 0 ) {
+        return distinct( a, rsrc );
+    }
+    if ( a.size() == 0 ) {
+        return distinct( b, rsrc );
+    }
+    set_inputs inputs( a, b );
+    const size_t na = a.size();
+    const size_t nb = b.size();
+    const bool a_keyed = !a.m_keys.empty();
+    const bool b_keyed = !b.m_keys.empty();
+    row_map_t a_rows, b_rows;
+    if ( a_keyed && b_keyed && nb < na ) {
+        // table over b, removing rows found in a
+        row_hash_set table( inputs, nb );
+        for ( size_t r = 0; r < nb; ++r ) {
+            table.insert( 1, r, true );
+        }
+        std::vector<std::uint8_t> found( nb, 0 );
+        for ( size_t r = 0; r < na; ++r ) {
+            if ( const auto e = table.find( 0, r ) ) {
+                found[ e->second ] = 1;
+            }
+        }
+        a_rows = all_rows( na );
+        for ( size_t r = 0; r < nb; ++r ) {
+            if ( found[ r ] == 0 ) {
+                b_rows.push_back( r );
+            }
+        }
+    } else {
+        row_hash_set table( inputs, na + nb );
+        for ( size_t r = 0; r < na; ++r ) {
+            if ( table.insert( 0, r, a_keyed ) ) {
+                a_rows.push_back( r );
+            }
+        }
+        for ( size_t r = 0; r < nb; ++r ) {
+            if ( table.insert( 1, r ) ) {
+                b_rows.push_back( r );
+            }
+        }
+    }
+
+    relation_builder_resources res;
+    for ( size_t c = 0; c < a.m_cols.size(); ++c ) {
+        const type_t& ty = a.m_ty.m_tys[ c ].second;
+        relation::resource_ptr_t r = std::make_shared<column_resource>( rsrc );
+        const std::array parts {
+             gather_part { *a.m_cols[ c ], a_rows }
+            ,gather_part { *b.m_cols[ c ], b_rows }
+        };
+        auto s = gather_parts( ty, parts, r.get() );
+        res.m_col_tys.push_back( a.m_ty.m_tys[ c ] );
+        res.m_ops.push_back( default_ops( ty, s->nullable() ) );
+        res.m_resources.push_back( r );
+        res.m_cols.push_back( s );
+    }
+    relation out( std::move( res ) );
+    out.m_keys.assign( 1, out.m_ty.m_tys );
+    return out;
+}
+
+relation minus(
+     const relation&            a
+    ,const relation&            b
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    if ( b.size() == 0 ) {
+        require_same_type( a, b );
+        return distinct( a, rsrc );
+    }
+    return semi_join( a, b, false, rsrc );
+}
+
+relation intersect(
+     const relation&            a
+    ,const relation&            b
+    ,std::pmr::memory_resource* rsrc
+)
+{
+    if ( a.size() == 0 || b.size() == 0 ) {
+        require_same_type( a, b );
+        return gather_set_rows( a, {}, rsrc );
+    }
+    return semi_join( a, b, true, rsrc );
+}
+
+type_t aggregate_type( agg_op_t op, const type_t& col_ty )
+{
+    if ( op == Count ) {
+        return type_t { Int };
+    }
+    if ( col_ty.ty_con != Int && col_ty.ty_con != Float && col_ty.ty_con != Double ) {
+        throw_with< std::invalid_argument >(
+            std::ostringstream()
+            << "Can't aggregate column of type " << ty_to_string( col_ty )
+        );
+    }
+    switch ( op ) {
+        case Sum:   return type_t { Double };
+        case Min:
+        case Max:   return col_ty;
+        case Avg:   return type_t { Double };
+        case Count: break;
+    }
+    return type_t { Int };
+}
+
+relation summarize(
+     const relation&                    rel
+    ,const std::vector<std::string>&    by
+    ,const std::vector<aggregate>&      aggs
+    ,std::pmr::memory_resource*         rsrc
+)
+{
+    std::vector<size_t> by_cols;
+    for ( const auto& name : by ) {
+        by_cols.push_back( rel.col_index( name ) );
+    }
+    std::vector<agg_state_ptr> states;
+    for ( const auto& agg : aggs ) {
+        states.push_back( make_agg_state( rel, agg ) );
+    }
+
+    const size_t n_rows = rel.size();
+    group_table groups( rel, by_cols );
+    if ( by_cols.empty() ) {
+        // one group, of the whole relation
+        for ( auto& st : states ) {
+            st->resize( 1 );
+            st->update( 0, n_rows, nullptr );
+        }
+    } else {
+        std::array<size_t, summarize_batch_rows> gids {};
+        for ( size_t first = 0; first < n_rows; first += summarize_batch_rows ) {
+            const size_t n = std::min( summarize_batch_rows, n_rows - first );
+            groups.assign( first, n, gids.data() );
+            for ( auto& st : states ) {
+                st->resize( groups.size() );
+                st->update( first, n, gids.data() );
+            }
+        }
+        for ( auto& st : states ) {
+            st->resize( groups.size() );
+        }
+    }
+
+    relation_builder_resources res;
+    col_tys_t key;
+    for ( const size_t c : by_cols ) {
+        const type_t& ty = rel.m_ty.m_tys[ c ].second;
+        relation::resource_ptr_t r = std::make_shared<column_resource>( rsrc );
+        auto s = gather_column( *rel.m_cols[ c ], ty, groups.rows(), r.get() );
+        res.m_col_tys.push_back( rel.m_ty.m_tys[ c ] );
+        res.m_ops.push_back( default_ops( ty, s->nullable() ) );
+        res.m_resources.push_back( r );
+        res.m_cols.push_back( s );
+        key.push_back( rel.m_ty.m_tys[ c ] );
+    }
+    for ( size_t a = 0; a < aggs.size(); ++a ) {
+        const type_t ty = aggs[ a ].col.empty() ? type_t { Int }
+            : aggregate_type( aggs[ a ].op, rel.m_ty.m_tys[ rel.col_index( aggs[ a ].col ) ].second );
+        relation::resource_ptr_t r = std::make_shared<column_resource>( rsrc );
+        auto s = states[ a ]->result( r.get() );
+        res.m_col_tys.emplace_back( aggs[ a ].as, ty );
+        res.m_ops.push_back( default_ops( ty, s->nullable() ) );
+        res.m_resources.push_back( r );
+        res.m_cols.push_back( s );
+    }
+    relation out( std::move( res ) );
+    if ( !key.empty() ) {
+        std::sort( key.begin(), key.end() );
+        out.m_keys.push_back( std::move( key ) );
+    }
+    return out;
+}
+
+} // namespace rac
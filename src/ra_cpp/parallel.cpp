@@ -0,0 +1,181 @@
+#include <RA_cpp/parallel.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rac
+{
+
+namespace
+{
+
+// Fixed pool of hardware concurrency - 1 workers, started on first use
+struct worker_pool
+{
+    worker_pool()
+    {
+        const unsigned n = std::max( std::thread::hardware_concurrency(), 2U ) - 1;
+        m_workers.reserve( n );
+        for ( unsigned i = 0; i < n; ++i ) {
+            m_workers.emplace_back( [this] { run(); } );
+        }
+    }
+
+    ~worker_pool()
+    {
+        {
+            const std::lock_guard<std::mutex> lock( m_mutex );
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        for ( auto& w : m_workers ) {
+            w.join();
+        }
+    }
+
+    worker_pool( const worker_pool& ) = delete;
+    worker_pool& operator=( const worker_pool& ) = delete;
+
+    size_t size() const noexcept
+    {
+        return m_workers.size();
+    }
+
+    void submit( std::function<void()> task )
+    {
+        {
+            const std::lock_guard<std::mutex> lock( m_mutex );
+            m_tasks.push_back( std::move( task ) );
+        }
+        m_cv.notify_one();
+    }
+
+    static worker_pool& instance()
+    {
+        static worker_pool pool;
+        return pool;
+    }
+
+private:
+    void run()
+    {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock( m_mutex );
+                m_cv.wait( lock, [this] { return m_stop || !m_tasks.empty(); } );
+                if ( m_stop && m_tasks.empty() ) {
+                    return;
+                }
+                task = std::move( m_tasks.front() );
+                m_tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex                          m_mutex;
+    std::condition_variable             m_cv;
+    std::deque<std::function<void()>>   m_tasks;
+    std::vector<std::thread>            m_workers;
+    bool                                m_stop = false;
+};
+
+// State shared by the threads of one parallel_for, helpers may start
+// after the caller has returned so hold it by shared_ptr
+struct parallel_for_state
+{
+    parallel_for_state( size_t n_, const std::function<void( size_t )>& fn_ )
+        : n( n_ ), fn( fn_ )
+    {
+    }
+
+    // take items until there are none left
+    void work()
+    {
+        for ( size_t i = next++; i < n; i = next++ ) {
+            try {
+                fn( i );
+            } catch ( ... ) {
+                const std::lock_guard<std::mutex> lock( mutex );
+                if ( !error ) {
+                    error = std::current_exception();
+                }
+            }
+            if ( ++done == n ) {
+                const std::lock_guard<std::mutex> lock( mutex );
+                cv.notify_all();
+            }
+        }
+    }
+
+    const size_t                            n;
+    const std::function<void( size_t )>&    fn;     // valid until done == n
+    std::atomic<size_t>                     next { 0 };
+    std::atomic<size_t>                     done { 0 };
+    std::mutex                              mutex;
+    std::condition_variable                 cv;
+    std::exception_ptr                      error;
+};
+
+std::mutex  policy_mutex;
+bulk_policy policy;
+
+}
+
+bulk_policy get_bulk_policy() noexcept
+{
+    const std::lock_guard<std::mutex> lock( policy_mutex );
+    return policy;
+}
+
+void set_bulk_policy( const bulk_policy& p ) noexcept
+{
+    const std::lock_guard<std::mutex> lock( policy_mutex );
+    policy = p;
+}
+
+void parallel_for(
+     size_t                                 n
+    ,const std::function<void( size_t )>&   fn
+    ,unsigned                               max_threads
+)
+{
+    if ( n == 0 ) {
+        return;
+    }
+    worker_pool& pool = worker_pool::instance();
+    size_t helpers = std::min( n - 1, pool.size() );
+    if ( max_threads > 0 ) {
+        helpers = std::min( helpers, size_t( max_threads - 1 ) );
+    }
+    if ( helpers == 0 ) {
+        for ( size_t i = 0; i < n; ++i ) {
+            fn( i );
+        }
+        return;
+    }
+
+    auto state = std::make_shared<parallel_for_state>( n, fn );
+    for ( size_t h = 0; h < helpers; ++h ) {
+        // items already taken by the time a helper starts are skipped,
+        // so fn is never called after we return
+        pool.submit( [state] { state->work(); } );
+    }
+    state->work();
+    {
+        std::unique_lock<std::mutex> lock( state->mutex );
+        state->cv.wait( lock, [&] { return state->done == n; } );
+    }
+    if ( state->error ) {
+        std::rethrow_exception( state->error );
+    }
+}
+
+} // namespace rac
@@ -38,7 +38,7 @@ const std::vector<col_tys_t>& relation::keys() const noexcept
 
 const value_t* relation::at( size_t row, size_t col ) const
 {
-    return m_cols[ col ]->at( row );
+    return std::as_const( *m_cols[ col ] ).at( row );
 }
 
 #ifdef _MSC_VER
@@ -104,16 +104,138 @@ relation::relation(
     // re-arrange columns & take ownership
     for (size_t i = 0; i < n; ++i)
     {
-        auto it = std::find(
-            m_ty.m_tys.cbegin(), m_ty.m_tys.cend(), res.m_col_tys[i] );
-        if( it != m_ty.m_tys.end() )
+        const auto pos = m_ty.index_of( res.m_col_tys[i].first );
+        if( pos )
         {
-            const size_t j = size_t(it - m_ty.m_tys.cbegin());
+            const size_t j = *pos;
             std::swap( m_ops[j],        res.m_ops[i]);
             std::swap( m_resources[j],  res.m_resources[i]);
             std::swap( m_cols[j],       res.m_cols[i]);
         }
     }
+    m_stats = std::make_shared<stats_cache>( n );
+}
+
+const column_stats& relation::stats( size_t col ) const
+{
+    return m_stats->get( col, [&]() {
+        return compute_column_stats( *m_cols.at( col ), *m_ops[ col ] );
+    } );
+}
+
+const column_stats& relation::stats( std::string_view name ) const
+{
+    return stats( col_index( name ) );
+}
+
+size_t relation::col_index( std::string_view name ) const
+{
+    const auto pos = m_ty.index_of( name );
+    if ( !pos ) {
+        throw_with<std::invalid_argument>(
+            std::ostringstream()
+            << "Unknown column '" << name << "'"
+        );
+    }
+    return *pos;
+}
+
+relation relation::select_columns( const std::vector<std::string>& names ) const
+{
+    relation_builder_resources res;
+    for ( const auto& name : names ) {
+        const size_t c = col_index( name );
+        if ( std::count( names.cbegin(), names.cend(), name ) > 1 ) {
+            throw_with<std::invalid_argument>(
+                std::ostringstream()
+                << "Duplicate column '" << name << "'"
+            );
+        }
+        res.m_col_tys.push_back( m_ty.m_tys[ c ] );
+        res.m_ops.push_back( m_ops[ c ] );
+        res.m_resources.push_back( m_resources[ c ] );
+        res.m_cols.push_back( m_cols[ c ] );
+    }
+    relation rel( std::move( res ) );
+
+    // keys that survive
+    for ( const auto& key : m_keys ) {
+        const bool kept = std::all_of( key.cbegin(), key.cend(),
+            [&]( const auto& col_ty ) {
+                return std::find( names.cbegin(), names.cend(), col_ty.first )
+                    != names.cend();
+            } );
+        if ( kept ) {
+            rel.m_keys.push_back( key );
+        }
+    }
+    return rel;
+}
+
+relation relation::rename( std::string_view from, std::string_view to ) const
+{
+    const size_t c = col_index( from );
+    if ( from != to && m_ty.index_of( to ) ) {
+        throw_with<std::invalid_argument>(
+            std::ostringstream()
+            << "Column '" << to << "' already exists"
+        );
+    }
+    relation_builder_resources res;
+    res.m_col_tys   = m_ty.m_tys;
+    res.m_ops       = m_ops;
+    res.m_resources = m_resources;
+    res.m_cols      = m_cols;
+    res.m_col_tys[ c ].first = to;
+    relation rel( std::move( res ) );
+    for ( auto key : m_keys ) {
+        for ( auto& col_ty : key ) {
+            if ( col_ty.first == from ) {
+                col_ty.first = to;
+            }
+        }
+        rel.m_keys.push_back( key );
+    }
+    return rel;
+}
+
+IStorage& relation::mutable_column( size_t col )
+{
+    auto& storage = m_cols.at( col );
+    if ( storage.use_count() > 1 ) {
+        // the copy takes memory from where the shared one did
+        const auto* cr = dynamic_cast<const column_resource*>( m_resources[ col ].get() );
+        resource_ptr_t r = std::make_shared<column_resource>(
+            cr ? cr->upstream()
+            : m_resources[ col ] ? m_resources[ col ].get()
+            : std::pmr::get_default_resource() );
+        auto s = storage->clone( r.get() );
+        // release the old storage before its resource
+        storage             = s;
+        m_resources[ col ]  = r;
+        if ( s->ops() ) {
+            m_ops[ col ] = s->ops();
+        }
+    }
+    // cached statistics may be shared with copies
+    m_stats = std::make_shared<stats_cache>( m_cols.size() );
+    return *storage;
+}
+
+memory_usage_t relation::memory_usage() const
+{
+    memory_usage_t usage;
+    usage.columns.reserve( m_cols.size() );
+    for ( size_t col = 0; col < m_cols.size(); ++col ) {
+        column_memory_usage c { m_ty.m_tys[ col ].first, {}, {} };
+        const auto* r = dynamic_cast<const column_resource*>( m_resources[ col ].get() );
+        if ( r ) {
+            c.requested = r->requested();
+            c.reserved  = r->reserved();
+        }
+        usage.columns.push_back( std::move( c ) );
+    }
+    return usage;
 }
  
  std::ostream& relation::dump( std::ostream& os ) const
@@ -142,7 +264,7 @@ const col_tys_t& table_view::type() const noexcept
 
 size_t table_view::size() const noexcept
 {
-    return m_col_tys.size();
+    return m_row_map.size();
 }
 
 const value_t* table_view::at( size_t row, size_t col ) const
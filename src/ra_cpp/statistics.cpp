@@ -0,0 +1,134 @@
+#include <RA_cpp/statistics.h>
+
+#include <cmath>
+#include <functional>
+
+namespace rac
+{
+
+// NOLINTBEGIN(readability-identifier-length)
+
+double hyperloglog::estimate() const noexcept
+{
+    const auto m = double( m_registers.size() );
+    double sum = 0;
+    size_t zeros = 0;
+    for ( const auto r : m_registers ) {
+        sum += std::ldexp( 1.0, -int( r ) );
+        zeros += r == 0 ? 1U : 0U;
+    }
+    const double alpha = 0.7213 / ( 1.0 + 1.079 / m );
+    const double e = alpha * m * m / sum;
+    // small range correction, linear counting
+    if ( e <= 2.5 * m && zeros > 0 ) {
+        return m * std::log( m / double( zeros ) );
+    }
+    return e;
+}
+
+std::uint64_t hash_value( const type_t& ty, const value_t* v )
+{
+    if ( !v ) {
+        return 0;
+    }
+    return visit_type( ty, [&]<typename T>( type_t_traits<T> ) {
+        return hash_of<T>( value_ops<T>::get( v ) );
+    } );
+}
+
+double column_stats::rows_le( const IValue& ops, const value_t* v ) const
+{
+    double rows = 0;
+    for ( const auto& b : histogram ) {
+        if ( ops.cmp( b.upper, v ) != std::strong_ordering::greater ) {
+            rows += double( b.rows );
+        } else {
+            // assume values are spread evenly over the bucket
+            rows += double( b.rows ) / 2;
+            break;
+        }
+    }
+    return rows;
+}
+
+column_stats compute_column_stats(
+     const IStorage&    col
+    ,const IValue&      ops
+    ,size_t             n_buckets
+)
+{
+    column_stats st;
+    const size_t n  = col.size();
+    const type_t ty = ops.type();
+    st.row_count    = n;
+
+    // single pass: nulls, min/max, distinct
+    hyperloglog hll;
+    for ( size_t i = 0; i < n; ++i ) {
+        const value_t* v = col.at( i );
+        if ( !v ) {
+            ++st.null_count;
+            continue;
+        }
+        if ( !st.min || ops.cmp( v, st.min ) == std::strong_ordering::less ) {
+            st.min = v;
+        }
+        if ( !st.max || ops.cmp( v, st.max ) == std::strong_ordering::greater ) {
+            st.max = v;
+        }
+        hll.add( hash_value( ty, v ) );
+    }
+    const size_t non_null = n - st.null_count;
+    st.distinct = std::min( hll.estimate(), double( non_null ) );
+
+    // equi-depth histogram over an evenly strided sample
+    if ( non_null == 0 || n_buckets == 0 ) {
+        return st;
+    }
+    const size_t stride = std::max( size_t( 1 ), n / histogram_sample_rows );
+    std::vector<const value_t*> sample;
+    sample.reserve( std::min( n, histogram_sample_rows + 1 ) );
+    for ( size_t i = 0; i < n; i += stride ) {
+        const value_t* v = col.at( i );
+        if ( v ) {
+            sample.push_back( v );
+        }
+    }
+    if ( sample.empty() ) {
+        return st;
+    }
+    std::sort( sample.begin(), sample.end(),
+        [&]( const value_t* a, const value_t* b ) {
+            return ops.cmp( a, b ) == std::strong_ordering::less;
+        } );
+
+    const double scale = double( non_null ) / double( sample.size() );
+    const size_t depth = std::max( size_t( 1 ),
+        ( sample.size() + n_buckets - 1 ) / n_buckets );
+    size_t start = 0;
+    while ( start < sample.size() ) {
+        size_t end = std::min( start + depth, sample.size() );
+        // keep equal values in one bucket
+        while ( end < sample.size()
+            && ops.cmp( sample[ end ], sample[ end - 1 ] ) == std::strong_ordering::equal ) {
+            ++end;
+        }
+        size_t distinct = 1;
+        for ( size_t i = start + 1; i < end; ++i ) {
+            if ( ops.cmp( sample[ i ], sample[ i - 1 ] ) != std::strong_ordering::equal ) {
+                ++distinct;
+            }
+        }
+        st.histogram.push_back( histogram_bucket {
+            sample[ end - 1 ],
+            size_t( std::llround( double( end - start ) * scale ) ),
+            distinct
+        } );
+        start = end;
+    }
+    return st;
+}
+
+// NOLINTEND(readability-identifier-length)
+
+} // namespace rac
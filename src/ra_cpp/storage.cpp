@@ -70,7 +70,7 @@ std::ostream& cols_to_stream(
                 }
                 ss.str("");
                 ss.width( static_cast<long>(col_sizes[ c ]) );
-                ops[ c ]->to_stream( cols[ c ]->at( r ), ss );
+                ops[ c ]->to_stream( std::as_const( *cols[ c ] ).at( r ), ss );
                 ss.width(0);
                 os << ss.str();
             }
@@ -80,7 +80,63 @@ std::ostream& cols_to_stream(
     return os;
 }
 
+std::vector< std::pair<size_t, size_t> > candidate_ranges(
+     const IStorage&    col
+    ,const IValue&      ops
+    ,const value_t*     lo
+    ,const value_t*     hi
+)
+{
+    std::vector< std::pair<size_t, size_t> > ranges;
+    const size_t n      = col.size();
+    const size_t rows   = col.zone_rows();
+    if ( rows == 0 ) {
+        if ( n > 0 ) {
+            ranges.emplace_back( 0, n );
+        }
+        return ranges;
+    }
+    for ( size_t start = 0, z = 0; start < n; start += rows, ++z ) {
+        const size_t end = std::min( start + rows, n );
+        const auto zn = col.zone( z );
+        if ( zn && ( zn->null_count == end - start
+                || ops.cmp( zn->max, lo ) == std::strong_ordering::less
+                || ops.cmp( zn->min, hi ) == std::strong_ordering::greater ) ) {
+            continue;
+        }
+        // merge adjacent blocks
+        if ( !ranges.empty() && ranges.back().second == start ) {
+            ranges.back().second = end;
+        } else {
+            ranges.emplace_back( start, end );
+        }
+    }
+    return ranges;
+}
 
+std::shared_ptr<IStorage> make_segmented_storage(
+     const type_t&              ty
+    ,std::pmr::memory_resource* rsrc
+    ,size_t                     segment_rows
+)
+{
+    switch ( ty.ty_con ) {
+        case Int: case Float: case Double:
+            return visit_type( ty,
+                [&]<typename T>( type_t_traits<T> ) -> std::shared_ptr<IStorage> {
+                    if constexpr ( std::is_arithmetic_v<T> && !std::is_same_v<T, bool> ) {
+                        return std::make_shared< untyped_segmented_column_storage<T> >(
+                            std::make_shared< segmented_column_storage<T> >(
+                                rsrc, segment_rows ) );
+                    } else {
+                        return nullptr;
+                    }
+                } );
+        case Void: case Bool: case String: case Date: case Time: case Object:
+            break;
+    }
+    return nullptr;
+}
 
 // NOLINTEND(readability-identifier-length)
 
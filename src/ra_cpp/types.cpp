@@ -1,5 +1,8 @@
 #include <RA_cpp/types.h>
 
+#include <limits>
+#include <mutex>
+
 
 namespace rac
 {
@@ -49,109 +52,286 @@ std::string col_tys_to_string( const col_tys_t& col_tys )
     return ss.str();
 }
 
+attr_id_t attribute_interner::intern( std::string_view name )
+{
+    {
+        const std::shared_lock lock( m_mutex );
+        auto it = m_ids.find( name );
+        if ( it != m_ids.cend() ) {
+            return it->second;
+        }
+    }
+    const std::unique_lock lock( m_mutex );
+    auto it = m_ids.find( name );
+    if ( it != m_ids.cend() ) {
+        return it->second;
+    }
+    const auto id = static_cast<attr_id_t>( m_names.size() );
+    m_names.emplace_back( name );
+    m_ids.emplace( m_names.back(), id );
+    return id;
+}
+
+std::optional<attr_id_t> attribute_interner::find( std::string_view name ) const
+{
+    const std::shared_lock lock( m_mutex );
+    auto it = m_ids.find( name );
+    if ( it == m_ids.cend() ) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::string_view attribute_interner::name( attr_id_t id ) const
+{
+    const std::shared_lock lock( m_mutex );
+    return m_names.at( id );
+}
+
+size_t attribute_interner::size() const
+{
+    const std::shared_lock lock( m_mutex );
+    return m_names.size();
+}
+
+attribute_interner& global_attributes()
+{
+    static attribute_interner interner;
+    return interner;
+}
+
+
 void rel_ty_t::construct()
 {
     // Normal/canonical form is just sorted
     std::sort( m_tys.begin(), m_tys.end() );
 
+    attribute_interner& attrs = global_attributes();
+    m_ids.clear();
+    m_ids.reserve( m_tys.size() );
+    for ( const auto& col_ty : m_tys ) {
+        m_ids.push_back( attrs.intern( col_ty.first ) );
+    }
+
     // Check for repeated column names
-    if ( m_tys.size() > 1 )
+    for ( size_t i = 1; i < m_ids.size(); ++i )
     {
-        for ( size_t i=0; i < m_tys.size() - 1; ++i )
-        {
-            if ( m_tys[ i ].first == m_tys[ i+1 ].first ) {
-                throw_with< std::invalid_argument >(
-                    std::ostringstream()
-                    << "Column name '" << m_tys[ i ].first << "' repeated"
-                );
-            }
+        if ( m_ids[ i - 1 ] == m_ids[ i ] ) {
+            throw_with< std::invalid_argument >(
+                std::ostringstream()
+                << "Column name '" << m_tys[ i ].first << "' repeated"
+            );
         }
     }
+
+    index();
 }
 
+void rel_ty_t::index()
+{
+    m_by_id.clear();
+    m_by_id.reserve( m_ids.size() );
+    for ( size_t i = 0; i < m_ids.size(); ++i ) {
+        m_by_id.emplace_back( m_ids[ i ], i );
+    }
+    std::sort( m_by_id.begin(), m_by_id.end() );
 
-rel_ty_t rel_ty_t::union_( const rel_ty_t& a, const rel_ty_t& b )
+    // FNV-1a over ( id, type ) pairs
+    size_t h = 0xcbf29ce484222325ULL;
+    for ( size_t i = 0; i < m_ids.size(); ++i ) {
+        h = ( h ^ m_ids[ i ] ) * 0x100000001b3ULL;
+        h = ( h ^ static_cast<size_t>( m_tys[ i ].second.ty_con ) ) * 0x100000001b3ULL;
+    }
+    m_hash = h;
+}
+
+
+std::optional<size_t> rel_ty_t::index_of( attr_id_t id ) const noexcept
 {
-    col_tys_t col_tys;
+    auto it = std::lower_bound( m_by_id.cbegin(), m_by_id.cend(), id,
+        []( const auto& e, attr_id_t x ) { return e.first < x; } );
+    if ( it == m_by_id.cend() || it->first != id ) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::optional<size_t> rel_ty_t::index_of( std::string_view name ) const
+{
+    const auto id = global_attributes().find( name );
+    if ( !id ) {
+        return std::nullopt;
+    }
+    return index_of( *id );
+}
 
-    auto a_it = a.m_tys.cbegin();
-    auto b_it = b.m_tys.cbegin();
 
-    while ( ( a_it != a.m_tys.cend() ) || ( b_it != b.m_tys.cend() ) )
-    {
-        if ( a_it == a.m_tys.cend() )
-        {
-            col_tys.push_back( *b_it );
+namespace
+{
+
+void check_types_match(
+     const rel_ty_t&    a
+    ,size_t             a_pos
+    ,const rel_ty_t&    b
+    ,size_t             b_pos
+)
+{
+    const auto& [ a_name, a_ty ] = a.m_tys[ a_pos ];
+    const type_t& b_ty = b.m_tys[ b_pos ].second;
+    if ( a_ty != b_ty ) {
+        throw_with< std::invalid_argument >(
+            std::ostringstream()
+            << "Types for column '" << a_name
+            << "' do not match: "
+            << ty_to_string( a_ty ) // FIXME: streaming for types
+            << " and " << ty_to_string( b_ty )
+        );
+    }
+}
+
+// for each column of a, the position of the same column in b, if any
+// Note: a merge of the id ordered indices, no names are compared
+std::vector<size_t> match_columns( const rel_ty_t& a, const rel_ty_t& b )
+{
+    constexpr size_t none = std::numeric_limits<size_t>::max();
+    std::vector<size_t> matches( a.m_tys.size(), none );
+    auto a_it = a.m_by_id.cbegin();
+    auto b_it = b.m_by_id.cbegin();
+    while ( a_it != a.m_by_id.cend() && b_it != b.m_by_id.cend() ) {
+        if ( a_it->first < b_it->first ) {
+            ++a_it;
+        } else if ( b_it->first < a_it->first ) {
             ++b_it;
-        } else if ( b_it == b.m_tys.cend() )
-        {
-            col_tys.push_back( *a_it );
+        } else {
+            check_types_match( a, a_it->second, b, b_it->second );
+            matches[ a_it->second ] = b_it->second;
             ++a_it;
-        } else
-        {
-            // FIXME: WTH cppcheck?
-            // cppcheck-suppress unassignedVariable
-            const auto& [ a_name, a_ty ] = *a_it;
-            // cppcheck-suppress unassignedVariable
-            const auto& [ b_name, b_ty ] = *b_it;
-
-            if ( a_name == b_name )
-            {
-                if ( a_ty == b_ty )
-                {
-                    col_tys.push_back( *a_it );
-                } else {
-                    throw_with< std::invalid_argument >(
-                        std::ostringstream()
-                        << "Types for column '" << a_name 
-                        << "' do not match: "
-                        << ty_to_string( a_ty ) // FIXME: streaming for types
-                        << " and " << ty_to_string( b_ty )
-                    );
-                }
-                ++a_it;
-                ++b_it;
-            } else {
-                if ( a_name < b_name ) {
-                    col_tys.push_back( *a_it );
-                    ++a_it;
-                } else {
-                    col_tys.push_back( *b_it );
-                    ++b_it;
-                }
-            }
+            ++b_it;
+        }
+    }
+    return matches;
+}
+
+}
+
+
+rel_ty_t rel_ty_t::union_( const rel_ty_t& a, const rel_ty_t& b )
+{
+    const std::vector<size_t> matches = match_columns( a, b );
+    std::vector<bool> in_a( b.m_tys.size(), false );
+    for ( const size_t m : matches ) {
+        if ( m < in_a.size() ) {
+            in_a[ m ] = true;
+        }
+    }
+
+    // merge by name, shared columns taken from a
+    col_tys_t col_tys;
+    std::vector<attr_id_t> ids;
+    col_tys.reserve( a.m_tys.size() + b.m_tys.size() );
+    ids.reserve( a.m_tys.size() + b.m_tys.size() );
+    const auto take_b = [&]( size_t j ) {
+        if ( !in_a[ j ] ) {
+            col_tys.push_back( b.m_tys[ j ] );
+            ids.push_back( b.m_ids[ j ] );
+        }
+    };
+    size_t j = 0;
+    for ( size_t i = 0; i < a.m_tys.size(); ++i ) {
+        for ( ; j < b.m_tys.size()
+                && ( in_a[ j ] || b.m_tys[ j ].first < a.m_tys[ i ].first ); ++j ) {
+            take_b( j );
         }
+        col_tys.push_back( a.m_tys[ i ] );
+        ids.push_back( a.m_ids[ i ] );
+    }
+    for ( ; j < b.m_tys.size(); ++j ) {
+        take_b( j );
     }
 
     // Note: col_tys is sorted by construction
-    return rel_ty_t( std::move( col_tys ) );
+    return rel_ty_t( std::move( col_tys ), std::move( ids ) );
+}
+
+
+rel_ty_t rel_ty_t::project_names(
+     const rel_ty_t&                a
+    ,std::vector<std::string_view>  names
+)
+{
+    // ids of the names, merged with the id ordered index
+    std::vector< std::pair< attr_id_t, std::string_view > > wanted;
+    wanted.reserve( names.size() );
+    for ( const auto& name : names ) {
+        const auto id = global_attributes().find( name );
+        if ( !id ) {
+            throw_with< std::invalid_argument >(
+                std::ostringstream()
+                << "Unknown column '" << name << "'"
+            );
+        }
+        wanted.emplace_back( *id, name );
+    }
+    std::sort( wanted.begin(), wanted.end() );
+    wanted.erase( std::unique( wanted.begin(), wanted.end() ), wanted.end() );
+
+    std::vector<size_t> pos;
+    pos.reserve( wanted.size() );
+    auto it = a.m_by_id.cbegin();
+    for ( const auto& [ id, name ] : wanted ) {
+        while ( it != a.m_by_id.cend() && it->first < id ) {
+            ++it;
+        }
+        if ( it == a.m_by_id.cend() || it->first != id ) {
+            throw_with< std::invalid_argument >(
+                std::ostringstream()
+                << "Unknown column '" << name << "'"
+            );
+        }
+        pos.push_back( it->second );
+    }
+    // back to canonical order
+    std::sort( pos.begin(), pos.end() );
+
+    col_tys_t res;
+    std::vector<attr_id_t> ids;
+    res.reserve( pos.size() );
+    ids.reserve( pos.size() );
+    for ( const size_t i : pos ) {
+        res.push_back( a.m_tys[ i ] );
+        ids.push_back( a.m_ids[ i ] );
+    }
+    return rel_ty_t( std::move( res ), std::move( ids ) );
+}
+
+
+rel_ty_t rel_ty_t::minus( const rel_ty_t& a, const rel_ty_t& b )
+{
+    const std::vector<size_t> matches = match_columns( a, b );
+    col_tys_t res;
+    std::vector<attr_id_t> ids;
+    for ( size_t i = 0; i < a.m_tys.size(); ++i ) {
+        if ( matches[ i ] >= b.m_tys.size() ) {
+            res.push_back( a.m_tys[ i ] );
+            ids.push_back( a.m_ids[ i ] );
+        }
+    }
+    return rel_ty_t( std::move( res ), std::move( ids ) );
 }
 
 
 rel_ty_t rel_ty_t::intersect( const rel_ty_t& a, const rel_ty_t& b )
 {
+    const std::vector<size_t> matches = match_columns( a, b );
     col_tys_t res;
-    std::map< cstring_t, type_t > b_names( b.m_tys.cbegin(), b.m_tys.cend() );
-
-    for ( const auto& a_col : a.m_tys ) {
-        auto b_it = b_names.find( std::get<0>( a_col ) );
-        if ( b_it != b_names.cend() )
-        {
-            if ( std::get<1>( a_col ) != std::get<1>( *b_it ) ) {
-                throw_with< std::invalid_argument >(
-                    std::ostringstream()
-                    << "Types for column '"
-                    << std::get<0>(a_col)
-                    << "' do not match: "
-                    << ty_to_string( std::get<1>( a_col ) )
-                    << " and "
-                    << ty_to_string( std::get<1>(*b_it) )
-                );
-            }
-            res.push_back( a_col );
+    std::vector<attr_id_t> ids;
+    for ( size_t i = 0; i < a.m_tys.size(); ++i ) {
+        if ( matches[ i ] < b.m_tys.size() ) {
+            res.push_back( a.m_tys[ i ] );
+            ids.push_back( a.m_ids[ i ] );
         }
     }
-    return rel_ty_t( std::move( res ) );
+    return rel_ty_t( std::move( res ), std::move( ids ) );
 }
 
 
@@ -7,12 +7,21 @@
 #include <memory_resource>
 #include <compare>
 #include <limits>
+#include <numeric>
+#include <atomic>
+#include <thread>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
 
 #include <catch2/catch_test_macros.hpp>
 
 #include <RA_cpp/sample_library.hpp>
 #include <RA_cpp/storage.h>
 #include <RA_cpp/relation.h>
+#include <RA_cpp/column_file.h>
+#include <RA_cpp/static_header.h>
+#include <RA_cpp/operators.h>
 
 using namespace rac;
 
@@ -287,6 +296,922 @@ TEST_CASE( "column_storage basics", "[column_storage] [untyped_column_storage]")
 
 }
 
+TEST_CASE( "column_storage<bool> basics", "[column_storage] [untyped_column_storage]") {
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    auto cs_ = std::make_shared< column_storage< bool > >( &rsrc );
+    auto& cs = *cs_;
+    untyped_column_storage< bool > ucs( cs_ );
+    auto* is = static_cast<IStorage*>( &ucs );
+    const auto* cis = static_cast<const IStorage*>( &ucs );
+
+    REQUIRE( cs.empty() );
+    REQUIRE( cis->cend() - cis->cbegin() == 0 );
+
+    // every third value set, across several words
+    const size_t n = 200;
+    std::vector<std::uint8_t> expected( n );
+    for ( size_t i = 0; i < n; ++i ) {
+        expected[ i ] = ( i % 3 == 0 ) ? 1 : 0;
+    }
+    for ( size_t i = 0; i < 5; ++i ) {
+        const bool v = expected[ i ] != 0;
+        is->push_back( reinterpret_cast<const value_t*>( &v ) );
+    }
+    {
+        std::array<bool, n - 5> vs{};
+        for ( size_t i = 5; i < n; ++i ) {
+            vs[ i - 5 ] = expected[ i ] != 0;
+        }
+        is->append( reinterpret_cast<const value_t*>( vs.data() ), vs.size() );
+    }
+
+    REQUIRE( cs.size() == n );
+    REQUIRE( cs.n_words() == 4 );
+    REQUIRE( cs.count() == 67 );
+    for ( size_t i = 0; i < n; ++i ) {
+        REQUIRE( cs[ i ] == ( expected[ i ] != 0 ) );
+        REQUIRE( *reinterpret_cast<const bool*>( cis->at( i ) ) == ( expected[ i ] != 0 ) );
+    }
+    CHECK_THROWS( cs.at( n ) );
+    CHECK_THROWS( is->at( 0 ) );
+
+    {
+        size_t i = 0;
+        size_t c = 0;
+        for ( auto it = cis->cbegin(); it != cis->cend(); ++it, ++i ) {
+            c += *reinterpret_cast<const bool*>( it.get() ) ? 1U : 0U;
+        }
+        REQUIRE( i == n );
+        REQUIRE( c == cs.count() );
+        REQUIRE( size_t( cis->cend() - cis->cbegin() ) == n );
+        REQUIRE( cis->cbegin() + n == cis->cend() );
+    }
+
+    // not_ must not set bits past the end
+    cs.not_();
+    REQUIRE( cs.count() == n - 67 );
+    cs.not_();
+    REQUIRE( cs.count() == 67 );
+
+    auto cs2_ = std::make_shared< column_storage< bool > >( &rsrc );
+    untyped_column_storage< bool > ucs2( cs2_ );
+    ucs2.resize( n );
+    REQUIRE( cs2_->count() == 0 );
+    const bool t = true;
+    ucs2.set( 1, reinterpret_cast<const value_t*>( &t ) );
+    ucs2.set( 2, reinterpret_cast<const value_t*>( &t ) );
+    REQUIRE( cs2_->count() == 2 );
+
+    cs2_->or_( cs );
+    REQUIRE( cs2_->count() == 69 );
+    cs2_->and_( cs );
+    REQUIRE( cs2_->count() == 67 );
+
+    cs2_->resize( 10 );
+    CHECK_THROWS( cs2_->and_( cs ) );
+    REQUIRE( cs2_->count() == 4 );
+    cs2_->resize( 64 );
+    REQUIRE( cs2_->count() == 4 );
+
+    // copy & move through iterators
+    ucs2.copy( cis->cbegin(), cis->cbegin() + 64, ucs2.begin() );
+    for ( size_t i = 0; i < 64; ++i ) {
+        REQUIRE( (*cs2_)[ i ] == cs[ i ] );
+    }
+    ucs2.move( ucs2.begin(), ucs2.begin() + 10, ucs2.begin() + 1 );
+    REQUIRE( (*cs2_)[ 0 ] );
+    REQUIRE( (*cs2_)[ 1 ] );
+    REQUIRE( !(*cs2_)[ 2 ] );
+    REQUIRE( (*cs2_)[ 4 ] );
+
+    // move from contiguous values, e.g. from elsewhere
+    {
+        std::array<bool, 3> src { true, false, true };
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        const value_iterator first( reinterpret_cast<value_t*>( src.data() ), sizeof( bool ) );
+        ucs2.move( first, first + 3, ucs2.begin() + 20 );
+        REQUIRE( (*cs2_)[ 20 ] );
+        REQUIRE( !(*cs2_)[ 21 ] );
+        REQUIRE( (*cs2_)[ 22 ] );
+    }
+
+    // appends grow geometrically
+    {
+        column_storage< bool > grow( &rsrc );
+        const std::array<bool, 64> word {};
+        size_t reallocs = 0;
+        for ( size_t i = 0; i < 1000; ++i ) {
+            const size_t cap = grow.capacity();
+            grow.append( word.data(), word.size() );
+            reallocs += grow.capacity() != cap ? 1U : 0U;
+        }
+        REQUIRE( grow.size() == 64000 );
+        REQUIRE( reallocs < 20 );
+    }
+
+    // used through relation_builder
+    relation_builder builder( &rsrc, col_desc<bool>( "A" ), col_desc<int>( "B" ) );
+    builder.push_back( true, 1 );
+    builder.push_back( false, 2 );
+    REQUIRE( builder.at( 0 ) == std::tuple { true, 1 } );
+    REQUIRE( builder.at( 1 ) == std::tuple { false, 2 } );
+    builder.dump( std::cout );
+}
+
+TEST_CASE( "column_storage<std::string_view> basics", "[column_storage] [untyped_column_storage]") {
+    using namespace std::string_view_literals;
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    auto cs_ = std::make_shared< column_storage< std::string_view > >( &rsrc );
+    auto& cs = *cs_;
+    untyped_column_storage< std::string_view > ucs( cs_ );
+    auto* is = static_cast<IStorage*>( &ucs );
+    const auto* cis = static_cast<const IStorage*>( &ucs );
+
+    REQUIRE( cs.empty() );
+
+    // values are passed in as records
+    const auto s0 = "hello"sv;
+    is->push_back( string_record_buffer( s0 ).data() );
+    const std::array vs { ""sv, "world"sv, "a somewhat longer string"sv };
+    string_record_buffer records;
+    records.assign( vs.data(), vs.size() );
+    is->append( records.data(), vs.size() );
+
+    REQUIRE( cs.size() == 4 );
+    REQUIRE( cs.at( 0 ) == "hello" );
+    REQUIRE( cs[ 1 ].empty() );
+    REQUIRE( cs[ 2 ] == "world" );
+    REQUIRE( cs[ 3 ] == "a somewhat longer string" );
+    CHECK_THROWS( cs.at( 4 ) );
+    REQUIRE( cs.heap_size() ==
+        4 * sizeof( string_record::length_t ) + 5 + 5 + 24 );
+
+    // a default view has null data, and lengths must fit a record
+    {
+        column_storage< std::string_view > other( &rsrc );
+        other.push_back( std::string_view() );
+        REQUIRE( other[ 0 ].empty() );
+        const std::string_view too_long( s0.data(),
+            size_t( std::numeric_limits<string_record::length_t>::max() ) + 1 );
+        CHECK_THROWS_AS( string_record::size( too_long ), std::length_error );
+        CHECK_THROWS_AS( other.push_back( too_long ), std::length_error );
+        REQUIRE( other.size() == 1 );
+    }
+
+    REQUIRE( value_ops<std::string_view>::get( cis->at( 2 ) ) == "world" );
+    REQUIRE( size_t( cis->cend() - cis->cbegin() ) == 4 );
+    {
+        std::string all;
+        for ( auto it = cis->cbegin(); it != cis->cend(); ++it ) {
+            all += value_ops<std::string_view>::get( it.get() );
+        }
+        REQUIRE( all == "helloworlda somewhat longer string" );
+    }
+
+    // set, including from a view into the column's own heap
+    cs.set( 1, "again" );
+    REQUIRE( cs[ 1 ] == "again" );
+    cs.set( 0, cs[ 3 ] );
+    REQUIRE( cs[ 0 ] == "a somewhat longer string" );
+    CHECK_THROWS( is->at( 0 ) );
+
+    is->resize( 6 );
+    REQUIRE( cs[ 5 ].empty() );
+    is->move( is->begin(), is->begin() + 3, is->begin() + 1 );
+    REQUIRE( cs[ 0 ] == "a somewhat longer string" );
+    REQUIRE( cs[ 1 ] == "a somewhat longer string" );
+    REQUIRE( cs[ 2 ] == "again" );
+    REQUIRE( cs[ 3 ] == "world" );
+
+    // bulk copies
+    basic_string_column_storage< std::uint32_t > cs32( &rsrc );
+    cs32.assign( cs );
+    REQUIRE( cs32.size() == cs.size() );
+    REQUIRE( cs32.heap_size() == cs.heap_size() );
+    cs32.append( cs );
+    REQUIRE( cs32.size() == 2 * cs.size() );
+    for ( size_t i = 0; i < cs.size(); ++i ) {
+        REQUIRE( cs32[ i ] == cs[ i ] );
+        REQUIRE( cs32[ cs.size() + i ] == cs[ i ] );
+    }
+
+    // values, ordering
+    const auto* ops = untyped_value_ops<std::string_view>::ops();
+    REQUIRE( ops->type() == tyString().ty() );
+    REQUIRE( ops->cmp( cis->at( 2 ), cis->at( 3 ) ) == std::strong_ordering::less );
+    REQUIRE( ops->cmp( cis->at( 0 ), cis->at( 1 ) ) == std::strong_ordering::equivalent );
+    {
+        std::ostringstream ss;
+        ops->to_stream( cis->at( 3 ), ss );
+        REQUIRE( ss.str() == "world" );
+    }
+
+    // values read are written as is, including records from our own heap
+    {
+        const size_t n = cs.size();
+        is->push_back( cis->at( 3 ) );
+        is->set( 1, cis->at( 0 ) );
+        REQUIRE( cs[ n ] == "world" );
+        REQUIRE( cs[ 1 ] == "a somewhat longer string" );
+
+        column_storage< std::string_view > other( &rsrc );
+        other.append_records( cs.record( 2 ), 1 );
+        other.append_records( cs.record( 2 ), 1 );
+        REQUIRE( other.size() == 2 );
+        REQUIRE( other[ 1 ] == "again" );
+        cs.append_records( cs.record( 0 ), 1 );
+        REQUIRE( cs[ n + 1 ] == "a somewhat longer string" );
+        is->resize( n );
+    }
+
+    // through relation_builder, relation and table_view
+    relation_builder builder(
+         &rsrc
+        ,col_desc<std::string_view>(    "Name" )
+        ,col_desc<int>(                 "Id" )
+    );
+    builder.push_back( "carol", 3 );
+    builder.append_rows( std::vector { std::tuple { "alice"sv, 1 }, std::tuple { "bob"sv, 2 } } );
+    REQUIRE( builder.at( 0 ) == std::tuple { "carol"sv, 3 } );
+    REQUIRE( builder.at( 2 ) == std::tuple { "bob"sv, 2 } );
+
+    auto rel = std::make_shared<relation>( builder.release() );
+    auto irel = static_pointer_cast<IRelation>( rel );
+    const table_view tbl( irel, std::vector { "Name", "Id" } );
+    relation_to_stream( std::cout, &tbl );
+    REQUIRE( value_ops<std::string_view>::get( tbl.at( 0, 0 ) ) == "alice" );
+    REQUIRE( value_ops<std::string_view>::get( tbl.at( 1, 0 ) ) == "bob" );
+    REQUIRE( value_ops<std::string_view>::get( tbl.at( 2, 0 ) ) == "carol" );
+    REQUIRE( value_ops<int>::get( tbl.at( 2, 1 ) ) == 3 );
+}
+
+TEST_CASE( "aligned column buffers", "[column_storage] [aligned_allocator]") {
+    std::pmr::unsynchronized_pool_resource rsrc;
+    const auto aligned = []( const void* p ) {
+        return reinterpret_cast<std::uintptr_t>( p ) % column_alignment == 0;
+    };
+
+    column_storage<double> doubles( &rsrc );
+    column_storage<int> ints( &rsrc );
+    column_storage<bool> bools( &rsrc );
+    column_storage<std::string_view> strs( &rsrc );
+    for ( int i = 0; i < 1000; ++i ) {
+        doubles.push_back( i );
+        ints.push_back( i );
+        bools.push_back( i % 3 == 0 );
+        strs.push_back( "x" );
+        REQUIRE( aligned( doubles.data() ) );
+        REQUIRE( aligned( ints.data() ) );
+        REQUIRE( aligned( bools.words() ) );
+        REQUIRE( aligned( strs.heap() ) );
+        REQUIRE( aligned( strs.offsets() ) );
+    }
+
+    segmented_column_storage<double> segs( &rsrc, 64 );
+    for ( int i = 0; i < 1000; ++i ) {
+        segs.push_back( i );
+    }
+    for ( size_t i = 0; i < segs.n_segments(); ++i ) {
+        REQUIRE( aligned( segs.segment( i ) ) );
+    }
+
+    // copies into another resource
+    std::pmr::monotonic_buffer_resource other;
+    const column_storage<int> copy( ints, &other );
+    REQUIRE( aligned( copy.data() ) );
+
+    REQUIRE( padded_bytes<int>( 0 ) == 0 );
+    REQUIRE( padded_bytes<int>( 1 ) == 64 );
+    REQUIRE( padded_bytes<double>( 8 ) == 64 );
+    REQUIRE( padded_bytes<double>( 9 ) == 128 );
+}
+
+TEST_CASE( "parallel bulk copy", "[column_storage] [bulk_policy]") {
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    // small thresholds so the parallel paths run
+    const bulk_policy saved = get_bulk_policy();
+    set_bulk_policy( bulk_policy { 1024, 256, 4 } );
+
+    const size_t n = 100000;
+    untyped_column_storage<int> from( std::make_shared< column_storage<int> >( &rsrc ) );
+    untyped_column_storage<int> to( std::make_shared< column_storage<int> >( &rsrc ) );
+    for ( size_t i = 0; i < n; ++i ) {
+        const int v = int( i );
+        from.push_back( reinterpret_cast<const value_t*>( &v ) );
+    }
+    to.resize( n );
+    to.copy( from.cbegin(), from.cend(), to.begin() );
+    for ( size_t i = 0; i < n; ++i ) {
+        REQUIRE( value_ops<int>::get( to.at( i ) ) == int( i ) );
+    }
+
+    // non-overlapping and overlapping moves
+    to.resize( 2 * n );
+    to.move( to.begin(), to.begin() + n, to.begin() + n );
+    REQUIRE( value_ops<int>::get( to.at( n + 12345 ) ) == 12345 );
+    to.move( to.begin() + 1, to.begin() + n, to.begin() );
+    REQUIRE( value_ops<int>::get( to.at( 0 ) ) == 1 );
+    REQUIRE( value_ops<int>::get( to.at( n - 2 ) ) == int( n - 1 ) );
+
+    std::vector<std::string> strs( 5000, "abcdefghijklmnopqrstuvwxyz" );
+    std::vector<std::string> strs_to( strs.size() );
+    bulk_copy( strs.data(), strs.data() + strs.size(), strs_to.data() );
+    REQUIRE( strs_to == strs );
+
+    std::atomic<size_t> sum = 0;
+    parallel_for( 1000, [&]( size_t i ) { sum += i; } );
+    REQUIRE( sum == 499500 );
+    CHECK_THROWS( parallel_for( 100, []( size_t i ) {
+        if ( i == 50 ) {
+            throw std::runtime_error( "fail" );
+        }
+    } ) );
+
+    set_bulk_policy( saved );
+}
+
+TEST_CASE( "segmented column storage", "[column_storage] [segmented_column_storage]") {
+    using namespace std::string_view_literals;
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    CHECK_THROWS( segmented_column_storage<int>( &rsrc, 100 ) );
+
+    auto ss = std::make_shared< segmented_column_storage<int> >( &rsrc, 8 );
+    std::vector<int> vs( 20 );
+    std::iota( vs.begin(), vs.end(), 0 );
+    ss->push_back( -1 );
+    const int* first = &( *ss )[ 0 ];
+    ss->append( vs.data(), vs.size() );
+    REQUIRE( ss->size() == 21 );
+    REQUIRE( ss->n_segments() == 3 );
+    REQUIRE( ss->capacity() == 24 );
+    // appends do not move existing rows
+    REQUIRE( &( *ss )[ 0 ] == first );
+    REQUIRE( ( *ss )[ 0 ] == -1 );
+    REQUIRE( ss->at( 8 ) == 7 );
+    REQUIRE( ss->at( 20 ) == 19 );
+    CHECK_THROWS_AS( ss->at( 21 ), std::out_of_range );
+
+    size_t rows = 0;
+    ss->for_each_segment( [&]( const int* seg, size_t start, size_t n ) {
+        REQUIRE( seg[ 0 ] == int( start ) - 1 );
+        rows += n;
+    } );
+    REQUIRE( rows == 21 );
+
+    ss->resize( 30 );
+    REQUIRE( ss->n_segments() == 4 );
+    REQUIRE( ( *ss )[ 29 ] == 0 );
+    ss->resize( 9 );
+    REQUIRE( ss->n_segments() == 2 );
+    REQUIRE( ss->at( 8 ) == 7 );
+
+    // untyped, iterating across segments
+    untyped_segmented_column_storage<int> us( ss );
+    int x = 42;
+    us.push_back( reinterpret_cast<const value_t*>( &x ) );
+    REQUIRE( us.size() == 10 );
+    int expected = -1;
+    for ( auto it = us.cbegin(); it != us.cend(); ++it, ++expected ) {
+        REQUIRE( value_ops<int>::get( it.get() ) == ( expected == 8 ? 42 : expected ) );
+    }
+    REQUIRE( us.cend() - us.cbegin() == 10 );
+    // overlapping move across a segment boundary
+    us.move( us.begin(), us.begin() + 5, us.begin() + 5 );
+    REQUIRE( ( *ss )[ 5 ] == -1 );
+    REQUIRE( ( *ss )[ 9 ] == 3 );
+
+    // copy out to a plain column
+    auto plain = value_ops<int>::make_storage( &rsrc );
+    plain->resize( us.size() );
+    plain->copy( us.cbegin(), us.cend(), plain->begin() );
+    REQUIRE( value_ops<int>::get( std::as_const( *plain ).at( 9 ) ) == 3 );
+
+    // through relation_builder
+    relation_builder builder(
+         &rsrc
+        ,col_desc<int>(                 "Id" )
+        ,col_desc<std::string_view>(    "Name" )
+    );
+    builder.segment_columns( 16 );
+    REQUIRE( dynamic_cast<const untyped_segmented_column_storage<int>*>(
+        builder.m_cols[ 0 ].get() ) );
+    builder.push_back( 1, "one" );
+    CHECK_THROWS_AS( builder.segment_columns( 16 ), std::logic_error );
+    for ( int i = 2; i <= 100; ++i ) {
+        builder.push_back( i, "many" );
+    }
+    REQUIRE( builder.at( 0 ) == std::tuple { 1, "one"sv } );
+    REQUIRE( builder.at( 99 ) == std::tuple { 100, "many"sv } );
+}
+
+
+TEST_CASE( "nullable columns", "[column_storage] [nullable_storage]") {
+    using namespace std::string_view_literals;
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    auto ns = value_ops< std::optional<int> >::make_storage( &rsrc );
+    REQUIRE( ns->nullable() );
+    for ( int i = 0; i < 150; ++i ) {
+        ns->push_back( i % 3 == 0 ? nullptr : reinterpret_cast<const value_t*>( &i ) );
+    }
+    REQUIRE( ns->size() == 150 );
+    REQUIRE( ns->null_count() == 50 );
+    REQUIRE( std::as_const( *ns ).at( 0 ) == nullptr );
+    REQUIRE( value_ops<int>::get( std::as_const( *ns ).at( 1 ) ) == 1 );
+    REQUIRE( value_ops< std::optional<int> >::get( std::as_const( *ns ).at( 3 ) )
+        == std::nullopt );
+
+    const auto& typed = dynamic_cast<const nullable_storage&>( *ns );
+    long sum = 0;
+    size_t n = 0;
+    typed.for_each_valid( [&]( size_t row ) {
+        sum += value_ops<int>::get( typed.values().at( row ) );
+        ++n;
+    } );
+    REQUIRE( n == 100 );
+    REQUIRE( sum == 150 * 149 / 2 - 3 * ( 50 * 49 / 2 ) );
+
+    int seven = 7;
+    ns->set( 0, reinterpret_cast<const value_t*>( &seven ) );
+    ns->set( 1, nullptr );
+    REQUIRE( value_ops<int>::get( std::as_const( *ns ).at( 0 ) ) == 7 );
+    REQUIRE( std::as_const( *ns ).at( 1 ) == nullptr );
+    ns->move( ns->begin(), ns->begin() + 4, ns->begin() + 2 );
+    REQUIRE( value_ops<int>::get( std::as_const( *ns ).at( 2 ) ) == 7 );
+    REQUIRE( std::as_const( *ns ).at( 3 ) == nullptr );
+    REQUIRE( value_ops<int>::get( std::as_const( *ns ).at( 4 ) ) == 2 );
+    ns->resize( 200 );
+    REQUIRE( ns->null_count() == 51 + 50 );
+
+    // null aware operations
+    const IValue* ops = untyped_value_ops< std::optional<int> >::ops();
+    REQUIRE( ops->type() == tyInt().ty() );
+    REQUIRE( ops->cmp( nullptr, nullptr ) == std::strong_ordering::equal );
+    REQUIRE( ops->cmp( nullptr, reinterpret_cast<const value_t*>( &seven ) )
+        == std::strong_ordering::less );
+    REQUIRE( ops->cmp( reinterpret_cast<const value_t*>( &seven ), nullptr )
+        == std::strong_ordering::greater );
+    std::ostringstream os;
+    ops->to_stream( nullptr, os );
+    REQUIRE( os.str() == "null" );
+
+    // through relation_builder
+    relation_builder builder(
+         &rsrc
+        ,col_desc< std::optional<std::string_view> >(   "Name" )
+        ,col_desc< std::optional<double> >(             "Amount" )
+        ,col_desc< int >(                               "Id" )
+    );
+    builder.push_back( "one"sv, std::nullopt, 1 );
+    builder.push_back( std::nullopt, 2.5, 2 );
+    const std::array< std::tuple<
+        std::optional<std::string_view>, std::optional<double>, int >, 2 > rows { {
+            { "three"sv, 3.5, 3 }, { std::nullopt, std::nullopt, 4 } } };
+    builder.append_rows( rows );
+    REQUIRE( builder.at( 0 ) == std::tuple {
+        std::optional { "one"sv }, std::optional<double>(), 1 } );
+    REQUIRE( builder.at( 1 ) == std::tuple {
+        std::optional<std::string_view>(), std::optional { 2.5 }, 2 } );
+    REQUIRE( builder.at( 3 ) == std::tuple {
+        std::optional<std::string_view>(), std::optional<double>(), 4 } );
+    builder.encode();
+    CHECK_THROWS( builder.encode( "Name", Dictionary ) );
+
+    auto rel = std::make_shared<relation>( builder.release() );
+    std::ostringstream dump;
+    rel->dump( dump );
+    REQUIRE( dump.str().find( "null" ) != std::string::npos );
+    auto irel = static_pointer_cast<IRelation>( rel );
+    const table_view tbl( irel, std::vector { "Name", "Id" } );
+    REQUIRE( tbl.at( 0, 0 ) == nullptr );
+    REQUIRE( value_ops<int>::get( tbl.at( 0, 1 ) ) == 2 );
+    REQUIRE( value_ops<int>::get( tbl.at( 1, 1 ) ) == 4 );
+    REQUIRE( value_ops<std::string_view>::get( tbl.at( 2, 0 ) ) == "one" );
+
+    // an optional last column
+    relation_builder last_builder(
+         &rsrc
+        ,col_desc< int >(                   "Id" )
+        ,col_desc< std::optional<int> >(    "Parent" )
+    );
+    last_builder.push_back( 1, std::nullopt );
+    last_builder.push_back( 2, std::optional( 1 ) );
+    REQUIRE( last_builder.at( 0 ) == std::tuple { 1, std::optional<int>() } );
+    REQUIRE( last_builder.at( 1 ) == std::tuple { 2, std::optional { 1 } } );
+    const relation last_rel( last_builder.release() );
+    REQUIRE( last_rel.at( 0, 1 ) == nullptr );
+    REQUIRE( value_ops<int>::get( last_rel.at( 1, 1 ) ) == 1 );
+}
+
+
+TEST_CASE( "zone maps", "[column_storage] [zone_t]") {
+    std::pmr::monotonic_buffer_resource rsrc;
+    typedef column_storage<int> col_t;
+    constexpr size_t rows = col_t::zone_rows;
+
+    auto cs = std::make_shared<col_t>( &rsrc );
+    std::vector<int> vs( 4 * rows + 10 );
+    std::iota( vs.begin(), vs.end(), 0 );   // clustered, e.g. ids
+    cs->append( vs.data(), 2 * rows );
+    for ( size_t i = 2 * rows; i < vs.size(); ++i ) {
+        cs->push_back( vs[ i ] );
+    }
+    REQUIRE( cs->n_zones() == 5 );
+    REQUIRE( cs->zone_valid( 4 ) );
+    REQUIRE( cs->zone_min( 1 ) == int( rows ) );
+    REQUIRE( cs->zone_max( 1 ) == int( 2 * rows - 1 ) );
+    REQUIRE( cs->zone_max( 4 ) == int( vs.size() - 1 ) );
+
+    // set widens, writes through references mark their zone dirty
+    cs->set( 5, -100 );
+    REQUIRE( cs->zone_min( 0 ) == -100 );
+    ( *cs )[ 2 * rows + 1 ] = 7;
+    REQUIRE( cs->zone_valid( 1 ) );
+    REQUIRE( !cs->zone_valid( 2 ) );
+    REQUIRE( cs->zone_valid( 4 ) );
+    cs->push_back( 1 );
+    REQUIRE( cs->zone_valid( 3 ) );
+    REQUIRE( !cs->zone_valid( 2 ) );
+    cs->refresh_zones();
+    REQUIRE( cs->zone_valid( 2 ) );
+    REQUIRE( cs->zone_max( 2 ) == int( 3 * rows - 1 ) );
+    REQUIRE( cs->zone_min( 4 ) == 1 );
+    cs->data();
+    REQUIRE( !cs->zone_valid( 0 ) );
+    cs->refresh_zones();
+    REQUIRE( cs->zone_valid( 4 ) );
+    REQUIRE( cs->zone_min( 2 ) == 7 );
+    cs->resize( rows + 1 );
+    REQUIRE( cs->n_zones() == 2 );
+    REQUIRE( cs->zone_max( 1 ) == int( rows ) );
+
+    // untyped, skipping blocks
+    cs->resize( 0 );
+    cs->append( vs.data(), vs.size() );
+    untyped_column_storage<int> us( cs );
+    const IValue& ops = *untyped_value_ops<int>::ops();
+    const int lo = int( rows ) + 5, hi = int( 2 * rows ) + 5;
+    auto ranges = candidate_ranges( us, ops,
+        reinterpret_cast<const value_t*>( &lo ), reinterpret_cast<const value_t*>( &hi ) );
+    REQUIRE( ranges.size() == 1 );
+    REQUIRE( ranges[ 0 ] == std::pair { rows, 3 * rows } );
+    REQUIRE( us.zone( 0 )->null_count == 0 );
+    REQUIRE( !us.zone( 5 ) );
+
+    // copy and move through IStorage keep zones up to date
+    const int big = 1 << 30;
+    us.copy( IStorage::const_iterator( reinterpret_cast<const value_t*>( &big ), sizeof( int ) )
+            ,IStorage::const_iterator( reinterpret_cast<const value_t*>( &big + 1 ), sizeof( int ) )
+            ,us.begin() + rows );
+    REQUIRE( us.zone( 0 ) );
+    REQUIRE( us.zone( 1 ) );
+    REQUIRE( cs->zone_max( 1 ) == big );
+    us.move( us.begin() + 2 * rows, us.begin() + 2 * rows + 1, us.begin() + 1 );
+    REQUIRE( us.zone( 0 ) );
+    REQUIRE( cs->zone_max( 0 ) == int( 2 * rows ) );
+    *reinterpret_cast<int*>( us.at( 3 * rows ) ) = -1;
+    REQUIRE( !us.zone( 3 ) );
+    us.refresh_zones();
+    REQUIRE( cs->zone_min( 3 ) == -1 );
+
+    // NaN orders first
+    column_storage<double> ds( &rsrc );
+    ds.push_back( 1.0 );
+    ds.push_back( std::nan( "" ) );
+    ds.push_back( 2.0 );
+    REQUIRE( std::isnan( ds.zone_min( 0 ) ) );
+    REQUIRE( ds.zone_max( 0 ) == 2.0 );
+
+    // nullable columns count nulls per zone
+    auto ns = value_ops< std::optional<int> >::make_storage( &rsrc );
+    for ( size_t i = 0; i < 2 * rows; ++i ) {
+        const int v = int( i );
+        ns->push_back( i < rows ? nullptr : reinterpret_cast<const value_t*>( &v ) );
+    }
+    REQUIRE( ns->zone_rows() == rows );
+    REQUIRE( ns->zone( 0 )->null_count == rows );
+    REQUIRE( ns->zone( 1 )->null_count == 0 );
+    const int zero = 0;
+    ranges = candidate_ranges( *ns, ops,
+        reinterpret_cast<const value_t*>( &zero ), reinterpret_cast<const value_t*>( &zero ) );
+    REQUIRE( ranges.empty() );
+
+    // no zone map, whole column
+    auto ss = value_ops<std::string_view>::make_storage( &rsrc );
+    ss->resize( 3 );
+    ranges = candidate_ranges( *ss, ops, nullptr, nullptr );
+    REQUIRE( ranges.size() == 1 );
+    REQUIRE( ranges[ 0 ].second == 3 );
+}
+
+
+TEST_CASE( "dictionary encoding", "[encoding] [dictionary_column_storage]") {
+    using namespace std::string_view_literals;
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    dictionary_column_storage< std::uint8_t > ds( &rsrc );
+    ds.push_back( "red" );
+    ds.push_back( "green" );
+    const std::array vs { "blue"sv, "red"sv, "red"sv, "green"sv };
+    ds.append( vs.data(), vs.size() );
+
+    REQUIRE( ds.size() == 6 );
+    REQUIRE( ds.dictionary().size() == 3 );
+    REQUIRE( ds[ 0 ] == "red" );
+    REQUIRE( ds.at( 1 ) == "green" );
+    REQUIRE( ds[ 2 ] == "blue" );
+    // codes follow sorted order
+    REQUIRE( ds.code( 2 ) == 0 );
+    REQUIRE( ds.code( 1 ) == 1 );
+    REQUIRE( ds.code( 0 ) == 2 );
+    REQUIRE( ds.find( "green" ) == std::optional<std::uint8_t>( 1 ) );
+    REQUIRE( !ds.find( "yellow" ) );
+    REQUIRE( ds.count_equal( "red" ) == 3 );
+    REQUIRE( ds.count_equal( "yellow" ) == 0 );
+    {
+        column_storage<bool> eq( &rsrc );
+        ds.equal( "red", eq );
+        REQUIRE( eq.size() == ds.size() );
+        REQUIRE( eq.count() == 3 );
+        REQUIRE( eq[ 0 ] );
+        REQUIRE( !eq[ 1 ] );
+    }
+    ds.set( 0, "amber" );
+    REQUIRE( ds[ 0 ] == "amber" );
+    REQUIRE( ds[ 2 ] == "blue" );
+    REQUIRE( ds.code( 0 ) == 0 );
+    REQUIRE( ds.code( 2 ) == 1 );
+
+    // full dictionary
+    dictionary_column_storage< std::uint8_t > full( &rsrc );
+    std::vector<std::string> names;
+    for ( size_t i = 0; i < 256; ++i ) {
+        names.push_back( std::to_string( i ) );
+    }
+    for ( const auto& name : names ) {
+        full.push_back( name );
+    }
+    CHECK_THROWS_AS( full.push_back( "256" ), std::length_error );
+
+    // through relation_builder
+    relation_builder builder(
+         &rsrc
+        ,col_desc<std::string_view>(    "Region" )
+        ,col_desc<int>(                 "Id" )
+    );
+    std::vector<std::tuple<std::string_view, int>> rows;
+    const std::array regions { "north"sv, "south"sv, "east"sv, "west"sv };
+    for ( int i = 0; i < 1000; ++i ) {
+        rows.emplace_back( regions[ size_t( i ) % regions.size() ], i );
+    }
+    builder.append_rows( rows );
+    CHECK_THROWS( builder.encode( "Id", Dictionary ) );
+    builder.encode( "Region", Dictionary );
+    REQUIRE( builder.at( 5 ) == std::tuple { "south"sv, 5 } );
+    REQUIRE( builder.m_ops[ 0 ] != untyped_value_ops<std::string_view>::ops() );
+
+    const auto* ops = builder.m_ops[ 0 ];
+    const auto& col = *builder.m_cols[ 0 ];
+    REQUIRE( ops->type() == tyString().ty() );
+    REQUIRE( ops->cmp( col.at( 0 ), col.at( 4 ) ) == std::strong_ordering::equivalent );
+    REQUIRE( ops->cmp( col.at( 2 ), col.at( 0 ) ) == std::strong_ordering::less );
+    REQUIRE( ops->cmp( col.at( 3 ), col.at( 1 ) ) == std::strong_ordering::greater );
+
+    // values read are written as is
+    builder.m_cols[ 0 ]->push_back( col.at( 3 ) );
+    builder.m_cols[ 0 ]->set( 0, col.at( 1 ) );
+    {
+        string_record_buffer records;
+        records.assign( regions.data(), regions.size() );
+        builder.m_cols[ 0 ]->append( records.data(), regions.size() );
+    }
+    REQUIRE( value_ops<std::string_view>::get( col.at( 1000 ) ) == "west" );
+    REQUIRE( value_ops<std::string_view>::get( col.at( 0 ) ) == "south" );
+    REQUIRE( value_ops<std::string_view>::get( col.at( 1003 ) ) == "east" );
+    builder.m_cols[ 0 ]->resize( 1000 );
+    builder.m_cols[ 0 ]->set( 0, col.at( 4 ) );
+
+    auto rel = std::make_shared<relation>( builder.release() );
+    auto irel = static_pointer_cast<IRelation>( rel );
+    const table_view tbl( irel, std::vector { "Region", "Id" } );
+    REQUIRE( value_ops<std::string_view>::get( tbl.at( 0, 0 ) ) == "east" );
+    REQUIRE( value_ops<int>::get( tbl.at( 0, 1 ) ) == 2 );
+    REQUIRE( value_ops<std::string_view>::get( tbl.at( 999, 0 ) ) == "west" );
+    REQUIRE( value_ops<int>::get( tbl.at( 999, 1 ) ) == 999 );
+}
+
+
+TEST_CASE( "run length encoding", "[encoding] [rle_column_storage]") {
+    using namespace std::string_view_literals;
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    rle_column_storage<int> rs( &rsrc );
+    const std::array vs { 1, 1, 1, 2, 2, 3 };
+    rs.append( vs.data(), vs.size() );
+    rs.push_back( 3 );
+    REQUIRE( rs.size() == 7 );
+    REQUIRE( rs.n_runs() == 3 );
+    REQUIRE( rs[ 0 ] == 1 );
+    REQUIRE( rs[ 2 ] == 1 );
+    REQUIRE( rs[ 3 ] == 2 );
+    REQUIRE( rs.at( 6 ) == 3 );
+    CHECK_THROWS_AS( rs.at( 7 ), std::out_of_range );
+    REQUIRE( rs.sum() == 13 );
+    REQUIRE( rs.count_if( []( int v ) { return v > 1; } ) == 4 );
+
+    // split a run, then merge it back
+    rs.set( 1, 5 );
+    REQUIRE( rs.n_runs() == 5 );
+    REQUIRE( rs[ 0 ] == 1 );
+    REQUIRE( rs[ 1 ] == 5 );
+    REQUIRE( rs[ 2 ] == 1 );
+    rs.set( 1, 1 );
+    REQUIRE( rs.n_runs() == 3 );
+    rs.set( 3, 1 );
+    REQUIRE( rs.n_runs() == 3 );
+    REQUIRE( rs.ends()[ 0 ] == 4 );
+    rs.set( 4, 1 );
+    rs.set( 5, 1 );
+    rs.set( 6, 1 );
+    REQUIRE( rs.n_runs() == 1 );
+
+    rs.resize( 10 );
+    REQUIRE( rs.n_runs() == 2 );
+    REQUIRE( rs[ 9 ] == 0 );
+    rs.resize( 3 );
+    REQUIRE( rs.n_runs() == 1 );
+    REQUIRE( rs.size() == 3 );
+    rs.resize( 0 );
+    REQUIRE( rs.empty() );
+
+    // through relation_builder, choosing encodings automatically
+    relation_builder builder(
+         &rsrc
+        ,col_desc<int>(                 "Year" )
+        ,col_desc<std::string_view>(    "Region" )
+        ,col_desc<double>(              "Amount" )
+    );
+    std::vector<std::tuple<int, std::string_view, double>> rows;
+    const std::array regions { "north"sv, "south"sv, "east"sv, "west"sv };
+    for ( int i = 0; i < 1000; ++i ) {
+        rows.emplace_back( 2000 + i / 100, regions[ size_t( i ) % regions.size() ], i * 0.5 );
+    }
+    builder.append_rows( rows );
+    REQUIRE( choose_encoding( *builder.m_cols[ 0 ], tyInt().ty() ) == Rle );
+    REQUIRE( choose_encoding( *builder.m_cols[ 1 ], tyString().ty() ) == Dictionary );
+    REQUIRE( choose_encoding( *builder.m_cols[ 2 ], tyDouble().ty() ) == Plain );
+    CHECK_THROWS( builder.encode( "Region", Rle ) );
+    builder.encode();
+    REQUIRE( dynamic_cast<const untyped_rle_column_storage<int>*>(
+        builder.m_cols[ 0 ].get() ) );
+    REQUIRE( builder.at( 250 ) == std::tuple { 2002, "east"sv, 125.0 } );
+    REQUIRE( builder.at( 999 ) == std::tuple { 2009, "west"sv, 499.5 } );
+
+    const auto& col = *builder.m_cols[ 0 ];
+    size_t n = 0;
+    for ( auto it = col.cbegin(); it != col.cend(); ++it, ++n ) {
+        REQUIRE( value_ops<int>::get( it.get() ) == 2000 + int( n / 100 ) );
+    }
+    REQUIRE( n == 1000 );
+    CHECK_THROWS( builder.m_cols[ 0 ]->at( 0 ) );
+}
+
+
+TEST_CASE( "bit-packed integers", "[encoding] [packed_column_storage]") {
+    std::pmr::monotonic_buffer_resource rsrc;
+    typedef packed_column_storage<int> packed_t;
+
+    packed_t ps( &rsrc );
+    column_storage<int> plain( &rsrc );
+    for ( int i = 0; i < 1000; ++i ) {
+        // ids within a partition, 10 bits, a constant block and negatives
+        const int v = ( i >= 256 && i < 384 ) ? 7
+            : ( i < 128 ? -( i * 3 ) : 50000 + ( i * 37 ) % 1000 );
+        plain.push_back( v );
+    }
+    ps.append( plain.data(), 500 );
+    for ( size_t i = 500; i < plain.size(); ++i ) {
+        ps.push_back( plain[ i ] );
+    }
+
+    REQUIRE( ps.size() == 1000 );
+    REQUIRE( ps.n_blocks() == 7 );
+    REQUIRE( ps.width( 0 ) == 9 );
+    REQUIRE( ps.width( 1 ) == 10 );
+    REQUIRE( ps.width( 2 ) == 0 );
+    REQUIRE( ps.packed_bytes() < plain.size() * sizeof( int ) / 2 );
+    for ( size_t i = 0; i < plain.size(); ++i ) {
+        REQUIRE( ps[ i ] == plain[ i ] );
+    }
+    CHECK_THROWS_AS( ps.at( 1000 ), std::out_of_range );
+
+    std::int64_t sum = 0;
+    size_t between = 0;
+    for ( size_t i = 0; i < plain.size(); ++i ) {
+        sum += plain[ i ];
+        between += ( plain[ i ] >= 0 && plain[ i ] <= 50500 ) ? 1U : 0U;
+    }
+    REQUIRE( ps.sum() == sum );
+    REQUIRE( ps.count_between( 0, 50500 ) == between );
+    REQUIRE( ps.count_between( 7, 7 ) == 128 );
+
+    column_storage<int> out( &rsrc );
+    ps.unpack( out );
+    REQUIRE( out.size() == plain.size() );
+    REQUIRE( std::equal( out.data(), out.data() + out.size(), plain.data() ) );
+
+    // full range values
+    packed_t wide( &rsrc );
+    for ( size_t i = 0; i < packed_t::block_size; ++i ) {
+        wide.push_back( ( i % 2 ) ? std::numeric_limits<int>::max()
+                                  : std::numeric_limits<int>::min() );
+    }
+    REQUIRE( wide.width( 0 ) == 32 );
+    REQUIRE( wide[ 0 ] == std::numeric_limits<int>::min() );
+    REQUIRE( wide[ 127 ] == std::numeric_limits<int>::max() );
+
+    // set in the frame, then outside it, repacking
+    ps.set( 130, 50001 );
+    REQUIRE( ps.width( 1 ) == 10 );
+    REQUIRE( ps[ 130 ] == 50001 );
+    ps.set( 140, 1 << 20 );
+    plain[ 130 ] = 50001;
+    plain[ 140 ] = 1 << 20;
+    REQUIRE( ps.width( 1 ) > 10 );
+    REQUIRE( ps.block_max( 1 ) == 1 << 20 );
+    ps.set( 999, -5 );
+    plain[ 999 ] = -5;
+    for ( size_t i = 0; i < plain.size(); ++i ) {
+        REQUIRE( ps[ i ] == plain[ i ] );
+    }
+
+    ps.resize( 300 );
+    REQUIRE( ps.n_blocks() == 2 );
+    REQUIRE( ps[ 299 ] == plain[ 299 ] );
+    ps.resize( 400 );
+    REQUIRE( ps.n_blocks() == 3 );
+    REQUIRE( ps[ 299 ] == plain[ 299 ] );
+    REQUIRE( ps[ 399 ] == 0 );
+
+    // through IStorage, by re-encoding
+    relation_builder builder( &rsrc, col_desc<int>( "Id" ), col_desc<double>( "Amount" ) );
+    for ( size_t i = 0; i < 1000; ++i ) {
+        builder.push_back( int( i ), 0.5 );
+    }
+    CHECK_THROWS( builder.encode( "Amount", Packed ) );
+    builder.encode( "Id", Packed );
+    const IStorage& col = *builder.m_cols[ 0 ];
+    REQUIRE( dynamic_cast<const untyped_packed_column_storage<int>*>( &col ) );
+    const int& v5   = value_ops<int>::get( col.at( 5 ) );
+    const int& v900 = value_ops<int>::get( col.at( 900 ) );
+    REQUIRE( v5 == 5 );
+    REQUIRE( v900 == 900 );
+    REQUIRE( col.zone( 1 ) );
+    REQUIRE( value_ops<int>::get( col.zone( 1 )->max ) == 255 );
+    REQUIRE( !col.zone( 7 ) );
+    CHECK_THROWS( builder.m_cols[ 0 ]->at( 0 ) );
+
+    const int x = -1;
+    builder.m_cols[ 0 ]->set( 5, reinterpret_cast<const value_t*>( &x ) );
+    REQUIRE( value_ops<int>::get( col.at( 5 ) ) == -1 );
+    REQUIRE( value_ops<int>::get( col.at( 6 ) ) == 6 );
+    const std::shared_ptr<const IStorage> copy = col.clone( &rsrc );
+    REQUIRE( value_ops<int>::get( copy->at( 5 ) ) == -1 );
+    REQUIRE( value_ops<int>::get( copy->at( 999 ) ) == 999 );
+
+    // concurrent readers share the decoded blocks
+    std::atomic<size_t> wrong { 0 };
+    std::vector<std::thread> readers;
+    for ( int t = 0; t < 4; ++t ) {
+        readers.emplace_back( [&] {
+            for ( size_t i = 0; i < copy->size(); ++i ) {
+                if ( value_ops<int>::get( copy->at( i ) ) != ( i == 5 ? -1 : int( i ) ) ) {
+                    ++wrong;
+                }
+            }
+        } );
+    }
+    for ( auto& r : readers ) {
+        r.join();
+    }
+    REQUIRE( wrong == 0 );
+
+    // filter and summarize decode a block at a time
+    const relation packed( builder.release() );
+    REQUIRE( select_rows( packed, compare( "Id", Ge, 990 ) ).size() == 10 );
+    REQUIRE( select_rows( packed, compare( "Id", Lt, 0 ) ) == row_map_t { 5 } );
+    const relation all = summarize( packed, {}, { { Sum, "Id", "Total" }, { Min, "Id", "Lo" } } );
+    REQUIRE( value_ops<double>::get( all.at( 0, all.col_index( "Total" ) ) ) == 499500 - 5 - 1 );
+    REQUIRE( value_ops<int>::get( all.at( 0, all.col_index( "Lo" ) ) ) == -1 );
+    const relation by = summarize( packed, { "Amount" }, { { Max, "Id", "Hi" } } );
+    REQUIRE( value_ops<int>::get( by.at( 0, by.col_index( "Hi" ) ) ) == 999 );
+}
+
+
 TEST_CASE( "relation_builder basics", "[relation_builder]") {
     std::array< std::uint8_t, 32768 > buffer{};
     std::pmr::monotonic_buffer_resource rsrc( buffer.data(), buffer.size() );
@@ -437,6 +1362,51 @@ TEST_CASE( "relation_builder basics2", "[relation_builder]") {
 }
 
 
+TEST_CASE( "relation_builder bulk append", "[relation_builder]") {
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    relation_builder builder(
+         &rsrc
+        ,col_desc<int>(     "A" )
+        ,col_desc<double>(  "B" )
+    );
+
+    const size_t n = 3000;
+    std::vector<int>    as( n );
+    std::vector<double> bs( n );
+    for ( size_t i = 0; i < n; ++i ) {
+        as[ i ] = int( i );
+        bs[ i ] = double( i ) * 0.5;
+    }
+
+    builder.append_columns( as, bs );
+    REQUIRE( builder.size() == n );
+    REQUIRE( builder.at( 0 ) == std::tuple { 0, 0.0 } );
+    REQUIRE( builder.at( n - 1 ) == std::tuple { int( n - 1 ), double( n - 1 ) * 0.5 } );
+
+    CHECK_THROWS( builder.append_columns( as, std::span<const double>( bs ).first( 10 ) ) );
+    REQUIRE( builder.size() == n );
+
+    std::vector<std::tuple<int, double>> rows;
+    rows.reserve( n );
+    for ( size_t i = 0; i < n; ++i ) {
+        rows.emplace_back( -int( i ), double( i ) );
+    }
+    builder.append_rows( rows );
+    REQUIRE( builder.size() == 2 * n );
+    REQUIRE( builder.at( n ) == std::tuple { 0, 0.0 } );
+    REQUIRE( builder.at( n + 1024 ) == std::tuple { -1024, 1024.0 } );
+    REQUIRE( builder.at( 2 * n - 1 ) == std::tuple { -int( n - 1 ), double( n - 1 ) } );
+
+    builder.append_rows( std::vector<std::tuple<int, double>>{} );
+    REQUIRE( builder.size() == 2 * n );
+
+    builder.push_back( 7, 8.0 );
+    REQUIRE( builder.size() == 2 * n + 1 );
+    REQUIRE( builder.at( 2 * n ) == std::tuple { 7, 8.0 } );
+}
+
+
 TEST_CASE( "rel_ty_t basics", "[rel_ty_t]" ) {
 
     rel_ty_t rel_ty_empty   {};
@@ -487,9 +1457,164 @@ TEST_CASE( "rel_ty_t basics", "[rel_ty_t]" ) {
     REQUIRE( rel_ty_t::intersect( rel_ty_ab, rel_ty_a ) == rel_ty_a );
     REQUIRE( rel_ty_t::intersect( rel_ty_b, rel_ty_ab ) == rel_ty_b );
     REQUIRE( rel_ty_t::intersect( rel_ty_ab, rel_ty_b ) == rel_ty_b );
+
+    const std::vector<std::string> names_a { "A" };
+    const std::vector<std::string> names_ba { "B", "A" };
+    const std::vector<std::string> names_c { "C" };
+    REQUIRE( rel_ty_t::project( rel_ty_ab, names_a.cbegin(), names_a.cend() ) == rel_ty_a );
+    REQUIRE( rel_ty_t::project( rel_ty_ab, names_ba.cbegin(), names_ba.cend() ) == rel_ty_ab );
+    REQUIRE( rel_ty_t::project( rel_ty_ab, names_a.cend(), names_a.cend() ) == rel_ty_empty );
+    CHECK_THROWS( rel_ty_t::project( rel_ty_ab, names_c.cbegin(), names_c.cend() ) );
+
+    REQUIRE( rel_ty_t::minus( rel_ty_ab, rel_ty_a ) == rel_ty_b );
+    REQUIRE( rel_ty_t::minus( rel_ty_ab, rel_ty_b ) == rel_ty_a );
+    REQUIRE( rel_ty_t::minus( rel_ty_ab, rel_ty_ab ) == rel_ty_empty );
+    REQUIRE( rel_ty_t::minus( rel_ty_a, rel_ty_b ) == rel_ty_a );
+    REQUIRE( rel_ty_t::minus( rel_ty_empty, rel_ty_a ) == rel_ty_empty );
+    CHECK_THROWS( rel_ty_t::minus( rel_ty_a, rel_ty_a_ ) );
+
+    // hashes agree with equality
+    REQUIRE( std::hash<rel_ty_t>()( rel_ty_ab ) == std::hash<rel_ty_t>()( rel_ty_ba ) );
+    REQUIRE( std::hash<rel_ty_t>()( rel_ty_a ) != std::hash<rel_ty_t>()( rel_ty_a_ ) );
+    REQUIRE( std::hash<rel_ty_t>()( rel_ty_t::union_( rel_ty_a, rel_ty_b ) )
+        == std::hash<rel_ty_t>()( rel_ty_ab ) );
 }
 
 
+TEST_CASE( "attribute interning", "[rel_ty_t] [attribute_interner]" ) {
+    attribute_interner attrs;
+    const attr_id_t a = attrs.intern( "A" );
+    const attr_id_t b = attrs.intern( "B" );
+    REQUIRE( a != b );
+    REQUIRE( attrs.intern( std::string( "A" ) ) == a );
+    REQUIRE( attrs.find( "B" ) == b );
+    REQUIRE( !attrs.find( "C" ) );
+    REQUIRE( attrs.name( b ) == "B" );
+    REQUIRE( attrs.size() == 2 );
+
+    // headers carry the interned names in column order
+    const rel_ty_t abc { { "C", { Int } }, { "A", { Int } }, { "B", { Double } } };
+    REQUIRE( abc.m_ids.size() == 3 );
+    for ( size_t i = 0; i < abc.m_tys.size(); ++i ) {
+        REQUIRE( global_attributes().name( abc.m_ids[ i ] ) == abc.m_tys[ i ].first );
+        REQUIRE( abc.index_of( abc.m_ids[ i ] ) == i );
+    }
+    REQUIRE( abc.index_of( "C" ) == 2 );
+    REQUIRE( !abc.index_of( "never used as a column name" ) );
+
+    // merges keep name order
+    const rel_ty_t bd { { "D", { Int } }, { "B", { Double } } };
+    const rel_ty_t u = rel_ty_t::union_( abc, bd );
+    REQUIRE( u == rel_ty_t { { "A", { Int } }, { "B", { Double } }, { "C", { Int } }, { "D", { Int } } } );
+    REQUIRE( u.index_of( "D" ) == 3 );
+    REQUIRE( rel_ty_t::intersect( abc, bd ) == rel_ty_t { { "B", { Double } } } );
+    REQUIRE( rel_ty_t::union_( bd, abc ) == u );
+    CHECK_THROWS( rel_ty_t::union_( abc, rel_ty_t { { "B", { Int } } } ) );
+    REQUIRE( !( abc == rel_ty_t { { "C", { Int } }, { "A", { Int } }, { "B", { Int } } } ) );
+}
+
+TEST_CASE( "static relation headers", "[rel_ty_t] [rel_header]" ) {
+    using namespace std::string_view_literals;
+    using orders_h      = rel_header< attr<"Id", int>, attr<"Customer", std::string_view>,
+                                      attr<"Amount", double> >;
+    using customers_h   = rel_header< attr<"Customer", std::string_view>, attr<"Region", std::string_view> >;
+
+    // canonical order is name order
+    STATIC_REQUIRE( canonical_t<orders_h>::names[ 0 ] == "Amount" );
+    STATIC_REQUIRE( header_index_v<orders_h, "Id"> == 2 );
+    STATIC_REQUIRE( std::is_same_v< attr_type_t<orders_h, "Amount">, double > );
+    STATIC_REQUIRE( header_contains_v<orders_h, "Customer"> );
+    STATIC_REQUIRE( !header_contains_v<orders_h, "Region"> );
+
+    using joined_h = header_union_t<orders_h, customers_h>;
+    STATIC_REQUIRE( joined_h::size == 4 );
+    STATIC_REQUIRE( joined_h::names[ 3 ] == "Region" );
+    STATIC_REQUIRE( same_header_v< header_intersect_t<orders_h, customers_h>,
+                                   rel_header< attr<"Customer", std::string_view> > > );
+    STATIC_REQUIRE( same_header_v< header_minus_t<orders_h, customers_h>,
+                                   rel_header< attr<"Id", int>, attr<"Amount", double> > > );
+    STATIC_REQUIRE( same_header_v< header_project_t<joined_h, "Region", "Id">,
+                                   rel_header< attr<"Id", int>, attr<"Region", std::string_view> > > );
+    STATIC_REQUIRE( shared_positions<orders_h, customers_h>::a[ 0 ] == 1 );
+    STATIC_REQUIRE( shared_positions<orders_h, customers_h>::b[ 0 ] == 0 );
+
+    // agrees with the runtime header
+    REQUIRE( to_rel_ty<joined_h>()
+        == rel_ty_t::union_( to_rel_ty<orders_h>(), to_rel_ty<customers_h>() ) );
+
+    std::pmr::monotonic_buffer_resource rsrc;
+    auto builder = make_header_builder<orders_h>( &rsrc );
+    builder.push_back( 1, "acme"sv, 10.5 );
+    builder.push_back( 2, "initech"sv, 20.0 );
+    const relation rel( builder.release() );
+
+    const static_relation<orders_h> orders( rel );
+    REQUIRE( orders.size() == 2 );
+    REQUIRE( orders.get<"Customer">( 1 ) == "initech" );
+    REQUIRE( orders.get<"Amount">( 0 ) == 10.5 );
+    REQUIRE( orders.column<"Id">().size() == 2 );
+    CHECK_THROWS( static_relation<customers_h>( rel ) );
+
+    // holds the relation, so may be built from a temporary
+    const static_relation<orders_h> renamed( rel.select_columns( { "Id", "Customer", "Amount" } ) );
+    REQUIRE( renamed.get<"Id">( 1 ) == 2 );
+
+    auto cbuilder = make_header_builder<customers_h>( &rsrc );
+    cbuilder.push_back( "initech"sv, "north"sv );
+    cbuilder.push_back( "acme"sv, "south"sv );
+    cbuilder.push_back( "umbrella"sv, "east"sv );
+    const static_relation<customers_h> customers( relation( cbuilder.release() ) );
+
+    const auto joined = natural_join( orders, customers, &rsrc );
+    STATIC_REQUIRE( std::is_same_v< decltype( joined )::header_t, joined_h > );
+    REQUIRE( joined.size() == 2 );
+    REQUIRE( joined.get<"Id">( 0 ) == 1 );
+    REQUIRE( joined.get<"Region">( 0 ) == "south" );
+    REQUIRE( joined.get<"Region">( 1 ) == "north" );
+    REQUIRE( joined.rel().m_ty == natural_join( rel, customers.rel() ).m_ty );
+
+    // encoded and mapped columns are read through const IStorage
+    auto ebuilder = make_header_builder<orders_h>( &rsrc );
+    for ( int i = 0; i < 300; ++i ) {
+        ebuilder.push_back( i, i % 2 == 0 ? "acme"sv : "initech"sv, double( i / 100 ) );
+    }
+    ebuilder.encode( "Id", Packed );
+    ebuilder.encode( "Customer", Dictionary );
+    ebuilder.encode( "Amount", Rle );
+    const relation encoded( ebuilder.release() );
+    const static_relation<orders_h> enc_orders( encoded );
+    REQUIRE( enc_orders.get<"Id">( 250 ) == 250 );
+    REQUIRE( enc_orders.get<"Customer">( 3 ) == "initech" );
+    REQUIRE( enc_orders.get<"Amount">( 250 ) == 2.0 );
+
+    const auto path = std::filesystem::temp_directory_path()
+        / ( "ra_cpp_static_" + std::to_string( ::getpid() ) + ".racols" );
+    write_column_file( encoded, path.string() );
+    {
+        const static_relation<orders_h> mapped( *open_column_file( path.string() ) );
+        REQUIRE( mapped.get<"Id">( 299 ) == 299 );
+        REQUIRE( mapped.get<"Customer">( 4 ) == "acme" );
+        REQUIRE( mapped.get<"Amount">( 0 ) == 0.0 );
+    }
+    std::filesystem::remove( path );
+
+    // nullable columns need optional attributes
+    relation_builder nbuilder( &rsrc, col_desc<double>( "K" ), col_desc< std::optional<int> >( "N" ) );
+    nbuilder.push_back( std::nan( "" ), std::optional( 1 ) );
+    nbuilder.push_back( 1.0, std::optional<int>() );
+    const relation nullable( nbuilder.release() );
+    CHECK_THROWS( static_relation< rel_header< attr<"K", double>, attr<"N", int> > >( nullable ) );
+    using nullable_h = rel_header< attr<"K", double>, attr<"N", std::optional<int> > >;
+    const static_relation<nullable_h> nulls( nullable );
+    REQUIRE( nulls.get<"N">( 0 ) == 1 );
+    REQUIRE( !nulls.get<"N">( 1 ) );
+
+    // keys match as in the dynamic join, NaN and null included
+    const auto self = natural_join( nulls, nulls, &rsrc );
+    REQUIRE( self.size() == 2 );
+    REQUIRE( self.size() == natural_join( nullable, nullable ).size() );
+}
+
 TEST_CASE( "relation basics", "[relation_builder], [relation]") {
     std::array< std::uint8_t, 32768 > buffer{};
     std::pmr::monotonic_buffer_resource rsrc( buffer.data(), buffer.size() );
@@ -534,6 +1659,924 @@ TEST_CASE( "relation basics", "[relation_builder], [relation]") {
 }
 
 
+TEST_CASE( "column files", "[relation] [column_file]") {
+    using namespace std::string_view_literals;
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    relation_builder builder(
+         &rsrc
+        ,col_desc<int>(                 "Id" )
+        ,col_desc<bool>(                "Flag" )
+        ,col_desc<double>(              "Amount" )
+        ,col_desc<std::string_view>(    "Name" )
+    );
+    const std::array names { "alpha"sv, ""sv, "a longer name"sv };
+    for ( int i = 0; i < 200; ++i ) {
+        builder.push_back( i, i % 3 == 0, i * 0.25, names[ size_t( i ) % names.size() ] );
+    }
+    builder.encode( "Name", Dictionary );
+    relation rel( builder.release() );
+    rel.m_keys = { { rel.type()[ rel.col_index( "Id" ) ] }
+        , { rel.type()[ rel.col_index( "Name" ) ], rel.type()[ rel.col_index( "Flag" ) ] } };
+
+    const auto path = std::filesystem::temp_directory_path()
+        / ( "ra_cpp_test_" + std::to_string( ::getpid() ) + ".racols" );
+    write_column_file( rel, path.string() );
+
+    {
+        auto mapped = open_column_file( path.string() );
+        REQUIRE( mapped->type() == rel.type() );
+        REQUIRE( mapped->size() == rel.size() );
+        REQUIRE( mapped->keys() == rel.m_keys );
+        for ( size_t c = 0; c < rel.type().size(); ++c ) {
+            for ( size_t r = 0; r < rel.size(); ++r ) {
+                REQUIRE( mapped->value_ops()[ c ]->cmp(
+                    mapped->at( r, c ), rel.at( r, c ) )
+                    == std::strong_ordering::equal );
+            }
+        }
+        // fixed size columns iterate contiguously
+        const auto& col = *mapped->m_cols[ 2 ];
+        REQUIRE( mapped->type()[ 2 ].first == "Id" );
+        REQUIRE( col.cbegin().contiguous() );
+        REQUIRE( col.cend() - col.cbegin() == 200 );
+        CHECK_THROWS_AS( mapped->m_cols[ 2 ]->resize( 0 ), std::logic_error );
+        CHECK_THROWS_AS( mapped->m_cols[ 2 ]->at( 0 ), std::logic_error );
+        CHECK_THROWS_AS( mapped->at( 200, 0 ), std::out_of_range );
+
+        std::ostringstream a, b;
+        mapped->dump( a );
+        rel.dump( b );
+        REQUIRE( a.str() == b.str() );
+    }
+
+    // a string record running past the end of the heap is rejected
+    {
+        std::fstream fs( path, std::ios::binary | std::ios::in | std::ios::out );
+        column_file_header hdr;
+        fs.read( reinterpret_cast<char*>( &hdr ), sizeof( hdr ) );
+        size_t name_col = 0;
+        column_file_entry e;
+        for ( size_t c = 0; c < hdr.n_cols; ++c ) {
+            fs.read( reinterpret_cast<char*>( &e ), sizeof( e ) );
+            if ( e.ty_con == String ) {
+                name_col = c;
+                break;
+            }
+        }
+        std::uint64_t off = 0;
+        fs.seekg( std::streamoff( e.data_offset ) );
+        fs.read( reinterpret_cast<char*>( &off ), sizeof( off ) );
+        const string_record::length_t len = 0xFFFF;
+        fs.seekp( std::streamoff( e.heap_offset + off ) );
+        fs.write( reinterpret_cast<const char*>( &len ), sizeof( len ) );
+        fs.close();
+
+        auto mapped = open_column_file( path.string() );
+        CHECK_THROWS_AS( mapped->at( 0, name_col ), std::out_of_range );
+        REQUIRE( mapped->value_ops()[ name_col ]->cmp(
+            mapped->at( 1, name_col ), rel.at( 1, rel.col_index( "Name" ) ) )
+            == std::strong_ordering::equal );
+    }
+
+    // truncated/garbage files are rejected
+    {
+        std::ofstream os( path, std::ios::binary | std::ios::trunc );
+        os << "not a column file at all, but long enough for a header";
+    }
+    CHECK_THROWS_AS( open_column_file( path.string() ), std::runtime_error );
+    std::filesystem::remove( path );
+    CHECK_THROWS_AS( open_column_file( path.string() ), std::runtime_error );
+}
+
+
+TEST_CASE( "column statistics", "[relation] [column_stats]") {
+    using namespace std::string_view_literals;
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    // HyperLogLog within a few standard errors
+    hyperloglog hll;
+    hyperloglog other;
+    for ( int i = 0; i < 100000; ++i ) {
+        const int j = i + 50000;
+        ( i < 50000 ? hll : other ).add( hash_value( tyInt().ty(),
+            reinterpret_cast<const value_t*>( &j ) ) );
+    }
+    hll.merge( other );
+    REQUIRE( std::abs( hll.estimate() - 100000 ) < 100000 * 0.05 );
+    CHECK_THROWS( hll.merge( hyperloglog( 10 ) ) );
+    const double pz = 0.0, nz = -0.0;
+    REQUIRE( hash_value( tyDouble().ty(), reinterpret_cast<const value_t*>( &pz ) )
+        == hash_value( tyDouble().ty(), reinterpret_cast<const value_t*>( &nz ) ) );
+
+    relation_builder builder(
+         &rsrc
+        ,col_desc<int>(                             "Id" )
+        ,col_desc<std::string_view>(                "Region" )
+        ,col_desc< std::optional<double> >(         "Amount" )
+    );
+    const std::array regions { "north"sv, "south"sv, "east"sv, "west"sv };
+    for ( int i = 0; i < 10000; ++i ) {
+        builder.push_back( i, regions[ size_t( i ) % regions.size() ],
+            i % 10 == 0 ? std::nullopt : std::optional<double>( i % 100 ) );
+    }
+    const relation rel( builder.release() );
+
+    const column_stats& id = rel.stats( "Id" );
+    REQUIRE( &id == &rel.stats( "Id" ) );
+    REQUIRE( id.row_count == 10000 );
+    REQUIRE( id.null_count == 0 );
+    REQUIRE( value_ops<int>::get( id.min ) == 0 );
+    REQUIRE( value_ops<int>::get( id.max ) == 9999 );
+    REQUIRE( std::abs( id.distinct - 10000 ) < 10000 * 0.05 );
+    REQUIRE( id.histogram.size() == default_histogram_buckets );
+    size_t rows = 0;
+    for ( const auto& b : id.histogram ) {
+        rows += b.rows;
+    }
+    REQUIRE( rows == 10000 );
+    const int mid = 4999;
+    const IValue& ops = *untyped_value_ops<int>::ops();
+    REQUIRE( std::abs( id.rows_le( ops, reinterpret_cast<const value_t*>( &mid ) ) - 5000 ) < 500 );
+
+    const column_stats& region = rel.stats( "Region" );
+    REQUIRE( std::abs( region.distinct - 4 ) < 0.5 );
+    REQUIRE( value_ops<std::string_view>::get( region.min ) == "east" );
+    REQUIRE( value_ops<std::string_view>::get( region.max ) == "west" );
+    REQUIRE( region.histogram.size() == 4 );
+
+    const column_stats& amount = rel.stats( "Amount" );
+    REQUIRE( amount.null_count == 1000 );
+    REQUIRE( value_ops<double>::get( amount.min ) == 1.0 );
+    REQUIRE( value_ops<double>::get( amount.max ) == 99.0 );
+    REQUIRE( std::abs( amount.distinct - 90 ) < 3 );
+
+    CHECK_THROWS( rel.stats( "Nope" ) );
+}
+
+TEST_CASE( "copy-on-write columns", "[relation] [clone]") {
+    using namespace std::string_view_literals;
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    relation_builder builder(
+         &rsrc
+        ,col_desc<int>(                 "Id" )
+        ,col_desc<std::string_view>(    "Region" )
+        ,col_desc<double>(              "Amount" )
+    );
+    const std::array regions { "north"sv, "south"sv, "east"sv, "west"sv };
+    for ( int i = 0; i < 1000; ++i ) {
+        builder.push_back( i, regions[ size_t( i ) % regions.size() ], i * 0.5 );
+    }
+    builder.encode( "Region", Dictionary );
+    const relation rel( builder.release() );
+    const size_t amount = rel.col_index( "Amount" );
+    const size_t id     = rel.col_index( "Id" );
+    const size_t region = rel.col_index( "Region" );
+
+    // copies share storage
+    relation copy( rel );
+    REQUIRE( copy.m_cols[ amount ] == rel.m_cols[ amount ] );
+
+    // mutation copies only the mutated column
+    const double v = -1.0;
+    copy.mutable_column( amount ).set( 10, reinterpret_cast<const value_t*>( &v ) );
+    REQUIRE( copy.m_cols[ amount ] != rel.m_cols[ amount ] );
+    REQUIRE( copy.m_cols[ id ] == rel.m_cols[ id ] );
+    REQUIRE( value_ops<double>::get( copy.at( 10, amount ) ) == -1.0 );
+    REQUIRE( value_ops<double>::get( rel.at( 10, amount ) ) == 5.0 );
+    REQUIRE( value_ops<double>::get( copy.at( 999, amount ) ) == 499.5 );
+    REQUIRE( dynamic_cast<const column_resource&>(
+        *copy.m_resources[ amount ] ).upstream() == &rsrc );
+
+    // unshared columns are mutated in place
+    const IStorage* before = copy.m_cols[ amount ].get();
+    REQUIRE( &copy.mutable_column( amount ) == before );
+
+    // clones keep their encoding
+    const IStorage& regions_copy = copy.mutable_column( region );
+    REQUIRE( copy.m_cols[ region ] != rel.m_cols[ region ] );
+    REQUIRE( regions_copy.ops() != nullptr );
+    REQUIRE( copy.m_ops[ region ] == regions_copy.ops() );
+    REQUIRE( value_ops<std::string_view>::get( regions_copy.at( 2 ) ) == "east" );
+
+    // column subsets and renames share storage
+    const relation sub = rel.select_columns( { "Region", "Id" } );
+    REQUIRE( sub.m_cols.size() == 2 );
+    REQUIRE( sub.m_cols[ sub.col_index( "Id" ) ] == rel.m_cols[ id ] );
+    CHECK_THROWS( rel.select_columns( { "Id", "Id" } ) );
+    CHECK_THROWS( rel.select_columns( { "Nope" } ) );
+
+    const relation renamed = rel.rename( "Amount", "Total" );
+    REQUIRE( renamed.m_cols[ renamed.col_index( "Total" ) ] == rel.m_cols[ amount ] );
+    CHECK_THROWS( renamed.col_index( "Amount" ) );
+    CHECK_THROWS( rel.rename( "Amount", "Id" ) );
+}
+
+
+TEST_CASE( "memory accounting", "[relation] [accounting_resource]") {
+    using namespace std::string_view_literals;
+
+    accounting_resource budget;
+    {
+        relation_builder builder(
+             &budget
+            ,col_desc<int>(                 "Id" )
+            ,col_desc<std::string_view>(    "Name" )
+        );
+        for ( int i = 0; i < 10000; ++i ) {
+            builder.push_back( i, "some name"sv );
+        }
+        const relation rel( builder.release() );
+
+        const memory_usage_t usage = rel.memory_usage();
+        REQUIRE( usage.columns.size() == 2 );
+        const auto& id = usage.columns[ rel.col_index( "Id" ) ];
+        REQUIRE( id.name == "Id" );
+        REQUIRE( id.requested.bytes_live >= 10000 * sizeof( int ) );
+        REQUIRE( id.requested.peak_bytes >= id.requested.bytes_live );
+        REQUIRE( id.requested.allocations > id.requested.deallocations );
+        REQUIRE( id.reserved.bytes_live >= id.requested.bytes_live );
+        REQUIRE( usage.reserved().bytes_live == budget.stats().bytes_live );
+
+        std::ostringstream os;
+        os << usage;
+        REQUIRE( os.str().find( "Name" ) != std::string::npos );
+    }
+    // all released
+    REQUIRE( budget.stats().bytes_live == 0 );
+    REQUIRE( budget.stats().allocations == budget.stats().deallocations );
+
+    // limits
+    accounting_resource limited( std::pmr::get_default_resource(), 1024 );
+    std::pmr::vector<char> v( &limited );
+    v.resize( 1000 );
+    CHECK_THROWS_AS( v.resize( 2000 ), std::bad_alloc );
+    REQUIRE( v.size() == 1000 );
+    limited.set_limit( accounting_resource::no_limit );
+    v.resize( 2000 );
+    REQUIRE( limited.stats().peak_bytes == 3000 );
+}
+
+TEST_CASE( "natural join", "[relation] [natural_join]") {
+    using namespace std::string_view_literals;
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    relation_builder orders_builder(
+         &rsrc
+        ,col_desc<int>(                 "Id" )
+        ,col_desc<std::string_view>(    "Customer" )
+        ,col_desc<double>(              "Amount" )
+    );
+    const std::array customers { "acme"sv, "initech"sv, "globex"sv, "hooli"sv };
+    for ( int i = 0; i < 5000; ++i ) {
+        orders_builder.push_back( i, customers[ size_t( i ) % customers.size() ], i * 1.5 );
+    }
+    orders_builder.encode( "Customer", Dictionary );
+    const relation orders( orders_builder.release() );
+
+    // no orders for "umbrella", no region for "hooli"
+    relation_builder regions_builder(
+         &rsrc
+        ,col_desc<std::string_view>(                "Customer" )
+        ,col_desc< std::optional<std::string_view> >( "Region" )
+    );
+    regions_builder.push_back( "acme"sv, std::optional( "north"sv ) );
+    regions_builder.push_back( "initech"sv, std::optional( "south"sv ) );
+    regions_builder.push_back( "globex"sv, std::nullopt );
+    regions_builder.push_back( "umbrella"sv, std::optional( "east"sv ) );
+    const relation regions( regions_builder.release() );
+
+    const relation joined = natural_join( orders, regions );
+    REQUIRE( joined.m_ty == rel_ty_t::union_( orders.m_ty, regions.m_ty ) );
+    REQUIRE( joined.size() == 3750 );
+    const size_t id     = joined.col_index( "Id" );
+    const size_t cust   = joined.col_index( "Customer" );
+    const size_t region = joined.col_index( "Region" );
+    const size_t amount = joined.col_index( "Amount" );
+    REQUIRE( joined.m_cols[ region ]->nullable() );
+    for ( size_t r = 0; r < joined.size(); ++r ) {
+        const int i = value_ops<int>::get( joined.at( r, id ) );
+        const auto c = value_ops<std::string_view>::get( joined.at( r, cust ) );
+        REQUIRE( c == customers[ size_t( i ) % customers.size() ] );
+        REQUIRE( value_ops<double>::get( joined.at( r, amount ) ) == i * 1.5 );
+        const value_t* reg = joined.at( r, region );
+        if ( c == "globex" ) {
+            REQUIRE( reg == nullptr );
+        } else {
+            REQUIRE( value_ops<std::string_view>::get( reg ) == ( c == "acme" ? "north" : "south" ) );
+        }
+    }
+    // either side may be the build side
+    REQUIRE( natural_join( regions, orders ).size() == 3750 );
+
+    // no common attributes, the product
+    relation_builder flags_builder( &rsrc, col_desc<bool>( "Flag" ) );
+    flags_builder.push_back( true );
+    flags_builder.push_back( false );
+    const relation flags( flags_builder.release() );
+    REQUIRE( natural_join( regions, flags ).size() == 8 );
+
+    // all common attributes, the intersection
+    REQUIRE( natural_join( orders, orders ).size() == orders.size() );
+    CHECK_THROWS( natural_join( orders, relation( relation_builder( &rsrc, col_desc<int>( "Customer" ) ).release() ) ) );
+}
+
+TEST_CASE( "sort-merge join", "[relation] [merge_join]") {
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    // sorted on K, with runs of duplicate keys on both sides
+    relation_builder a_builder( &rsrc, col_desc<int>( "K" ), col_desc<int>( "A" ) );
+    for ( int i = 0; i < 300; ++i ) {
+        a_builder.push_back( i / 3, i );
+    }
+    const relation a( a_builder.release() );
+    relation_builder b_builder( &rsrc, col_desc<int>( "K" ), col_desc<double>( "B" ) );
+    for ( int i = 0; i < 200; ++i ) {
+        b_builder.push_back( 50 + i / 2, i * 0.5 );
+    }
+    const relation b( b_builder.release() );
+
+    const relation hashed = natural_join( a, b );
+    const relation merged = merge_join( a, b );
+    REQUIRE( merged.m_ty == hashed.m_ty );
+    REQUIRE( merged.size() == 300 );
+    REQUIRE( merged.size() == hashed.size() );
+    const size_t k  = merged.col_index( "K" );
+    const size_t ac = merged.col_index( "A" );
+    const size_t bc = merged.col_index( "B" );
+    for ( size_t r = 0; r < merged.size(); ++r ) {
+        const int key = value_ops<int>::get( merged.at( r, k ) );
+        REQUIRE( value_ops<int>::get( merged.at( r, ac ) ) / 3 == key );
+        REQUIRE( 50 + int( value_ops<double>::get( merged.at( r, bc ) ) * 2.0 ) / 2 == key );
+        if ( r > 0 ) {
+            REQUIRE( value_ops<int>::get( merged.at( r - 1, k ) ) <= key );
+        }
+    }
+
+    // unsorted inputs, through views sorted on the key
+    relation_builder c_builder( &rsrc, col_desc<int>( "K" ), col_desc<int>( "C" ) );
+    for ( int i = 0; i < 100; ++i ) {
+        c_builder.push_back( ( i * 37 ) % 100, i );
+    }
+    auto c = std::make_shared<relation>( c_builder.release() );
+    CHECK_THROWS( merge_join( a, *c ) );
+
+    std::shared_ptr<IRelation> c_irel = c;
+    std::shared_ptr<IRelation> a_irel = std::make_shared<relation>( a.select_columns( { "A", "K" } ) );
+    const table_view c_view( c_irel, std::vector { "K" } );
+    const table_view a_view( a_irel, std::vector { "K" } );
+    REQUIRE( c_view.size() == c->size() );
+    const relation viewed = merge_join( a_view, c_view );
+    REQUIRE( viewed.size() == natural_join( a, *c ).size() );
+    REQUIRE( viewed.size() == 300 );
+    const size_t vk = viewed.col_index( "K" );
+    const size_t vc = viewed.col_index( "C" );
+    for ( size_t r = 0; r < viewed.size(); ++r ) {
+        const int c_val = value_ops<int>::get( viewed.at( r, vc ) );
+        REQUIRE( ( c_val * 37 ) % 100 == value_ops<int>::get( viewed.at( r, vk ) ) );
+    }
+
+    // views must be on the common attributes
+    const table_view a_all( a_irel, std::vector { "K", "A" } );
+    CHECK_THROWS( merge_join( a_all, c_view ) );
+}
+
+TEST_CASE( "filter", "[relation] [filter]") {
+    using namespace std::string_view_literals;
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    relation_builder builder(
+         &rsrc
+        ,col_desc<int>(                     "Id" )
+        ,col_desc<double>(                  "Amount" )
+        ,col_desc<std::string_view>(        "Customer" )
+        ,col_desc< std::optional<float> >(  "Discount" )
+    );
+    const std::array customers { "acme"sv, "initech"sv, "globex"sv };
+    for ( int i = 0; i < 5000; ++i ) {
+        builder.push_back( i, i * 0.5, customers[ size_t( i ) % customers.size() ],
+            i % 4 == 0 ? std::nullopt : std::optional( float( i % 10 ) ) );
+    }
+    const relation rel( builder.release() );
+
+    // plain columns
+    const relation big = filter( rel, compare( "Amount", Ge, 2000.0 ) );
+    REQUIRE( big.m_ty == rel.m_ty );
+    REQUIRE( big.size() == 1000 );
+    REQUIRE( value_ops<int>::get( big.at( 0, big.col_index( "Id" ) ) ) == 4000 );
+
+    const auto p = and_( {
+         compare( "Id", Lt, 3000 )
+        ,or_( { compare( "Customer", Eq, "acme" ), is_null( "Discount" ) } )
+        ,not_( compare( "Discount", Eq, 5.0F ) )
+    } );
+    const row_map_t rows = select_rows( rel, p );
+    size_t expected = 0;
+    for ( int i = 0; i < 5000; ++i ) {
+        const bool null_discount = i % 4 == 0;
+        // a comparison with a null discount is unknown, as is its not_
+        if ( i < 3000 && ( i % 3 == 0 || null_discount )
+                && ( !null_discount && i % 10 != 5 ) ) {
+            REQUIRE( rows.at( expected ) == size_t( i ) );
+            ++expected;
+        }
+    }
+    REQUIRE( rows.size() == expected );
+
+    const relation filtered = filter( rel, p );
+    REQUIRE( filtered.size() == expected );
+    const size_t id = filtered.col_index( "Id" );
+    const size_t disc = filtered.col_index( "Discount" );
+    REQUIRE( filtered.m_cols[ disc ]->nullable() );
+    for ( size_t r = 0; r < filtered.size(); ++r ) {
+        const int i = value_ops<int>::get( filtered.at( r, id ) );
+        REQUIRE( size_t( i ) == rows[ r ] );
+        REQUIRE( ( filtered.at( r, disc ) == nullptr ) == ( i % 4 == 0 ) );
+    }
+
+    // three valued logic
+    const row_map_t ne = select_rows( rel, compare( "Discount", Ne, 5.0F ) );
+    REQUIRE( ne == select_rows( rel, not_( compare( "Discount", Eq, 5.0F ) ) ) );
+    REQUIRE( ne == select_rows( rel, not_( not_( compare( "Discount", Ne, 5.0F ) ) ) ) );
+    REQUIRE( ne.size() == 5000 - 1250 - 500 );
+    REQUIRE( select_rows( rel,
+        or_( { compare( "Discount", Eq, 5.0F ), is_null( "Discount" ) } ) ).size() == 1250 + 500 );
+    REQUIRE( select_rows( rel,
+        not_( and_( { compare( "Discount", Eq, 5.0F ), compare( "Id", Lt, 0 ) } ) ) ).size() == 5000 );
+
+    // keys are kept
+    {
+        relation keyed = rel;
+        keyed.m_keys.push_back( { { "Id", { Int } } } );
+        REQUIRE( filter( keyed, compare( "Id", Lt, 10 ) ).m_keys == keyed.m_keys );
+    }
+
+    // zone maps skip blocks, with the same result as a scan
+    const std::array<std::pair<cmp_op_t, size_t>, 6> expected_sizes { {
+        { Eq, 1 }, { Ne, 4999 }, { Lt, 2469 }, { Le, 2470 }, { Gt, 2530 }, { Ge, 2531 } } };
+    for ( const auto& [ op, n ] : expected_sizes ) {
+        REQUIRE( select_rows( rel, compare( "Amount", op, 1234.5 ) ).size() == n );
+    }
+
+    // a NaN zone min doesn't hide the numbers
+    {
+        relation_builder nan_builder( &rsrc, col_desc<double>( "X" ) );
+        nan_builder.push_back( std::nan( "" ) );
+        for ( int i = 1; i < 2000; ++i ) {
+            nan_builder.push_back( i + 100.0 );
+        }
+        const relation nans( nan_builder.release() );
+        REQUIRE( select_rows( nans, compare( "X", Lt, 150.0 ) ).size() == 49 );
+        REQUIRE( select_rows( nans, compare( "X", Eq, 101.0 ) ).size() == 1 );
+    }
+
+    // dictionary, RLE, segmented and nullable columns match a plain scan
+    {
+        const auto make = [&]( bool encoded ) {
+            relation_builder b(
+                 &rsrc
+                ,col_desc<int>(                     "Grp" )
+                ,col_desc<double>(                  "Amount" )
+                ,col_desc<std::string_view>(        "Customer" )
+                ,col_desc< std::optional<int> >(    "Score" )
+            );
+            if ( encoded ) {
+                b.segment_columns( 512 );
+            }
+            for ( int i = 0; i < 5000; ++i ) {
+                b.push_back( i / 100, i * 0.5, customers[ size_t( i ) % customers.size() ],
+                    i % 7 == 0 ? std::nullopt : std::optional( i % 10 ) );
+            }
+            if ( encoded ) {
+                b.encode( "Grp", Rle );
+                b.encode( "Customer", Dictionary );
+            }
+            return relation( b.release() );
+        };
+        const relation plain = make( false );
+        const relation encoded = make( true );
+        REQUIRE( dynamic_cast<const untyped_rle_column_storage<int>*>( encoded.m_cols[ encoded.col_index( "Grp" ) ].get() ) );
+        REQUIRE( dynamic_cast<const untyped_segmented_column_storage<double>*>(
+            encoded.m_cols[ encoded.col_index( "Amount" ) ].get() ) );
+        REQUIRE( dynamic_cast<const untyped_dictionary_column_storage<std::uint8_t>*>(
+            encoded.m_cols[ encoded.col_index( "Customer" ) ].get() ) );
+        for ( const cmp_op_t op : { Eq, Ne, Lt, Le, Gt, Ge } ) {
+            for ( const int g : { -1, 0, 7, 25, 49, 50 } ) {
+                REQUIRE( select_rows( encoded, compare( "Grp", op, g ) )
+                    == select_rows( plain, compare( "Grp", op, g ) ) );
+            }
+            for ( const double a : { 100.0, 1234.5, 2499.5 } ) {
+                REQUIRE( select_rows( encoded, compare( "Amount", op, a ) )
+                    == select_rows( plain, compare( "Amount", op, a ) ) );
+            }
+            for ( const char* c : { "a", "acme", "globex", "hooli", "initech", "zzz" } ) {
+                REQUIRE( select_rows( encoded, compare( "Customer", op, c ) )
+                    == select_rows( plain, compare( "Customer", op, c ) ) );
+            }
+            for ( const int sc : { 0, 5, 9 } ) {
+                REQUIRE( select_rows( encoded, not_( compare( "Score", op, sc ) ) )
+                    == select_rows( plain, not_( compare( "Score", op, sc ) ) ) );
+            }
+        }
+        REQUIRE( select_rows( encoded, compare( "Customer", Ne, "hooli" ) ).size() == 5000 );
+        REQUIRE( select_rows( encoded, compare( "Grp", Eq, 7 ) ).size() == 100 );
+        // nulls are unknown, so neither compare nor its not_ selects them
+        REQUIRE( select_rows( encoded, compare( "Score", Eq, 5 ) ).size()
+            + select_rows( encoded, not_( compare( "Score", Eq, 5 ) ) ).size() == 5000 - 715 );
+    }
+
+    REQUIRE( filter( rel, compare( "Customer", Eq, "hooli" ) ).size() == 0 );
+    CHECK_THROWS( filter( rel, compare( "Id", Gt, 1e10 ) ) );
+    CHECK_THROWS( filter( rel, compare( "Id", Eq, "acme" ) ) );
+    CHECK_THROWS( filter( rel, compare( "Id", Eq, 2.5 ) ) );
+    CHECK_THROWS( filter( rel, compare( "Nope", Eq, 1 ) ) );
+}
+
+TEST_CASE( "project", "[relation] [project]") {
+    using namespace std::string_view_literals;
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    relation_builder builder(
+         &rsrc
+        ,col_desc<int>(                                 "Id" )
+        ,col_desc<std::string_view>(                    "Customer" )
+        ,col_desc< std::optional<std::string_view> >(   "Region" )
+    );
+    const std::array customers { "acme"sv, "initech"sv, "globex"sv };
+    for ( int i = 0; i < 3000; ++i ) {
+        const size_t c = size_t( i ) % customers.size();
+        builder.push_back( i, customers[ c ],
+            c == 2 ? std::nullopt : std::optional( i % 2 == 0 ? "north"sv : "south"sv ) );
+    }
+    relation rel( builder.release() );
+    rel.m_keys.push_back( { { "Id", { Int } } } );
+
+    // keeps the key, shares the columns
+    const relation ids = project( rel, { "Region", "Id" } );
+    REQUIRE( ids.size() == rel.size() );
+    REQUIRE( ids.m_cols[ ids.col_index( "Id" ) ] == rel.m_cols[ rel.col_index( "Id" ) ] );
+    REQUIRE( ids.m_keys == rel.m_keys );
+
+    // duplicates removed, first of each kept
+    const relation cust = project( rel, { "Customer" } );
+    REQUIRE( cust.size() == 3 );
+    for ( size_t r = 0; r < cust.size(); ++r ) {
+        REQUIRE( value_ops<std::string_view>::get( cust.at( r, 0 ) ) == customers[ r ] );
+    }
+    REQUIRE( cust.m_keys.size() == 1 );
+
+    // nulls are equal to each other
+    const relation regions = project( rel, { "Customer", "Region" } );
+    REQUIRE( regions.size() == 5 );
+    const relation region = project( rel, { "Region" } );
+    REQUIRE( region.size() == 3 );
+    REQUIRE( region.m_cols[ 0 ]->nullable() );
+    REQUIRE( region.at( 2, 0 ) == nullptr );
+
+    // already distinct, the projection is now keyed
+    REQUIRE( project( regions, { "Region", "Customer" } ).m_cols == regions.m_cols );
+    REQUIRE( keeps_key( regions, { "Customer", "Region" } ) );
+    REQUIRE( !keeps_key( regions, { "Customer" } ) );
+
+    CHECK_THROWS( project( rel, {} ) );
+    CHECK_THROWS( project( rel, { "Nope" } ) );
+}
+
+TEST_CASE( "lazy product", "[relation] [product]") {
+    using namespace std::string_view_literals;
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    relation_builder sizes_builder( &rsrc, col_desc<int>( "Size" ), col_desc<double>( "Weight" ) );
+    for ( int i = 0; i < 40; ++i ) {
+        sizes_builder.push_back( i, i * 0.25 );
+    }
+    auto sizes = std::make_shared<relation>( sizes_builder.release() );
+    sizes->m_keys.push_back( { { "Size", { Int } } } );
+
+    relation_builder colours_builder( &rsrc, col_desc<std::string_view>( "Colour" ) );
+    const std::array colours { "red"sv, "green"sv, "blue"sv };
+    for ( const auto c : colours ) {
+        colours_builder.push_back( c );
+    }
+    auto cols = std::make_shared<relation>( colours_builder.release() );
+    cols->m_keys.push_back( { { "Colour", { String } } } );
+
+    const product_view prod = product( sizes, cols );
+    REQUIRE( prod.size() == 120 );
+    REQUIRE( prod.type() == rel_ty_t::union_( sizes->m_ty, cols->m_ty ).m_tys );
+    REQUIRE( prod.keys().size() == 1 );
+    REQUIRE( prod.keys()[ 0 ].size() == 2 );
+    // columns in name order: Colour, Size, Weight
+    REQUIRE( value_ops<std::string_view>::get( prod.at( 7, 0 ) ) == "green" );
+    REQUIRE( value_ops<int>::get( prod.at( 7, 1 ) ) == 2 );
+    REQUIRE( value_ops<double>::get( prod.at( 7, 2 ) ) == 0.5 );
+    CHECK_THROWS_AS( prod.at( 120, 0 ), std::out_of_range );
+
+    const relation all = prod.materialize();
+    REQUIRE( all.size() == 120 );
+    REQUIRE( all.m_keys == prod.keys() );
+    for ( size_t r = 0; r < all.size(); ++r ) {
+        for ( size_t c = 0; c < 3; ++c ) {
+            REQUIRE( prod.value_ops()[ c ]->cmp( prod.at( r, c ), all.at( r, c ) )
+                == std::strong_ordering::equal );
+        }
+    }
+
+    // one sided conjuncts are pushed to the inputs
+    const auto p = and_( {
+         compare( "Size", Lt, 10 )
+        ,compare( "Colour", Ne, "red" )
+        ,or_( { compare( "Colour", Eq, "blue" ), compare( "Weight", Gt, 1.0 ) } )
+    } );
+    const relation pushed = filter( prod, p );
+    const relation direct = filter( all, p );
+    REQUIRE( pushed.size() == direct.size() );
+    REQUIRE( pushed.size() == 15 );
+    REQUIRE( pushed.m_keys == prod.keys() );
+    REQUIRE( filter( prod, compare( "Size", Lt, 10 ) ).m_keys == prod.keys() );
+    for ( size_t r = 0; r < pushed.size(); ++r ) {
+        for ( size_t c = 0; c < 3; ++c ) {
+            REQUIRE( pushed.m_ops[ c ]->cmp( pushed.at( r, c ), direct.at( r, c ) )
+                == std::strong_ordering::equal );
+        }
+    }
+    REQUIRE( filter( prod, compare( "Size", Gt, 100 ) ).size() == 0 );
+
+    CHECK_THROWS( product( sizes, sizes ) );
+
+    // an empty side, no rows to index
+    relation_builder none_builder( &rsrc, col_desc<int>( "Other" ) );
+    const product_view empty = product( sizes,
+        std::make_shared<relation>( none_builder.release() ) );
+    REQUIRE( empty.size() == 0 );
+    CHECK_THROWS_AS( empty.at( 0, 0 ), std::out_of_range );
+}
+
+TEST_CASE( "set operators", "[relation] [set_operators]") {
+    using namespace std::string_view_literals;
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    const auto make = [&]( int first, int last, bool dups ) {
+        relation_builder builder(
+             &rsrc
+            ,col_desc<int>(                         "Id" )
+            ,col_desc<std::string_view>(            "Name" )
+            ,col_desc< std::optional<double> >(     "Score" )
+        );
+        const std::array names { "a"sv, "b"sv, "c"sv };
+        for ( int i = first; i < last; ++i ) {
+            for ( int d = 0; d < ( dups ? 2 : 1 ); ++d ) {
+                builder.push_back( i, names[ size_t( i ) % names.size() ],
+                    i % 5 == 0 ? std::nullopt : std::optional( i * 0.5 ) );
+            }
+        }
+        return relation( builder.release() );
+    };
+    // ids of rows, checking each row's values
+    const auto ids = []( const relation& rel ) {
+        std::vector<int> out;
+        const size_t id = rel.col_index( "Id" );
+        const size_t score = rel.col_index( "Score" );
+        for ( size_t r = 0; r < rel.size(); ++r ) {
+            const int i = value_ops<int>::get( rel.at( r, id ) );
+            REQUIRE( ( rel.at( r, score ) == nullptr ) == ( i % 5 == 0 ) );
+            out.push_back( i );
+        }
+        return out;
+    };
+    const auto range = []( int first, int last ) {
+        std::vector<int> out( size_t( last - first ) );
+        std::iota( out.begin(), out.end(), first );
+        return out;
+    };
+    const auto concat = []( std::vector<int> x, const std::vector<int>& y ) {
+        x.insert( x.end(), y.cbegin(), y.cend() );
+        return x;
+    };
+
+    // unkeyed, with duplicates
+    const relation a = make( 0, 1000, true );
+    const relation b = make( 600, 1200, true );
+    REQUIRE( ids( union_( a, b ) ) == range( 0, 1200 ) );
+    REQUIRE( ids( minus( a, b ) ) == range( 0, 600 ) );
+    REQUIRE( ids( minus( b, a ) ) == range( 1000, 1200 ) );
+    REQUIRE( ids( intersect( a, b ) ) == range( 600, 1000 ) );
+    REQUIRE( union_( a, b ).m_keys.size() == 1 );
+
+    // keyed, the table is over the smaller input
+    relation ka = make( 0, 1000, false );
+    relation kb = make( 900, 1100, false );
+    ka.m_keys.push_back( { { "Id", { Int } } } );
+    kb.m_keys.push_back( { { "Id", { Int } } } );
+    REQUIRE( ids( union_( ka, kb ) ) == range( 0, 1100 ) );
+    REQUIRE( ids( union_( kb, ka ) ) == concat( range( 900, 1100 ), range( 0, 900 ) ) );
+    REQUIRE( ids( minus( ka, kb ) ) == range( 0, 900 ) );
+    REQUIRE( ids( intersect( ka, kb ) ) == range( 900, 1000 ) );
+    REQUIRE( intersect( ka, kb ).m_keys == ka.m_keys );
+
+    // empty inputs
+    const relation none = make( 0, 0, false );
+    REQUIRE( ids( union_( none, a ) ) == range( 0, 1000 ) );
+    REQUIRE( union_( ka, none ).m_cols == ka.m_cols );
+    REQUIRE( minus( ka, none ).m_cols == ka.m_cols );
+    REQUIRE( intersect( a, none ).size() == 0 );
+    REQUIRE( minus( none, a ).size() == 0 );
+
+    relation_builder other( &rsrc, col_desc<int>( "Id" ) );
+    CHECK_THROWS( union_( a, relation( other.release() ) ) );
+}
+
+TEST_CASE( "summarize", "[relation] [summarize]") {
+    using namespace std::string_view_literals;
+    std::pmr::monotonic_buffer_resource rsrc;
+
+    relation_builder builder(
+         &rsrc
+        ,col_desc<std::string_view>(                    "Customer" )
+        ,col_desc< std::optional<std::string_view> >(   "Region" )
+        ,col_desc<double>(                              "Amount" )
+        ,col_desc<int>(                                 "Qty" )
+        ,col_desc< std::optional<float> >(              "Discount" )
+    );
+    const std::array customers { "acme"sv, "initech"sv, "globex"sv };
+    const int n = 5000;
+    for ( int i = 0; i < n; ++i ) {
+        builder.push_back( customers[ size_t( i ) % customers.size() ],
+            i % 4 == 0 ? std::nullopt : std::optional( i % 2 == 0 ? "north"sv : "south"sv ),
+            i * 0.5, i % 7,
+            i % 3 == 2 ? std::nullopt : std::optional( float( i % 10 ) ) );
+    }
+    builder.encode( "Customer", Dictionary );
+    const relation rel( builder.release() );
+
+    const std::vector<aggregate> aggs {
+         { Count,   "",         "Rows" }
+        ,{ Sum,     "Qty",      "TotalQty" }
+        ,{ Min,     "Amount",   "MinAmount" }
+        ,{ Max,     "Amount",   "MaxAmount" }
+        ,{ Avg,     "Discount", "AvgDiscount" }
+        ,{ Count,   "Discount", "Discounts" }
+    };
+
+    const relation by_cust = summarize( rel, { "Customer" }, aggs );
+    REQUIRE( by_cust.size() == 3 );
+    REQUIRE( by_cust.m_keys.size() == 1 );
+    REQUIRE( by_cust.m_ty.m_tys[ by_cust.col_index( "TotalQty" ) ].second == type_t { Double } );
+    REQUIRE( by_cust.m_ty.m_tys[ by_cust.col_index( "AvgDiscount" ) ].second == type_t { Double } );
+    REQUIRE( by_cust.m_cols[ by_cust.col_index( "AvgDiscount" ) ]->nullable() );
+    for ( size_t g = 0; g < by_cust.size(); ++g ) {
+        const auto c = value_ops<std::string_view>::get( by_cust.at( g, by_cust.col_index( "Customer" ) ) );
+        REQUIRE( c == customers[ g ] );
+        int rows = 0, qty = 0, discounts = 0;
+        double min_amount = 1e300, max_amount = -1e300, discount = 0.0;
+        for ( int i = int( g ); i < n; i += 3 ) {
+            ++rows;
+            qty += i % 7;
+            min_amount = std::min( min_amount, i * 0.5 );
+            max_amount = std::max( max_amount, i * 0.5 );
+            if ( i % 3 != 2 ) {
+                ++discounts;
+                discount += i % 10;
+            }
+        }
+        const auto get_int = [&]( std::string_view col ) {
+            return value_ops<int>::get( by_cust.at( g, by_cust.col_index( col ) ) );
+        };
+        const auto get_double = [&]( std::string_view col ) {
+            return value_ops<double>::get( by_cust.at( g, by_cust.col_index( col ) ) );
+        };
+        REQUIRE( get_int( "Rows" ) == rows );
+        REQUIRE( get_double( "TotalQty" ) == qty );
+        REQUIRE( get_double( "MinAmount" ) == min_amount );
+        REQUIRE( get_double( "MaxAmount" ) == max_amount );
+        REQUIRE( get_int( "Discounts" ) == discounts );
+        if ( discounts == 0 ) {
+            REQUIRE( by_cust.at( g, by_cust.col_index( "AvgDiscount" ) ) == nullptr );
+        } else {
+            REQUIRE( std::abs( get_double( "AvgDiscount" ) - discount / discounts ) < 1e-9 );
+        }
+    }
+
+    // nulls group together
+    const relation by_region = summarize( rel, { "Region", "Customer" }, { { Count, "", "Rows" } } );
+    REQUIRE( by_region.size() == 9 );
+    int total = 0;
+    for ( size_t g = 0; g < by_region.size(); ++g ) {
+        total += value_ops<int>::get( by_region.at( g, by_region.col_index( "Rows" ) ) );
+    }
+    REQUIRE( total == n );
+
+    // whole relation, by reductions
+    const relation all = summarize( rel, {}, aggs );
+    REQUIRE( all.size() == 1 );
+    REQUIRE( value_ops<int>::get( all.at( 0, all.col_index( "Rows" ) ) ) == n );
+    int qty = 0;
+    for ( int i = 0; i < n; ++i ) {
+        qty += i % 7;
+    }
+    REQUIRE( value_ops<double>::get( all.at( 0, all.col_index( "TotalQty" ) ) ) == qty );
+    REQUIRE( value_ops<double>::get( all.at( 0, all.col_index( "MinAmount" ) ) ) == 0.0 );
+    REQUIRE( value_ops<double>::get( all.at( 0, all.col_index( "MaxAmount" ) ) ) == ( n - 1 ) * 0.5 );
+
+    // RLE, segmented and nullable columns, without reading per row
+    {
+        const auto make = [&]( bool encoded ) {
+            relation_builder b(
+                 &rsrc
+                ,col_desc<int>(                                 "Grp" )
+                ,col_desc<int>(                                 "Year" )
+                ,col_desc<double>(                              "Price" )
+                ,col_desc< std::optional<int> >(                "Score" )
+                ,col_desc< std::optional<std::string_view> >(   "Note" )
+            );
+            if ( encoded ) {
+                b.segment_columns( 4096 );
+            }
+            for ( int i = 0; i < n; ++i ) {
+                b.push_back( i % 5, 2000 + i / 300, i * 0.25,
+                    i % 7 == 0 ? std::nullopt : std::optional( i % 10 - 3 ),
+                    i % 3 == 0 ? std::nullopt : std::optional( "x"sv ) );
+            }
+            if ( encoded ) {
+                b.encode( "Year", Rle );
+            }
+            return relation( b.release() );
+        };
+        const relation plain = make( false );
+        const relation encoded = make( true );
+        REQUIRE( dynamic_cast<const untyped_rle_column_storage<int>*>(
+            encoded.m_cols[ encoded.col_index( "Year" ) ].get() ) );
+        REQUIRE( dynamic_cast<const untyped_segmented_column_storage<double>*>(
+            encoded.m_cols[ encoded.col_index( "Price" ) ].get() ) );
+
+        const auto name = []( const char* col, agg_op_t op ) {
+            return std::string( col ) + std::to_string( int( op ) );
+        };
+        std::vector<aggregate> col_aggs;
+        for ( const char* col : { "Year", "Price", "Score" } ) {
+            for ( const agg_op_t op : { Count, Sum, Min, Max, Avg } ) {
+                col_aggs.push_back( { op, col, name( col, op ) } );
+            }
+        }
+        col_aggs.push_back( { Count, "Note", "Notes" } );
+        const auto cell = []( const relation& r, size_t g, const std::string& col ) {
+            const size_t c = r.col_index( col );
+            const value_t* v = r.at( g, c );
+            return !v ? std::optional<double>()
+                : r.m_ty.m_tys[ c ].second == type_t { Int } ? double( value_ops<int>::get( v ) )
+                : value_ops<double>::get( v );
+        };
+        for ( const bool grouped : { false, true } ) {
+            const std::vector<std::string> by = grouped
+                ? std::vector<std::string> { "Grp" } : std::vector<std::string> {};
+            const relation e = summarize( encoded, by, col_aggs );
+            const relation p = summarize( plain, by, col_aggs );
+            REQUIRE( e.size() == ( grouped ? 5 : 1 ) );
+            for ( size_t g = 0; g < e.size(); ++g ) {
+                for ( const auto& a : col_aggs ) {
+                    REQUIRE( cell( e, g, a.as ) == cell( p, g, a.as ) );
+                }
+            }
+        }
+
+        std::int64_t years = 0, scores = 0;
+        int valid = 0, lo = 100, hi = -100;
+        for ( int i = 0; i < n; ++i ) {
+            years += 2000 + i / 300;
+            if ( i % 7 != 0 ) {
+                scores += i % 10 - 3;
+                lo = std::min( lo, i % 10 - 3 );
+                hi = std::max( hi, i % 10 - 3 );
+                ++valid;
+            }
+        }
+        const relation e = summarize( encoded, {}, col_aggs );
+        REQUIRE( cell( e, 0, name( "Year", Sum ) ) == double( years ) );
+        REQUIRE( cell( e, 0, name( "Year", Min ) ) == 2000 );
+        REQUIRE( cell( e, 0, name( "Year", Max ) ) == 2000 + ( n - 1 ) / 300 );
+        REQUIRE( cell( e, 0, name( "Year", Count ) ) == n );
+        REQUIRE( cell( e, 0, name( "Score", Sum ) ) == double( scores ) );
+        REQUIRE( cell( e, 0, name( "Score", Min ) ) == lo );
+        REQUIRE( cell( e, 0, name( "Score", Max ) ) == hi );
+        REQUIRE( cell( e, 0, name( "Score", Count ) ) == valid );
+        REQUIRE( cell( e, 0, "Notes" ) == n - ( n + 2 ) / 3 );
+    }
+
+    // empty, no group has values
+    const relation none = filter( rel, compare( "Qty", Gt, 100 ) );
+    REQUIRE( summarize( none, { "Customer" }, aggs ).size() == 0 );
+    const relation empty_all = summarize( none, {}, aggs );
+    REQUIRE( empty_all.size() == 1 );
+    REQUIRE( value_ops<int>::get( empty_all.at( 0, empty_all.col_index( "Rows" ) ) ) == 0 );
+    REQUIRE( empty_all.at( 0, empty_all.col_index( "MinAmount" ) ) == nullptr );
+
+    CHECK_THROWS( summarize( rel, {}, { { Sum, "Customer", "X" } } ) );
+    CHECK_THROWS( summarize( rel, {}, { { Sum, "", "X" } } ) );
+    CHECK_THROWS( summarize( rel, { "Nope" }, aggs ) );
+    CHECK_THROWS( summarize( rel, { "Customer" }, { { Count, "", "Customer" } } ) );
+}
+
 TEST_CASE( "table_view basics", "[relation_builder], [relation], [table_view]") {
     std::array< std::uint8_t, 32768 > buffer{};
     std::pmr::monotonic_buffer_resource rsrc( buffer.data(), buffer.size() );